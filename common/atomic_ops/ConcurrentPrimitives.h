@@ -48,6 +48,33 @@ init_membarrier(void)
     return 0;
 }
 
+static int
+init_membarrier_private_expedited(void)
+{
+    int ret;
+
+    /* Check that private expedited membarrier() is supported, and register this process for it. */
+
+    ret = membarrier(MEMBARRIER_CMD_QUERY, 0, 0);
+    if (ret < 0) {
+        perror("membarrier");
+        return -1;
+    }
+
+    if (!(ret & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+        fprintf(stderr,
+            "membarrier does not support MEMBARRIER_CMD_PRIVATE_EXPEDITED\n");
+        return -1;
+    }
+
+    if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) < 0) {
+        perror("membarrier");
+        return -1;
+    }
+
+    return 0;
+}
+
 
 // #ifndef LEVEL1_DCACHE_LINESIZE
 // #define LEVEL1_DCACHE_LINESIZE 128
@@ -0,0 +1,51 @@
+/*
+ * File:   bulk_insert.h
+ *
+ * Generic bulk construction for data structure adapters that have no
+ * specialized bulk-build: inserts a sorted array of distinct keys with up to
+ * numThreads OpenMP threads (the caller sets the number of threads with
+ * omp_set_num_threads, as for prefilling). Each thread inserts one contiguous
+ * slice of the array, from its largest key to its smallest, so that in a
+ * sorted list each insertion stops just before the previous one.
+ *
+ * Threads use tids 0, 1, ..., and deinitialize them when they are done.
+ */
+
+#ifndef BULK_INSERT_H
+#define BULK_INSERT_H
+
+#include <algorithm>
+#include <cstddef>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+#include "errors.h"
+
+template <class Adapter, typename K, typename V>
+void bulkInsertSorted(Adapter * const adapter, const int numThreads, K const * const keys, V const * const values, const size_t size) {
+#ifdef _OPENMP
+    const int ompThreads = std::max(1, std::min(numThreads, omp_get_max_threads()));
+#else
+    const int ompThreads = 1;
+#endif
+    #pragma omp parallel num_threads(ompThreads)
+    {
+#ifdef _OPENMP
+        const int tid = omp_get_thread_num();
+#else
+        const int tid = 0;
+#endif
+        adapter->initThread(tid);
+        const size_t begin = size * tid / ompThreads;
+        const size_t end = size * (tid+1) / ompThreads;
+        for (size_t i=end;i>begin;--i) {
+            if (adapter->insertIfAbsent(tid, keys[i-1], values[i-1]) != adapter->getNoValue()) {
+                setbench_error("bulk insert: duplicate key "<<keys[i-1]);
+            }
+        }
+        #pragma omp barrier
+        adapter->deinitThread(tid);
+    }
+}
+
+#endif /* BULK_INSERT_H */
@@ -94,7 +94,7 @@
 
 #define GSTATS_COMMA ,
 #define GSTATS_THREAD_PADDING_BYTES 256
-#define GSTATS_MAX_NUM_STATS 128
+#define GSTATS_MAX_NUM_STATS 256
 #ifndef GSTATS_MAX_THREAD_BUF_SIZE
 #   define GSTATS_MAX_THREAD_BUF_SIZE (1<<26)
 #endif
@@ -1020,6 +1020,29 @@ public:
         }
     }
 
+    // invokes f(name, metrics) with the TOTAL aggregate of every stat, converted to doubles
+    template <typename F>
+    void for_each_total(F f) {
+        compute_before_printing();
+        for (gstats_stat_id id=0;id<num_stats;++id) {
+            stat_metrics<double> m;
+            if (this->data_types[id] == LONG_LONG) {
+                stat_metrics<long long> * const t = (stat_metrics<long long> *) computed_gstats_total[id];
+                m.first = t->first;
+                m.cnt = t->cnt;
+                m.min = t->min;
+                m.max = t->max;
+                m.sum = t->sum;
+                m.avg = t->avg;
+                m.variance = t->variance;
+                m.stdev = t->stdev;
+            } else {
+                m = *computed_gstats_total[id];
+            }
+            f(id_to_name[id], m);
+        }
+    }
+
     void print_all() {
         
 // #if /*!defined LISTDS &&*/ defined USE_TREE_STATS
@@ -90,6 +90,7 @@ extern gstats_t& GSTATS_OBJECT_NAME;
 #define GSTATS_CLEAR_ALL GSTATS_OBJECT_NAME.clear_all()
 #define GSTATS_CLEAR_VAL(stat, val) GSTATS_OBJECT_NAME.clear_to_value(stat, val)
 #define GSTATS_PRINT GSTATS_OBJECT_NAME.print_all()
+#define GSTATS_FOR_EACH_TOTAL(f) GSTATS_OBJECT_NAME.for_each_total(f)
 
 #define GSTATS_TIMER_RESET(tid, timer_stat) GSTATS_SET(tid, timer_stat, get_server_clock())
 #define GSTATS_TIMER_ELAPSED(tid, timer_stat) (get_server_clock() - GSTATS_GET(tid, timer_stat))
@@ -145,6 +146,7 @@ GSTATS_DECLARE_EXTERN_ALL_STAT_IDS;
 #define GSTATS_CLEAR_ALL 
 #define GSTATS_CLEAR_VAL(stat, val) 
 #define GSTATS_PRINT 
+#define GSTATS_FOR_EACH_TOTAL(f) 
 
 #define GSTATS_TIMER_RESET(tid, timer_stat) 
 #define GSTATS_TIMER_ELAPSED(tid, timer_stat) 
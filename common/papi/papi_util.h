@@ -8,6 +8,9 @@
 #ifndef PAPI_UTIL_H
 #define PAPI_UTIL_H
 
+#include <string>
+#include <utility>
+#include <vector>
 #ifdef USE_PAPI
 #   include <papi.h>
 #endif
@@ -18,6 +21,7 @@ void papi_create_eventset(int id);
 void papi_start_counters(int id);
 void papi_stop_counters(int id);
 void papi_print_counters(long long all_ops);
+void papi_get_counters(long long all_ops, std::vector<std::pair<std::string, double> >& out);
 
 #endif /* PAPI_UTIL_H */
 
@@ -4,6 +4,8 @@
 #include "plaf.h"
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 int all_cpu_counters[] = {
 #ifdef USE_PAPI
@@ -142,6 +144,21 @@ void papi_stop_counters(int id){
     }
 #endif
 }
+// appends (counter name, count per operation) for each counter to out (-1 if the counter is not supported)
+void papi_get_counters(long long num_operations, std::vector<std::pair<std::string, double> >& out){
+#ifdef USE_PAPI
+    int i, j;
+    for (i = j = 0; i < nall_cpu_counters; i++) {
+        int c = all_cpu_counters[i];
+        if (PAPI_query_event(c) != PAPI_OK) {
+            out.push_back(std::make_pair(all_cpu_counters_strings[i], -1.));
+            continue;
+        }
+        out.push_back(std::make_pair(all_cpu_counters_strings[i], (double)counter_values[j]/num_operations));
+        j++;
+    }
+#endif
+}
 void papi_print_counters(long long num_operations){
 #ifdef USE_PAPI
     int i, j;
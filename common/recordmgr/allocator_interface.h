@@ -29,6 +29,9 @@ public:
     // allocate space for one object of type T
     T* allocate(const int tid);
     void deallocate(const int tid, T * const p);
+    // frees p on behalf of thread tid, from a thread other than tid
+    // (e.g., a reclamation helper) while tid may be allocating
+    void deallocateRemote(const int tid, T * const p);
     void deallocateAndClear(const int tid, blockbag<T> * const bag);
     
     void debugPrintStatus(const int tid);
@@ -83,6 +83,10 @@ public:
 #endif //DAOI_RUSLON_RECLAIMERS
 #endif
     }
+    // delete is thread safe, so this is deallocate()
+    void deallocateRemote(const int tid, T * const p) {
+        deallocate(tid, p);
+    }
     void deallocateAndClear(const int tid, blockbag<T> * const bag) {
 #ifdef NO_FREE
         bag->clearWithoutFreeingElements();
@@ -0,0 +1,263 @@
+/**
+ * Per-thread slab allocator for the record manager.
+ *
+ * Each thread carves fixed-size cells for T out of its own slabs of
+ * ALLOC_SLAB_BYTES bytes. Slabs are aligned to their size, so the owner of a
+ * cell is found from the header at the start of its slab (no per-object header).
+ * Slabs are mmap'd, advised to use transparent hugepages and, with
+ * USE_LIBNUMA, bound to the NUMA node of the thread that creates them.
+ *
+ * A thread frees its own cells onto a private free list. Cells freed by other
+ * threads (e.g., by a reclaimer), and cells freed with deallocateRemote() on
+ * behalf of a thread (e.g., by a reclamation helper), are pushed onto the owner's lock-free
+ * remote-free list, which the owner takes in one exchange when its private
+ * list runs dry. Only the owner pops, so the push-only Treiber stack has no ABA.
+ *
+ * Slabs are returned to the OS only when the allocator is destroyed.
+ */
+
+#ifndef ALLOC_SLAB_H
+#define	ALLOC_SLAB_H
+
+#include "plaf.h"
+#include "pool_interface.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+#include <new>
+#include <sched.h>
+#include <sys/mman.h>
+#ifdef USE_LIBNUMA
+#include <numa.h>
+#endif
+
+#ifndef ALLOC_SLAB_BYTES
+    #define ALLOC_SLAB_BYTES (1ULL<<21) // one transparent hugepage on x86-64
+#endif
+
+// sizeof/alignof that also accept void, since allocator_slab<void> is instantiated for rebinding
+template<typename U> struct allocator_slab_type_info {
+    static constexpr size_t size = sizeof(U);
+    static constexpr size_t align = alignof(U);
+};
+template<> struct allocator_slab_type_info<void> {
+    static constexpr size_t size = 1;
+    static constexpr size_t align = 1;
+};
+
+template<typename T = void>
+class allocator_slab : public allocator_interface<T> {
+    PAD; // post padding for allocator_interface
+
+    struct Cell {
+        Cell * next;
+    };
+    struct SlabHeader {
+        int owner;
+        SlabHeader * nextSlab;
+    };
+    struct ThreadState {
+        PAD;
+        Cell * localFree;                   // only accessed by the owner
+        char * bumpNext;                    // next never-used cell in the current slab
+        char * bumpEnd;
+        SlabHeader * slabs;                 // all slabs owned by this thread
+        long long numSlabs;
+        int node;                           // NUMA node slabs are bound to (-1 if unknown)
+        PAD;
+        std::atomic<Cell *> remoteFree;     // pushed by other threads, taken by the owner
+        PAD;
+    };
+
+    static constexpr size_t roundUp(const size_t x, const size_t a) {
+        return (x + a - 1) / a * a;
+    }
+    static constexpr size_t OBJ_BYTES = allocator_slab_type_info<T>::size;
+    static constexpr size_t OBJ_ALIGN = allocator_slab_type_info<T>::align;
+    static constexpr size_t CELL_ALIGN = (OBJ_ALIGN > alignof(Cell)) ? OBJ_ALIGN : alignof(Cell);
+    static constexpr size_t CELL_BYTES = roundUp((OBJ_BYTES > sizeof(Cell)) ? OBJ_BYTES : sizeof(Cell), CELL_ALIGN);
+    static constexpr size_t HEADER_BYTES = roundUp(sizeof(SlabHeader), (CELL_ALIGN > PREFETCH_SIZE_BYTES) ? CELL_ALIGN : PREFETCH_SIZE_BYTES);
+    static_assert((ALLOC_SLAB_BYTES & (ALLOC_SLAB_BYTES - 1)) == 0, "ALLOC_SLAB_BYTES must be a power of two");
+    static_assert(HEADER_BYTES + CELL_BYTES <= ALLOC_SLAB_BYTES, "ALLOC_SLAB_BYTES is too small for one object");
+
+    ThreadState * threadState;
+    PAD;
+
+    static inline SlabHeader * slabOf(const void * const p) {
+        return (SlabHeader *) ((uintptr_t) p & ~(uintptr_t) (ALLOC_SLAB_BYTES - 1));
+    }
+
+    // maps a new ALLOC_SLAB_BYTES-aligned slab for tid and makes it the bump region
+    void newSlab(const int tid) {
+        ThreadState * const ts = &threadState[tid];
+        // over-allocate so an aligned slab fits, then trim the excess on both sides
+        const size_t mapBytes = 2 * ALLOC_SLAB_BYTES;
+        char * const raw = (char *) mmap(NULL, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED) {
+            std::cerr<<"ERROR: allocator_slab could not mmap a slab of "<<ALLOC_SLAB_BYTES<<" bytes"<<std::endl;
+            throw std::bad_alloc();
+        }
+        char * const slab = (char *) roundUp((uintptr_t) raw, ALLOC_SLAB_BYTES);
+        if (slab > raw) munmap(raw, slab - raw);
+        if (raw + mapBytes > slab + ALLOC_SLAB_BYTES) munmap(slab + ALLOC_SLAB_BYTES, (raw + mapBytes) - (slab + ALLOC_SLAB_BYTES));
+#ifdef MADV_HUGEPAGE
+        madvise(slab, ALLOC_SLAB_BYTES, MADV_HUGEPAGE);
+#endif
+#ifdef USE_LIBNUMA
+        if (ts->node >= 0) numa_tonode_memory(slab, ALLOC_SLAB_BYTES, ts->node);
+#endif
+        SlabHeader * const header = (SlabHeader *) slab;
+        header->owner = tid;
+        header->nextSlab = ts->slabs;
+        ts->slabs = header;
+        ++ts->numSlabs;
+        ts->bumpNext = slab + HEADER_BYTES;
+        ts->bumpEnd = slab + ALLOC_SLAB_BYTES;
+    }
+
+    inline void * allocateCell(const int tid) {
+        ThreadState * const ts = &threadState[tid];
+        Cell * c = ts->localFree;
+        if (c == NULL && ts->remoteFree.load(std::memory_order_relaxed) != NULL) {
+            c = ts->remoteFree.exchange(NULL, std::memory_order_acquire);
+        }
+        if (c != NULL) {
+            ts->localFree = c->next;
+            return c;
+        }
+        if (ts->bumpNext + CELL_BYTES > ts->bumpEnd) newSlab(tid);
+        void * const result = ts->bumpNext;
+        ts->bumpNext += CELL_BYTES;
+        return result;
+    }
+
+    inline void freeCellRemote(void * const p) {
+        Cell * const c = (Cell *) p;
+        std::atomic<Cell *> * const head = &threadState[slabOf(p)->owner].remoteFree;
+        Cell * old = head->load(std::memory_order_relaxed);
+        do {
+            c->next = old;
+        } while (!head->compare_exchange_weak(old, c, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    inline void freeCell(const int tid, void * const p) {
+        if (slabOf(p)->owner == tid) {
+            Cell * const c = (Cell *) p;
+            c->next = threadState[tid].localFree;
+            threadState[tid].localFree = c;
+        } else {
+            freeCellRemote(p);
+        }
+    }
+
+public:
+    template<typename _Tp1>
+    struct rebind {
+        typedef allocator_slab<_Tp1> other;
+    };
+
+    // reserve space for ONE object of type T
+    T* allocate(const int tid) {
+        MEMORY_STATS {
+            this->debug->addAllocated(tid, 1);
+            VERBOSE {
+                if ((this->debug->getAllocated(tid) % 2000) == 0) {
+                    debugPrintStatus(tid);
+                }
+            }
+        }
+#ifdef DAOI_RUSLON_RECLAIMERS
+        return nullptr;
+        // for ruslon relaimers malloc does allocation from reclaimer file.
+        // invoke this allocate function to just record debug stats.
+#else
+        return new (allocateCell(tid)) T;
+#endif
+    }
+
+    void deallocate(const int tid, T * const p) {
+        MEMORY_STATS {
+            this->debug->addDeallocated(tid, 1);
+        }
+#if !defined NO_FREE
+#ifdef DAOI_RUSLON_RECLAIMERS
+        free( (char*) p); // freeing placement malloced memory
+#else
+        p->~T();
+        freeCell(tid, p);
+#endif //DAOI_RUSLON_RECLAIMERS
+#endif
+    }
+    // always uses the owner's remote-free list, since tid's private list is not thread safe
+    void deallocateRemote(const int tid, T * const p) {
+        MEMORY_STATS {
+            this->debug->addDeallocated(tid, 1);
+        }
+#if !defined NO_FREE
+#ifdef DAOI_RUSLON_RECLAIMERS
+        free( (char*) p); // freeing placement malloced memory
+#else
+        p->~T();
+        freeCellRemote(p);
+#endif //DAOI_RUSLON_RECLAIMERS
+#endif
+    }
+    void deallocateAndClear(const int tid, blockbag<T> * const bag) {
+#ifdef NO_FREE
+        bag->clearWithoutFreeingElements();
+#else
+        while (!bag->isEmpty()) {
+            T* ptr = bag->remove();
+            deallocate(tid, ptr);
+        }
+#endif
+    }
+
+    void debugPrintStatus(const int tid) {
+        std::cout<<"thread "<<tid<<" owns "<<threadState[tid].numSlabs<<" slabs of "<<ALLOC_SLAB_BYTES<<" bytes ("<<CELL_BYTES<<" bytes per object of size "<<OBJ_BYTES<<")"<<std::endl;
+    }
+
+    void initThread(const int tid) {
+#ifdef USE_LIBNUMA
+        if (threadState[tid].node < 0 && numa_available() != -1) {
+            const int cpu = sched_getcpu();
+            if (cpu >= 0) threadState[tid].node = numa_node_of_cpu(cpu);
+        }
+#endif
+    }
+    void deinitThread(const int tid) {}
+
+    allocator_slab(const int numProcesses, debugInfo * const _debug)
+            : allocator_interface<T>(numProcesses, _debug) {
+        VERBOSE DEBUG std::cout<<"constructor allocator_slab"<<std::endl;
+        threadState = new ThreadState[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            threadState[tid].localFree = NULL;
+            threadState[tid].bumpNext = NULL;
+            threadState[tid].bumpEnd = NULL;
+            threadState[tid].slabs = NULL;
+            threadState[tid].numSlabs = 0;
+            threadState[tid].node = -1;
+            threadState[tid].remoteFree.store(NULL, std::memory_order_relaxed);
+        }
+    }
+    ~allocator_slab() {
+        VERBOSE DEBUG std::cout<<"destructor allocator_slab"<<std::endl;
+        // objects still allocated at this point are discarded without running their destructors,
+        // just as allocator_new leaks them
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            SlabHeader * slab = threadState[tid].slabs;
+            while (slab) {
+                SlabHeader * const next = slab->nextSlab;
+                munmap(slab, ALLOC_SLAB_BYTES);
+                slab = next;
+            }
+        }
+        delete[] threadState;
+    }
+};
+
+#endif	/* ALLOC_SLAB_H */
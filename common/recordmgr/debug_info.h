@@ -19,6 +19,7 @@ struct _memrecl_counters {
     long given; // how many blocks have been moved from this pool to a shared pool
     long taken; // how many blocks have been moved from a shared pool to this pool
     long retired; // how many objects have been retired
+    long discarded; // how many objects have been deallocated without being retired
     PAD;
 };
 
@@ -38,6 +39,7 @@ public:
             c[tid].given = 0;
             c[tid].taken = 0;
             c[tid].retired = 0;
+            c[tid].discarded = 0;
         }
     }
     void addAllocated(const int tid, const int val) {
@@ -61,6 +63,9 @@ public:
     void addRetired(const int tid, const int val) {
         c[tid].retired += val;
     }
+    void addDiscarded(const int tid, const int val) {
+        c[tid].discarded += val;
+    }
     long getAllocated(const int tid) {
         return c[tid].allocated;
     }
@@ -82,6 +87,17 @@ public:
     long getRetired(const int tid) {
         return c[tid].retired;
     }
+    long getDiscarded(const int tid) {
+        return c[tid].discarded;
+    }
+    // objects retired by thread tid that have not yet been returned to the pool
+    // (every object returned to the pool was either retired or discarded).
+    // pools count each object they are given (or free) with the tid they are
+    // passed, and reclaimers pass the tid of the thread that retired it (the
+    // owner of the bag it was retired into), so this is never negative.
+    long getGarbage(const int tid) {
+        return c[tid].retired - (c[tid].toPool - c[tid].discarded);
+    }
     long getTotalAllocated() {
         long result = 0;
         for (int tid=0;tid<NUM_PROCESSES;++tid) {
@@ -131,6 +147,20 @@ public:
         }
         return result;
     }
+    long getTotalDiscarded() {
+        long result = 0;
+        for (int tid=0;tid<NUM_PROCESSES;++tid) {
+            result += getDiscarded(tid);
+        }
+        return result;
+    }
+    long getTotalGarbage() {
+        long result = 0;
+        for (int tid=0;tid<NUM_PROCESSES;++tid) {
+            result += getGarbage(tid);
+        }
+        return result;
+    }
     debugInfo(int numProcesses) : NUM_PROCESSES(numProcesses) {
 //        c = new _memrecl_counters[numProcesses];
         clear();
@@ -0,0 +1,138 @@
+/*
+ * File:   epoch_clock.h
+ *
+ * Global epoch shared by the epoch-based reclaimers (ibr_rcu, qsbr, rcu_pop*,
+ * 2geibr, pop*2geibr, he, nbr_pop*he).
+ *
+ * By default the epoch is a counter on its own cache line. It is read with a
+ * plain load, and it advances according to the garbage that threads produce,
+ * not the number of records they allocate: each thread counts its retires
+ * since it last saw the epoch change, and once it has retired
+ * retiresPerAdvance records it tries a single CAS from the epoch it saw to the
+ * next one. A thread that loses the CAS does not retry, since someone else
+ * advanced the epoch. So the line is written once per retiresPerAdvance
+ * retires of the fastest retiring thread, rather than after a fixed number of
+ * allocations by all threads.
+ *
+ * With -DEPOCH_CLOCK_TSC the epoch is instead derived from the time stamp
+ * counter (see server_clock.h): it is the number of 2^EPOCH_CLOCK_TSC_SHIFT
+ * nanosecond periods since the clock was created. Reading the epoch writes
+ * nothing shared, and the epoch advances with no RMW at all. TSCs on different
+ * sockets can be slightly out of sync, so a thread can see an epoch one
+ * greater than a thread on another socket saw at the same time. To tolerate
+ * this, retire epochs are rounded up and birth epochs rounded down by
+ * EPOCH_CLOCK_SLACK (see retireEpoch() and birthLowerBound()).
+ */
+
+#ifndef EPOCH_CLOCK_H
+#define EPOCH_CLOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "plaf.h"
+#ifdef EPOCH_CLOCK_TSC
+#include "server_clock.h"
+#endif
+
+#ifndef EPOCH_CLOCK_TSC_SHIFT
+#define EPOCH_CLOCK_TSC_SHIFT 14 // epochs of ~16us
+#endif
+
+#ifdef EPOCH_CLOCK_TSC
+#define EPOCH_CLOCK_SLACK 1
+#else
+#define EPOCH_CLOCK_SLACK 0
+#endif
+
+// the epoch advances about this many times per emptying of a thread's retired bag
+#ifndef EPOCH_ADVANCES_PER_EMPTY
+#define EPOCH_ADVANCES_PER_EMPTY 8
+#endif
+
+class EpochClock {
+private:
+    struct ThreadClock {
+        PAD;
+        uint64_t lastSeen;
+        uint64_t retiresSinceAdvance;
+        PAD;
+    };
+
+    PAD;
+    std::atomic<uint64_t> epoch; // initial epoch in TSC mode
+    PAD;
+#ifdef EPOCH_CLOCK_TSC
+    uint64_t startTime;
+#endif
+    uint64_t retiresPerAdvance;
+    ThreadClock * threads;
+    PAD;
+
+public:
+    EpochClock() : threads(NULL) {}
+    ~EpochClock() {
+        delete[] threads;
+    }
+
+    // emptyFreq is the number of retires between a thread's attempts to empty its retired bag
+    void init(const int numProcesses, const uint64_t initialEpoch, const uint64_t emptyFreq) {
+        retiresPerAdvance = std::max((uint64_t) 1, emptyFreq / EPOCH_ADVANCES_PER_EMPTY);
+        delete[] threads;
+        threads = new ThreadClock[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            threads[tid].lastSeen = initialEpoch;
+            threads[tid].retiresSinceAdvance = 0;
+        }
+#ifdef EPOCH_CLOCK_TSC
+        startTime = get_server_clock();
+#endif
+        epoch.store(initialEpoch, std::memory_order_release);
+    }
+
+    inline uint64_t load(const std::memory_order order = std::memory_order_acquire) const {
+#ifdef EPOCH_CLOCK_TSC
+        // the clock must not be read before preceding loads (e.g., of a pointer the epoch will protect)
+  #if defined __x86_64__ || defined __i386__
+        __asm__ __volatile__ ("lfence" ::: "memory");
+  #else
+        std::atomic_thread_fence(std::memory_order_acquire);
+  #endif
+        return epoch.load(std::memory_order_relaxed) + ((get_server_clock() - startTime) >> EPOCH_CLOCK_TSC_SHIFT);
+#else
+        return epoch.load(order);
+#endif
+    }
+
+    // epoch to record for a record retired now
+    inline uint64_t retireEpoch() const {
+        return load() + EPOCH_CLOCK_SLACK;
+    }
+
+    // epoch to record for a record born in epoch birth
+    inline static uint64_t birthLowerBound(const uint64_t birth) {
+        return (birth >= EPOCH_CLOCK_SLACK) ? birth - EPOCH_CLOCK_SLACK : 0;
+    }
+
+    // invoke whenever thread tid retires a record
+    inline void onRetire(const int tid) {
+#ifndef EPOCH_CLOCK_TSC
+        ThreadClock * const t = &threads[tid];
+        uint64_t e = epoch.load(std::memory_order_relaxed);
+        if (e != t->lastSeen) {
+            t->lastSeen = e;
+            t->retiresSinceAdvance = 0;
+        }
+        if (++t->retiresSinceAdvance >= retiresPerAdvance) {
+            t->retiresSinceAdvance = 0;
+            epoch.compare_exchange_strong(e, e+1, std::memory_order_acq_rel);
+        }
+#endif
+    }
+
+    uint64_t getRetiresPerAdvance() const {
+        return retiresPerAdvance;
+    }
+};
+
+#endif /* EPOCH_CLOCK_H */
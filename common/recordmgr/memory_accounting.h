@@ -0,0 +1,109 @@
+/*
+ * File:   memory_accounting.h
+ *
+ * Process-wide registry of the debugInfo counters of every record type that
+ * has a live record manager, so that the harness can report allocated,
+ * retired, freed and unreclaimed (retired but not yet freed) records and bytes
+ * per record type without knowing the data structure's record types.
+ *
+ * The counters are the per-thread debugInfo counters that the allocators,
+ * pools and record managers maintain under MEMORY_STATS (see debug_info.h):
+ * a record is freed when its reclaimer returns it to the pool (every pool
+ * counts exactly the records it is given, or frees), so garbage is what the
+ * reclaimer is holding back, independent of pool and allocator caching.
+ *
+ * sample() sums the counters with racy reads (each thread only writes its
+ * own counters), and maintains the peak garbage of every record type, and of
+ * all record types together, since the last resetPeaks().
+ */
+
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "debug_info.h"
+
+struct memory_accounting_type_t {
+    std::string name;       // typeid(Record).name()
+    size_t recordSize;      // sizeof(Record)
+    debugInfo * info;
+    long long garbage;      // records, as of the last sample()
+    long long peakGarbage;  // records, since the last resetPeaks()
+
+    long long getGarbageBytes() const { return garbage * (long long) recordSize; }
+    long long getPeakGarbageBytes() const { return peakGarbage * (long long) recordSize; }
+};
+
+class MemoryAccounting {
+private:
+    std::mutex lock;
+    std::vector<memory_accounting_type_t> types;
+    long long peakGarbageBytes;
+
+public:
+    MemoryAccounting() : peakGarbageBytes(0) {}
+
+    void registerType(debugInfo * const info, const std::string& name, const size_t recordSize) {
+        std::lock_guard<std::mutex> guard(lock);
+        memory_accounting_type_t t;
+        t.name = name;
+        t.recordSize = recordSize;
+        t.info = info;
+        t.garbage = 0;
+        t.peakGarbage = 0;
+        types.push_back(t);
+    }
+
+    void unregisterType(debugInfo * const info) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i=0;i<types.size();++i) {
+            if (types[i].info == info) {
+                types.erase(types.begin() + i);
+                return;
+            }
+        }
+    }
+
+    // returns the garbage in bytes over all record types
+    long long sample() {
+        std::lock_guard<std::mutex> guard(lock);
+        long long bytes = 0;
+        for (size_t i=0;i<types.size();++i) {
+            types[i].garbage = types[i].info->getTotalGarbage();
+            if (types[i].garbage > types[i].peakGarbage) types[i].peakGarbage = types[i].garbage;
+            bytes += types[i].getGarbageBytes();
+        }
+        if (bytes > peakGarbageBytes) peakGarbageBytes = bytes;
+        return bytes;
+    }
+
+    // the peaks restart from the current garbage
+    void resetPeaks() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (size_t i=0;i<types.size();++i) types[i].peakGarbage = 0;
+            peakGarbageBytes = 0;
+        }
+        sample();
+    }
+
+    long long getPeakGarbageBytes() {
+        std::lock_guard<std::mutex> guard(lock);
+        return peakGarbageBytes;
+    }
+
+    // a copy of the per-type state as of the last sample()
+    std::vector<memory_accounting_type_t> getTypes() {
+        std::lock_guard<std::mutex> guard(lock);
+        return types;
+    }
+};
+
+inline MemoryAccounting & memoryAccounting() {
+    static MemoryAccounting accounting;
+    return accounting;
+}
+
+#endif /* MEMORY_ACCOUNTING_H */
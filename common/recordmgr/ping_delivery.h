@@ -0,0 +1,295 @@
+/*
+ * File:   ping_delivery.h
+ *
+ * Delivery of pings (neutralization signals) for the publish-on-ping (POP)
+ * reclaimers. A reclaiming thread calls pingAll(tid) where it used to loop over
+ * pthread_kill; each pinged thread publishes its reservations in its signal
+ * handler and then calls onPublished(tid).
+ *
+ * Strategies (compile time, see the ping_* variables in microbench/Makefile):
+ *  (default)             ping every other thread serially from the reclaimer,
+ *                        without waiting for them to publish (original behaviour).
+ *  PING_WAIT_FOR_PUBLISH wait until every pinged thread has published before
+ *                        returning (implied by all strategies below).
+ *  PING_TREE_FANOUT=k    the reclaimer pings only its k children in a k-ary
+ *                        tree over all threads; each pinged thread forwards the
+ *                        ping to its own children from its signal handler.
+ *  PING_SKIP_QUIESCENT   do not ping threads that are outside of an operation
+ *                        or that have published since the round began.
+ *  PING_COMBINING        concurrent reclaimers share one broadcast round: one
+ *                        thread leads the round and the others wait for it and
+ *                        reuse the reservations it caused to be published.
+ *
+ * Only threads in the registry of live threads are pinged or waited for (the
+ * tree of PING_TREE_FANOUT is still laid out over all tids; a ping to a tid
+ * with no thread is dropped and its subtree is pinged directly on the resend).
+ *
+ * pingAll returns false if it could not confirm that every thread published
+ * (only possible when waiting); the caller must then skip this reclamation.
+ *
+ * With POP_PUBLISH_MEMBARRIER (the *_mb reclaimers in microbench/Makefile) no
+ * signals are sent: reservations are written to the shared slots with relaxed
+ * stores, and pingAll issues one MEMBARRIER_CMD_PRIVATE_EXPEDITED, which makes
+ * every thread's prior stores visible to the caller.
+ */
+
+#ifndef PING_DELIVERY_H
+#define PING_DELIVERY_H
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
+#include <sched.h>
+#include "plaf.h"
+#include "ConcurrentPrimitives.h"
+#include "debugprinting.h"
+#include "server_clock.h"
+#include "reclamation_events.h"
+#include "thread_registry.h"
+#include "thread_signals.h"
+
+#if defined(PING_TREE_FANOUT) || defined(PING_SKIP_QUIESCENT) || defined(PING_COMBINING)
+    #ifndef PING_WAIT_FOR_PUBLISH
+        #define PING_WAIT_FOR_PUBLISH
+    #endif
+#endif
+
+// how long a reclaimer waits for a thread to publish before giving up on this reclamation
+#ifndef PING_PUBLISH_TIMEOUT_NS
+    #define PING_PUBLISH_TIMEOUT_NS 50000000
+#endif
+
+class PingDelivery {
+private:
+    struct ThreadState {
+        PAD;
+        std::atomic<uint64_t> publishCount;     // number of times this thread published in response to a ping
+        std::atomic<bool> inOp;                 // only maintained with PING_SKIP_QUIESCENT
+        PAD;
+    };
+
+    PAD;
+    const int NUM_PROCESSES;
+    const int signum;
+    ThreadSignals * const signals;
+    const ThreadRegistry * const liveThreads;
+    uint64_t * const seenPublishCount;          // seenPublishCount[pinger*NUM_PROCESSES + i] = publishCount of i when pinger's round began
+    int * const roundTids;                      // roundTids[pinger*NUM_PROCESSES ...]: the live tids when pinger's round began
+    PAD;
+    ThreadState state[MAX_THREADS_POW2];
+    PAD;
+    std::atomic<uint64_t> roundsStarted;        // PING_COMBINING: number of the last round that began
+    PAD;
+    std::atomic<uint64_t> roundsCompleted;      // PING_COMBINING: (number of the last round that completed << 1) | succeeded
+    PAD;
+
+    inline bool sendPing(const int tid, const int otherTid, const int root) {
+        int error;
+#ifdef PING_TREE_FANOUT
+        if (root >= 0) {
+            union sigval value;
+            value.sival_int = root;
+            error = signals->signal(otherTid, signum, value);
+        } else
+#endif
+        {
+            error = signals->signal(otherTid, signum);
+        }
+        if (error == ThreadSignals::NO_THREAD) return false;
+        if (error) {
+            COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << signum << ")" << std::endl);
+            if (error == ESRCH)
+                COUTATOMICTID("ESRCH" << std::endl);
+            if (error == EINVAL)
+                COUTATOMICTID("EINVAL" << std::endl);
+            assert("Error when trying to pthread_kill" && 0);
+            return false;
+        }
+        return true;
+    }
+
+#ifdef PING_TREE_FANOUT
+    // pings the children of tid in the PING_TREE_FANOUT-ary tree rooted at root (over tids relative to root)
+    inline int pingChildren(const int tid, const int root) {
+        const int rel = (tid - root + NUM_PROCESSES) % NUM_PROCESSES;
+        int sent = 0;
+        for (int c = rel * PING_TREE_FANOUT + 1; c <= rel * PING_TREE_FANOUT + PING_TREE_FANOUT && c < NUM_PROCESSES; ++c) {
+            if (sendPing(tid, (root + c) % NUM_PROCESSES, root)) ++sent;
+        }
+        return sent;
+    }
+#endif
+
+    // true if otherTid provably holds no unpublished reservation on records retired before this round began
+    inline bool canSkip(const int otherTid, const uint64_t seen) {
+        if (!liveThreads->contains(otherTid)) return true; // the thread left after the round began
+#ifdef PING_SKIP_QUIESCENT
+        if (!state[otherTid].inOp.load(std::memory_order_seq_cst)) return true;
+        if (state[otherTid].publishCount.load(std::memory_order_acquire) != seen) return true;
+#endif
+        return false;
+    }
+
+#ifdef PING_WAIT_FOR_PUBLISH
+    inline bool awaitPublished(const int tid, const int numTids, const bool includeSelf, const uint64_t startTime, int * const sent) {
+        const uint64_t * const seen = &seenPublishCount[tid * NUM_PROCESSES];
+        const int * const tids = &roundTids[tid * NUM_PROCESSES];
+        for (int i = 0; i < numTids; ++i) {
+            const int otherTid = tids[i];
+            if (otherTid == tid && !includeSelf) continue;
+            bool resent = false;
+            while (state[otherTid].publishCount.load(std::memory_order_acquire) == seen[otherTid]) {
+                if (canSkip(otherTid, seen[otherTid])) break;
+                const uint64_t elapsed = get_server_clock() - startTime;
+                if (elapsed > PING_PUBLISH_TIMEOUT_NS) return false;
+                // a ping can be lost when it merges with a pending one (e.g., forwarded along another reclaimer's tree)
+                if (!resent && elapsed > PING_PUBLISH_TIMEOUT_NS / 4) {
+                    resent = true;
+                    if (sendPing(tid, otherTid, -1)) ++(*sent);
+                }
+                sched_yield();
+            }
+        }
+        return true;
+    }
+#endif
+
+    // one broadcast round: snapshot publish counts, ping, and (optionally) wait for every thread to publish
+    inline bool pingRound(const int tid, const bool includeSelf) {
+        uint64_t * const seen = &seenPublishCount[tid * NUM_PROCESSES];
+        int * const tids = &roundTids[tid * NUM_PROCESSES];
+        const int numTids = liveThreads->snapshot(tids);
+        for (int i = 0; i < numTids; ++i) {
+            seen[tids[i]] = state[tids[i]].publishCount.load(std::memory_order_acquire);
+        }
+        const uint64_t startTime = get_server_clock();
+        int sent = 0;
+        int coalesced = 0;
+        bool result = true;
+
+#ifdef PING_TREE_FANOUT
+        if (includeSelf && sendPing(tid, tid, -1)) ++sent;
+        sent += pingChildren(tid, tid);
+#else
+        for (int i = 0; i < numTids; ++i) {
+            const int otherTid = tids[i];
+            if (otherTid == tid && !includeSelf) continue;
+            if (canSkip(otherTid, seen[otherTid])) {
+                ++coalesced;
+                continue;
+            }
+            if (!sendPing(tid, otherTid, -1)) {
+                result = false;
+                break;
+            }
+            ++sent;
+        }
+#endif
+
+#ifdef PING_WAIT_FOR_PUBLISH
+        if (result) {
+            result = awaitPublished(tid, numTids, includeSelf, startTime, &sent);
+    #ifdef USE_GSTATS
+            if (result) GSTATS_APPEND(tid, ping_to_publish_latency, get_server_clock() - startTime);
+    #endif
+        }
+#endif
+#ifdef USE_GSTATS
+        GSTATS_ADD(tid, pings_sent, sent);
+        GSTATS_ADD(tid, pings_coalesced, coalesced);
+#endif
+        return result;
+    }
+
+public:
+    PingDelivery(const int numProcesses, const int _signum, ThreadSignals * const _signals, const ThreadRegistry * const _liveThreads)
+            : NUM_PROCESSES(numProcesses)
+            , signum(_signum)
+            , signals(_signals)
+            , liveThreads(_liveThreads)
+            , seenPublishCount(new uint64_t[numProcesses * numProcesses])
+            , roundTids(new int[numProcesses * numProcesses]) {
+        for (int i = 0; i < MAX_THREADS_POW2; ++i) {
+            state[i].publishCount.store(0, std::memory_order_relaxed);
+            state[i].inOp.store(false, std::memory_order_relaxed);
+        }
+        roundsStarted.store(0, std::memory_order_relaxed);
+        roundsCompleted.store(1, std::memory_order_relaxed); // round 0 completed successfully
+#ifdef POP_PUBLISH_MEMBARRIER
+        if (init_membarrier_private_expedited()) exit(EXIT_FAILURE);
+#endif
+    }
+    ~PingDelivery() {
+        delete[] seenPublishCount;
+        delete[] roundTids;
+    }
+
+    // PING_SKIP_QUIESCENT: announce that tid is (not) inside an operation. the store in
+    // enterOp must be seq_cst so a reclaimer cannot miss it after unlinking a record tid reads.
+    inline void enterOp(const int tid) {
+        state[tid].inOp.store(true, std::memory_order_seq_cst);
+    }
+    inline void exitOp(const int tid) {
+        state[tid].inOp.store(false, std::memory_order_release);
+    }
+
+    // called from the signal handler of a pinged thread, before and after it publishes
+    inline void onPing(const int tid, const siginfo_t * const info) {
+#ifdef PING_TREE_FANOUT
+        if (info->si_code == SI_QUEUE) {
+            const int sent = pingChildren(tid, info->si_value.sival_int);
+    #ifdef USE_GSTATS
+            GSTATS_ADD(tid, pings_sent, sent);
+    #endif
+        }
+#endif
+    }
+    inline void onPublished(const int tid) {
+        state[tid].publishCount.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Pings all other threads so they publish their reservations.
+     * Returns false if tid must not reclaim on the basis of this round.
+     */
+    inline bool pingAll(const int tid) {
+        RECLAMATION_EVENT;
+#if defined(POP_PUBLISH_MEMBARRIER)
+        const uint64_t startTime = get_server_clock();
+        if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0)) {
+            COUTATOMICTID("Error when trying to membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED)" << std::endl);
+            return false;
+        }
+    #ifdef USE_GSTATS
+        GSTATS_APPEND(tid, ping_to_publish_latency, get_server_clock() - startTime);
+    #endif
+        return true;
+#elif defined(PING_COMBINING)
+        const uint64_t entryRound = roundsStarted.load(std::memory_order_acquire);
+        while (true) {
+            const uint64_t completed = roundsCompleted.load(std::memory_order_acquire);
+            if ((completed >> 1) > entryRound) {
+                // a round that began after we arrived has completed: its publishes cover our retired records
+    #ifdef USE_GSTATS
+                GSTATS_ADD(tid, pings_coalesced, liveThreads->size() - 1);
+    #endif
+                return completed & 1;
+            }
+            uint64_t idle = completed >> 1;
+            if (roundsStarted.load(std::memory_order_relaxed) == idle
+                    && roundsStarted.compare_exchange_strong(idle, idle + 1, std::memory_order_acq_rel)) {
+                // the leader pings itself too, since waiting threads also rely on its reservations
+                const bool result = pingRound(tid, true);
+                roundsCompleted.store(((idle + 1) << 1) | (result ? 1 : 0), std::memory_order_release);
+                return result;
+            }
+            sched_yield();
+        }
+#else
+        return pingRound(tid, false);
+#endif
+    }
+};
+
+#endif /* PING_DELIVERY_H */
@@ -17,8 +17,12 @@
 
 template <typename T = void, class Alloc = allocator_interface<T> >
 class pool_none : public pool_interface<T, Alloc> {
+private:
+    PAD; // post padding for pool_interface
+    blockbag<T> **scratchBag; // scratchBag[tid] holds the blocks addMoveFullBlocks(tid, bag, predecessor) frees
+    PAD;
+
 public:
-    PAD; // final padding after superclass layout
 
     template <typename _Tp1>
     struct rebindAlloc {
@@ -44,13 +48,16 @@ public:
         return this->alloc->allocate(tid);
     }
     inline void add(const int tid, T* ptr) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, 1);
         this->alloc->deallocate(tid, ptr);
     }
     inline void addMoveFullBlocks(const int tid, blockbag<T> *bag, block<T> * const predecessor) {
-        bag->clearWithoutFreeingElements();
-        // note: this will leak memory, but i believe it is only used by debraplus (which really should use a pool)
+        scratchBag[tid]->appendMoveFullBlocks(bag, predecessor);
+        MEMORY_STATS this->alloc->debug->addToPool(tid, scratchBag[tid]->computeSize());
+        this->alloc->deallocateAndClear(tid, scratchBag[tid]);
     }
     inline void addMoveFullBlocks(const int tid, blockbag<T> *bag) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, bag->computeSize());
         this->alloc->deallocateAndClear(tid, bag);
 //        T* ptr;
 //        while (ptr = bag->remove()) {
@@ -58,6 +65,7 @@ public:
 //        }
     }
     inline void addMoveAll(const int tid, blockbag<T> *bag) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, bag->computeSize());
         this->alloc->deallocateAndClear(tid, bag);
 //        T* ptr;
 //        while (ptr = bag->remove()) {
@@ -78,9 +86,17 @@ public:
     pool_none(const int numProcesses, Alloc * const _alloc, debugInfo * const _debug)
             : pool_interface<T, Alloc>(numProcesses, _alloc, _debug) {
         VERBOSE DEBUG std::cout<<"constructor pool_none"<<std::endl;
+        scratchBag = new blockbag<T>*[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            scratchBag[tid] = new blockbag<T>(tid, this->blockpools[tid]);
+        }
     }
     ~pool_none() {
         VERBOSE DEBUG std::cout<<"destructor pool_none"<<std::endl;
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            delete scratchBag[tid];
+        }
+        delete[] scratchBag;
     }
 };
 
@@ -0,0 +1,283 @@
+/**
+ * NUMA-aware object pool for the record manager.
+ *
+ * Every record freed into the pool is sent back to its home NUMA node, i.e.,
+ * the node that holds the record's page. (This is not necessarily the node of
+ * the thread that allocated it, e.g., under numactl --interleave.) add() asks
+ * the kernel for the node of a page (get_mempolicy with MPOL_F_NODE and
+ * MPOL_F_ADDR) the first time it sees the page, and caches the answer in a
+ * shared page table, so the free path makes a syscall only when a page is not
+ * in the table. Records whose home is the freeing thread's own node go to that
+ * thread's local free bag. Records from other nodes are batched per node and
+ * handed off a full block at a time to that node's shared lock-free bag. get()
+ * serves a thread from its local bag, then from a full block in its node's
+ * shared bag, and only then from Alloc, so reused records are always on the
+ * thread's node.
+ *
+ * Without USE_LIBNUMA every record and thread is on node 0, and this pool
+ * behaves like pool_perthread_and_shared.
+ *
+ * GSTATS: numa_local_frees / numa_remote_frees count records freed on / off
+ * their home node; numa_pool_local_hits / numa_pool_misses count get()s served
+ * by node-local records / by Alloc.
+ */
+
+#ifndef POOL_NUMA_H
+#define	POOL_NUMA_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include "blockbag.h"
+#include "blockpool.h"
+#include "errors.h"
+#include "lockfreeblockbag.h"
+#include "pool_interface.h"
+#include "plaf.h"
+#ifdef USE_LIBNUMA
+#include <numaif.h>
+#include "numa_tools.h"
+#endif
+
+// a thread keeps at most this many blocks of node-local records in its free bag;
+// full blocks beyond this are handed off to its node's shared bag
+#ifndef POOL_THRESHOLD_IN_BLOCKS
+#define POOL_THRESHOLD_IN_BLOCKS 8
+#endif
+
+// number of (page -> node) entries in the shared table (a power of two)
+#ifndef POOL_NUMA_PAGE_TABLE_SIZE
+#define POOL_NUMA_PAGE_TABLE_SIZE (1<<18)
+#endif
+#define POOL_NUMA_PAGE_SHIFT 12
+#define POOL_NUMA_NODE_BITS 8
+
+template <typename T = void, class Alloc = allocator_interface<T> >
+class pool_numa : public pool_interface<T, Alloc> {
+private:
+    struct ThreadState {
+        PAD;
+        int node;                                       // node this thread runs on
+        PAD;
+    };
+
+    PAD; // post padding for pool_interface
+    int numNodes;
+    lockfreeblockbag<T> *nodeBag;       // nodeBag[node] = full blocks of records whose home is node
+    blockbag<T> **freeBag;              // freeBag[tid*numNodes + node] = records with home node freed by tid
+    blockbag<T> **scratchBag;           // scratchBag[tid] is used to split bags passed to addMove* by node
+    ThreadState *threadState;
+    std::atomic<uint64_t> *pageTable;   // cached page homes: (page << POOL_NUMA_NODE_BITS) | node, or 0 if empty
+    PAD;
+
+    inline blockbag<T> * bagFor(const int tid, const int node) {
+        return freeBag[tid*numNodes + node];
+    }
+
+    static inline int pageIndex(const uint64_t page) {
+        return (int) (murmur3(page) & (POOL_NUMA_PAGE_TABLE_SIZE - 1));
+    }
+
+    // the node that holds the page of ptr, or -1 if it cannot be determined
+    static inline int queryNode(T * const ptr) {
+#ifdef USE_LIBNUMA
+        int node = -1;
+        if (get_mempolicy(&node, NULL, 0, (void *) ptr, MPOL_F_NODE | MPOL_F_ADDR)) return -1;
+        return node;
+#else
+        return 0;
+#endif
+    }
+
+    inline int homeNode(const int tid, T * const ptr) {
+        if (numNodes == 1) return 0;
+        const uint64_t page = ((uintptr_t) ptr) >> POOL_NUMA_PAGE_SHIFT;
+        std::atomic<uint64_t> * const slot = &pageTable[pageIndex(page)];
+        const uint64_t entry = slot->load(std::memory_order_relaxed);
+        if ((entry >> POOL_NUMA_NODE_BITS) == page) {
+            return (int) (entry & ((1ULL << POOL_NUMA_NODE_BITS) - 1));
+        }
+        const int node = queryNode(ptr);
+        if (node < 0 || node >= numNodes) return threadState[tid].node;
+        slot->store((page << POOL_NUMA_NODE_BITS) | (uint64_t) node, std::memory_order_relaxed);
+        return node;
+    }
+
+    static inline uint64_t murmur3(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // hand full blocks of node's records off to node's shared bag,
+    // keeping up to keepBlocks blocks in the bag of tid
+    inline void offloadFullBlocks(const int tid, const int node, const int keepBlocks) {
+        blockbag<T> * const bag = bagFor(tid, node);
+        while (bag->getSizeInBlocks() > keepBlocks) {
+            block<T> * const b = bag->removeFullBlock(); // returns NULL if bag has < 2 full blocks
+            if (b == NULL) break;
+            nodeBag[node].addBlock(b);
+            MEMORY_STATS this->alloc->debug->addGiven(tid, 1);
+        }
+    }
+
+public:
+    template <typename _Tp1>
+    struct rebindAlloc {
+        typedef typename Alloc::template rebind<_Tp1>::other other;
+    };
+    template<typename _Tp1>
+    struct rebind {
+        typedef pool_numa<_Tp1, Alloc> other;
+    };
+    template<typename _Tp1, typename _Tp2>
+    struct rebind2 {
+        typedef pool_numa<_Tp1, _Tp2> other;
+    };
+
+    std::string getSizeString() {
+        std::stringstream ss;
+        for (int node=0;node<numNodes;++node) {
+            long long inFreeBags = 0;
+            for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+                inFreeBags += bagFor(tid, node)->computeSize();
+            }
+            ss<<(node ? ", " : "")<<"node "<<node<<": "<<inFreeBags<<" in free bags and "<<nodeBag[node].size()<<" in shared bag";
+        }
+        return ss.str();
+    }
+    inline T* get(const int tid) {
+        const int node = threadState[tid].node;
+        blockbag<T> * const bag = bagFor(tid, node);
+        if (bag->isEmpty()) {
+            block<T> * const b = nodeBag[node].getBlock();
+            if (b == NULL) {
+#ifdef USE_GSTATS
+                GSTATS_ADD(tid, numa_pool_misses, 1);
+#endif
+                return this->alloc->allocate(tid);
+            }
+            bag->addFullBlock(b);
+            MEMORY_STATS this->alloc->debug->addTaken(tid, 1);
+        }
+#ifdef USE_GSTATS
+        GSTATS_ADD(tid, numa_pool_local_hits, 1);
+#endif
+        MEMORY_STATS2 this->alloc->debug->addFromPool(tid, 1);
+        return bag->remove();
+    }
+    inline void add(const int tid, T* ptr) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, 1);
+        const int node = homeNode(tid, ptr);
+        bagFor(tid, node)->add(ptr);
+        if (node == threadState[tid].node) {
+#ifdef USE_GSTATS
+            GSTATS_ADD(tid, numa_local_frees, 1);
+#endif
+            offloadFullBlocks(tid, node, POOL_THRESHOLD_IN_BLOCKS);
+        } else {
+#ifdef USE_GSTATS
+            GSTATS_ADD(tid, numa_remote_frees, 1);
+#endif
+            // batch remote frees: ship each block to its home node as soon as it fills
+            offloadFullBlocks(tid, node, 1);
+        }
+    }
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag, block<T> * const predecessor) {
+        scratchBag[tid]->appendMoveFullBlocks(bag, predecessor);
+        while (!scratchBag[tid]->isEmpty()) {
+            add(tid, scratchBag[tid]->remove());
+        }
+    }
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag) {
+        scratchBag[tid]->appendMoveFullBlocks(bag);
+        while (!scratchBag[tid]->isEmpty()) {
+            add(tid, scratchBag[tid]->remove());
+        }
+    }
+    inline void addMoveAll(const int tid, blockbag<T> *bag) {
+        while (!bag->isEmpty()) {
+            add(tid, bag->remove());
+        }
+    }
+    inline int computeSize(const int tid) {
+        int result = 0;
+        for (int node=0;node<numNodes;++node) {
+            result += bagFor(tid, node)->computeSize();
+        }
+        return result;
+    }
+
+    void debugPrintStatus(const int tid) {
+        std::cout<<"thread "<<tid<<" on node "<<threadState[tid].node<<" has "<<computeSize(tid)<<" objects in its free bags"<<std::endl;
+    }
+
+    void initThread(const int tid) {
+#ifdef USE_LIBNUMA
+        const int node = __numa.get_node_slow();
+        threadState[tid].node = (node >= 0 && node < numNodes) ? node : 0;
+#endif
+    }
+    void deinitThread(const int tid) {}
+
+    pool_numa(const int numProcesses, Alloc * const _alloc, debugInfo * const _debug)
+            : pool_interface<T, Alloc>(numProcesses, _alloc, _debug) {
+        VERBOSE DEBUG std::cout<<"constructor pool_numa"<<std::endl;
+#ifdef USE_LIBNUMA
+        numNodes = __numa.get_num_nodes();
+        if (numNodes < 1) numNodes = 1;
+        if (numNodes > (1 << POOL_NUMA_NODE_BITS)) {
+            setbench_error("pool_numa supports at most "<<(1 << POOL_NUMA_NODE_BITS)<<" NUMA nodes");
+        }
+#else
+        numNodes = 1;
+#endif
+        nodeBag = new lockfreeblockbag<T>[numNodes];
+        freeBag = new blockbag<T>*[numProcesses*numNodes];
+        scratchBag = new blockbag<T>*[numProcesses];
+        threadState = new ThreadState[numProcesses];
+        pageTable = new std::atomic<uint64_t>[POOL_NUMA_PAGE_TABLE_SIZE];
+        for (int i=0;i<POOL_NUMA_PAGE_TABLE_SIZE;++i) {
+            pageTable[i].store(0, std::memory_order_relaxed);
+        }
+        for (int tid=0;tid<numProcesses;++tid) {
+            for (int node=0;node<numNodes;++node) {
+                freeBag[tid*numNodes + node] = new blockbag<T>(tid, this->blockpools[tid]);
+            }
+            scratchBag[tid] = new blockbag<T>(tid, this->blockpools[tid]);
+            threadState[tid].node = 0;
+        }
+    }
+    ~pool_numa() {
+        VERBOSE DEBUG std::cout<<"destructor pool_numa"<<std::endl;
+        // return the objects in the shared bags to the allocator
+        const int dummyTid = 0;
+        for (int node=0;node<numNodes;++node) {
+            block<T> *b;
+            while ((b = nodeBag[node].getBlock()) != NULL) {
+                while (!b->isEmpty()) {
+                    this->alloc->deallocate(dummyTid, b->pop());
+                }
+                this->blockpools[dummyTid]->deallocateBlock(b);
+            }
+        }
+        delete[] nodeBag;
+        // return the objects in the free bags to the allocator
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            for (int node=0;node<numNodes;++node) {
+                this->alloc->deallocateAndClear(tid, bagFor(tid, node));
+                delete bagFor(tid, node);
+            }
+            delete scratchBag[tid];
+        }
+        delete[] freeBag;
+        delete[] scratchBag;
+        delete[] threadState;
+        delete[] pageTable;
+    }
+};
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * Object pool that offloads freeing to reclamation helper threads.
+ *
+ * Records freed into the pool are safe to free, so rather than returning them
+ * to Alloc on the application thread, each thread collects them in its own
+ * staging bag, and hands each full block off to a per-thread lock-free bag
+ * that one of the helper threads in reclaim_helpers.h drains. Application
+ * threads thus pay only for retiring records and for one push per block,
+ * while the helpers pay for free(). The pool does not reuse records: get()
+ * always allocates from Alloc.
+ *
+ * While no helpers are running (e.g., during prefilling, or with
+ * -reclaim-helpers 0), records are returned to Alloc immediately, as with
+ * pool_none. Blocks still queued when the helpers stop are freed by the
+ * destructor.
+ */
+
+#ifndef POOL_OFFLOAD_H
+#define	POOL_OFFLOAD_H
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include "blockbag.h"
+#include "blockpool.h"
+#include "lockfreeblockbag.h"
+#include "pool_interface.h"
+#include "reclaim_helpers.h"
+#include "plaf.h"
+
+template <typename T = void, class Alloc = allocator_interface<T> >
+class pool_offload : public pool_interface<T, Alloc> {
+private:
+    PAD; // post padding for pool_interface
+    blockbag<T> **stageBag;             // stageBag[tid] = records freed by tid that have not been handed off
+    lockfreeblockbag<T> *handoffBag;    // handoffBag[tid] = full blocks freed by tid, waiting for a helper
+    PAD;
+
+    // hand full blocks off to the helpers, keeping at most one full block in tid's staging bag
+    inline void handOffFullBlocks(const int tid) {
+        block<T> * b;
+        while ((b = stageBag[tid]->removeFullBlock()) != NULL) { // returns NULL if stageBag has < 2 full blocks
+            handoffBag[tid].addBlock(b);
+            MEMORY_STATS this->alloc->debug->addGiven(tid, 1);
+        }
+    }
+
+    // invoked after records are moved into tid's staging bag
+    inline void afterStaging(const int tid) {
+        if (reclaimHelpers().isRunning()) {
+            handOffFullBlocks(tid);
+        } else {
+            this->alloc->deallocateAndClear(tid, stageBag[tid]);
+        }
+    }
+
+    // invoked by the helper responsible for tid (see reclaim_helpers.h),
+    // which frees with deallocateRemote() since tid keeps allocating
+    static size_t drain(void * const pool, const int tid) {
+        pool_offload<T, Alloc> * const p = (pool_offload<T, Alloc> *) pool;
+        size_t freed = 0;
+        block<T> * b;
+        while ((b = p->handoffBag[tid].getBlock()) != NULL) {
+            while (!b->isEmpty()) {
+                p->alloc->deallocateRemote(tid, b->pop());
+                ++freed;
+            }
+            delete b; // blocks are owned by tid's blockpool, which the helper must not touch
+        }
+        return freed;
+    }
+
+public:
+    template <typename _Tp1>
+    struct rebindAlloc {
+        typedef typename Alloc::template rebind<_Tp1>::other other;
+    };
+    template<typename _Tp1>
+    struct rebind {
+        typedef pool_offload<_Tp1, Alloc> other;
+    };
+    template<typename _Tp1, typename _Tp2>
+    struct rebind2 {
+        typedef pool_offload<_Tp1, _Tp2> other;
+    };
+
+    std::string getSizeString() {
+        std::stringstream ss;
+        long long inStageBags = 0;
+        long long inHandoffBags = 0;
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            inStageBags += stageBag[tid]->computeSize();
+            inHandoffBags += handoffBag[tid].size();
+        }
+        ss<<inStageBags<<" in staging bags and "<<inHandoffBags<<" waiting for helpers";
+        return ss.str();
+    }
+    inline T* get(const int tid) {
+        MEMORY_STATS2 this->alloc->debug->addFromPool(tid, 1);
+        return this->alloc->allocate(tid);
+    }
+    inline void add(const int tid, T* ptr) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, 1);
+        if (!reclaimHelpers().isRunning()) {
+            this->alloc->deallocate(tid, ptr);
+            return;
+        }
+        stageBag[tid]->add(ptr);
+        if (stageBag[tid]->getSizeInBlocks() > 2) handOffFullBlocks(tid);
+    }
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag, block<T> * const predecessor) {
+        const int size = bag->computeSizeFast();
+        stageBag[tid]->appendMoveFullBlocks(bag, predecessor);
+        MEMORY_STATS this->alloc->debug->addToPool(tid, size - bag->computeSizeFast()); // the records moved
+        afterStaging(tid);
+    }
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag) {
+        const int size = bag->computeSizeFast();
+        stageBag[tid]->appendMoveFullBlocks(bag);
+        MEMORY_STATS this->alloc->debug->addToPool(tid, size - bag->computeSizeFast()); // the records moved
+        afterStaging(tid);
+    }
+    inline void addMoveAll(const int tid, blockbag<T> *bag) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, bag->computeSize());
+        stageBag[tid]->appendMoveAll(bag);
+        afterStaging(tid);
+    }
+    inline int computeSize(const int tid) {
+        return stageBag[tid]->computeSize();
+    }
+
+    void debugPrintStatus(const int tid) {
+        std::cout<<"staging bag of thread "<<tid<<" contains "<<stageBag[tid]->computeSize()<<" objects in "<<stageBag[tid]->getSizeInBlocks()<<" blocks"<<std::endl;
+    }
+
+    void initThread(const int tid) {}
+    void deinitThread(const int tid) {}
+
+    pool_offload(const int numProcesses, Alloc * const _alloc, debugInfo * const _debug)
+            : pool_interface<T, Alloc>(numProcesses, _alloc, _debug) {
+        VERBOSE DEBUG std::cout<<"constructor pool_offload"<<std::endl;
+        stageBag = new blockbag<T>*[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            stageBag[tid] = new blockbag<T>(tid, this->blockpools[tid]);
+        }
+        handoffBag = new lockfreeblockbag<T>[numProcesses];
+        reclaimHelpers().registerQueue(this, drain, numProcesses);
+    }
+    ~pool_offload() {
+        VERBOSE DEBUG std::cout<<"destructor pool_offload"<<std::endl;
+        reclaimHelpers().unregisterQueue(this);
+        // return the objects that were never handed off, or that the helpers did not get to, to the allocator
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            drain(this, tid);
+            this->alloc->deallocateAndClear(tid, stageBag[tid]);
+            delete stageBag[tid];
+        }
+        delete[] stageBag;
+        delete[] handoffBag;
+    }
+};
+
+#endif
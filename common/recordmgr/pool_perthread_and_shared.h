@@ -0,0 +1,147 @@
+/**
+ * C++ record manager implementation (PODC 2015) by Trevor Brown.
+ *
+ * Copyright (C) 2015 Trevor Brown
+ *
+ */
+
+#ifndef POOL_PERTHREAD_AND_SHARED_H
+#define	POOL_PERTHREAD_AND_SHARED_H
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include "blockbag.h"
+#include "blockpool.h"
+#include "lockfreeblockbag.h"
+#include "pool_interface.h"
+#include "plaf.h"
+
+// a thread keeps at most this many blocks in its free bag;
+// full blocks beyond this are handed off to the shared bag
+#ifndef POOL_THRESHOLD_IN_BLOCKS
+#define POOL_THRESHOLD_IN_BLOCKS 8
+#endif
+
+template <typename T = void, class Alloc = allocator_interface<T> >
+class pool_perthread_and_shared : public pool_interface<T, Alloc> {
+private:
+    PAD; // post padding for pool_interface
+    lockfreeblockbag<T> *sharedBag;     // full blocks offloaded by threads whose free bags grew too large
+    blockbag<T> **freeBag;              // freeBag[tid] = objects that thread tid can reuse
+    PAD;
+
+    // hand full blocks off to the shared bag until tid's free bag is back under the threshold
+    inline void offloadFullBlocks(const int tid) {
+        while (freeBag[tid]->getSizeInBlocks() > POOL_THRESHOLD_IN_BLOCKS) {
+            block<T> * const b = freeBag[tid]->removeFullBlock(); // returns NULL if freeBag has < 2 full blocks
+            if (b == NULL) break;
+            sharedBag->addBlock(b);
+            MEMORY_STATS this->alloc->debug->addGiven(tid, 1);
+        }
+    }
+
+public:
+    template <typename _Tp1>
+    struct rebindAlloc {
+        typedef typename Alloc::template rebind<_Tp1>::other other;
+    };
+    template<typename _Tp1>
+    struct rebind {
+        typedef pool_perthread_and_shared<_Tp1, Alloc> other;
+    };
+    template<typename _Tp1, typename _Tp2>
+    struct rebind2 {
+        typedef pool_perthread_and_shared<_Tp1, _Tp2> other;
+    };
+
+    std::string getSizeString() {
+        std::stringstream ss;
+        long long inFreeBags = 0;
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            inFreeBags += freeBag[tid]->computeSize();
+        }
+        ss<<inFreeBags<<" in free bags and "<<sharedBag->size()<<" in shared bag";
+        return ss.str();
+    }
+    /**
+     * if the freebag contains any object, then remove one from the freebag
+     * and return a pointer to it.
+     * if not, then try to take a full block from the shared bag,
+     * and if that fails, retrieve a new object from Alloc.
+     */
+    inline T* get(const int tid) {
+        if (freeBag[tid]->isEmpty()) {
+            block<T> * const b = sharedBag->getBlock();
+            if (b == NULL) {
+                return this->alloc->allocate(tid);
+            }
+            freeBag[tid]->addFullBlock(b);
+            MEMORY_STATS this->alloc->debug->addTaken(tid, 1);
+        }
+        MEMORY_STATS2 this->alloc->debug->addFromPool(tid, 1);
+        return freeBag[tid]->remove();
+    }
+    inline void add(const int tid, T* ptr) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, 1);
+        freeBag[tid]->add(tid, ptr, sharedBag, POOL_THRESHOLD_IN_BLOCKS, this->alloc);
+    }
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag, block<T> * const predecessor) {
+        const int size = bag->computeSizeFast();
+        freeBag[tid]->appendMoveFullBlocks(bag, predecessor);
+        MEMORY_STATS this->alloc->debug->addToPool(tid, size - bag->computeSizeFast()); // the records moved
+        offloadFullBlocks(tid);
+    }
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag) {
+        const int size = bag->computeSizeFast();
+        freeBag[tid]->appendMoveFullBlocks(bag);
+        MEMORY_STATS this->alloc->debug->addToPool(tid, size - bag->computeSizeFast()); // the records moved
+        offloadFullBlocks(tid);
+    }
+    inline void addMoveAll(const int tid, blockbag<T> *bag) {
+        MEMORY_STATS this->alloc->debug->addToPool(tid, bag->computeSize());
+        freeBag[tid]->appendMoveAll(bag);
+        offloadFullBlocks(tid);
+    }
+    inline int computeSize(const int tid) {
+        return freeBag[tid]->computeSize();
+    }
+
+    void debugPrintStatus(const int tid) {
+        std::cout<<"free bag of thread "<<tid<<" contains "<<freeBag[tid]->computeSize()<<" objects in "<<freeBag[tid]->getSizeInBlocks()<<" blocks"<<std::endl;
+    }
+
+    void initThread(const int tid) {}
+    void deinitThread(const int tid) {}
+
+    pool_perthread_and_shared(const int numProcesses, Alloc * const _alloc, debugInfo * const _debug)
+            : pool_interface<T, Alloc>(numProcesses, _alloc, _debug) {
+        VERBOSE DEBUG std::cout<<"constructor pool_perthread_and_shared"<<std::endl;
+        freeBag = new blockbag<T>*[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            freeBag[tid] = new blockbag<T>(tid, this->blockpools[tid]);
+        }
+        sharedBag = new lockfreeblockbag<T>();
+    }
+    ~pool_perthread_and_shared() {
+        VERBOSE DEBUG std::cout<<"destructor pool_perthread_and_shared"<<std::endl;
+        // return the objects in the shared bag to the allocator
+        const int dummyTid = 0;
+        block<T> *b;
+        while ((b = sharedBag->getBlock()) != NULL) {
+            while (!b->isEmpty()) {
+                this->alloc->deallocate(dummyTid, b->pop());
+            }
+            this->blockpools[dummyTid]->deallocateBlock(b);
+        }
+        delete sharedBag;
+        // return the objects in the free bags to the allocator
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            this->alloc->deallocateAndClear(tid, freeBag[tid]);
+            delete freeBag[tid];
+        }
+        delete[] freeBag;
+    }
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * File:   reclaim_controller.h
+ *
+ * Online tuning of the watermarks of the signalling reclaimers (nbr, nbrplus,
+ * ibr_popplushp, rcu_popplus, rcu_popplushp, nbr_popplushe).
+ *
+ * Each thread has a high watermark (hiWm): the retired bag size at which it
+ * signals all other threads and empties its bag. The hiWm starts at the
+ * reclaimer's compile-time bag capacity, and is adjusted after every such
+ * HiWm reclamation event, from what that event cost and achieved:
+ *  - if total garbage (over all threads and reclaimers) exceeds the budget
+ *    set with setReclaimGarbageBudgetBytes(), the hiWm is halved. Each thread
+ *    reports its bag size to the total every RECLAIM_CONTROLLER_REPORT_RETIRES
+ *    retires (see onRetire), as well as at every reclamation event, so the
+ *    total is at most that many retires per thread out of date;
+ *  - if the event freed less than RECLAIM_CONTROLLER_MIN_YIELD of the bag
+ *    (most records were still protected, so signalling again soon is
+ *    pointless), or if signalling cost more than
+ *    RECLAIM_CONTROLLER_SIGNAL_NS_PER_FREED per freed record, the hiWm grows
+ *    by a quarter, so that fewer signalling rounds amortize the cost over more
+ *    records;
+ *  - otherwise the hiWm shrinks by an eighth, to save memory.
+ * The hiWm stays within [capacity/8, capacity*2], and below the per-thread
+ * share of the budget. Signalling cost grows with the number of threads, so
+ * few threads settle on small bags and many threads on large ones.
+ *
+ * The controller also draws the randomized LoWm reclaim attempt frequencies
+ * from a per-thread RandomFNV1A, rather than from the non-thread-safe rand().
+ *
+ * With -DRECLAIM_CONTROLLER_STATIC the hiWm never changes.
+ */
+
+#ifndef RECLAIM_CONTROLLER_H
+#define RECLAIM_CONTROLLER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "plaf.h"
+#include "random_fnv1a.h"
+#include "server_clock.h"
+
+#ifndef RECLAIM_CONTROLLER_MIN_YIELD
+#define RECLAIM_CONTROLLER_MIN_YIELD 0.5
+#endif
+#ifndef RECLAIM_CONTROLLER_SIGNAL_NS_PER_FREED
+#define RECLAIM_CONTROLLER_SIGNAL_NS_PER_FREED 10
+#endif
+#ifndef RECLAIM_CONTROLLER_REPORT_RETIRES
+#define RECLAIM_CONTROLLER_REPORT_RETIRES 64
+#endif
+
+struct reclaim_garbage_t {
+    PAD;
+    std::atomic<int64_t> bytes;   // garbage reported by all controllers
+    PAD;
+    uint64_t budgetBytes;         // 0 means no budget
+    PAD;
+};
+
+inline reclaim_garbage_t & reclaimGarbage() {
+    static reclaim_garbage_t garbage;
+    return garbage;
+}
+
+inline void setReclaimGarbageBudgetBytes(const uint64_t bytes) {
+    reclaimGarbage().budgetBytes = bytes;
+}
+
+class ReclaimController {
+private:
+    struct ThreadState {
+        PAD;
+        RandomFNV1A rng;
+        uint64_t hiWm;
+        int64_t reportedBytes;  // this thread's contribution to reclaimGarbage().bytes
+        uint64_t retiresSinceReport;
+        uint64_t signalStart;
+        uint64_t signalNs;
+        uint64_t numHiWmEvents;
+        PAD;
+    };
+
+    int numProcesses;
+    uint64_t capacity;
+    uint64_t minHiWm;
+    uint64_t maxHiWm;
+    size_t recordSize;
+    ThreadState * threads;
+
+    inline void report(const int tid, const size_t bagSize) {
+        const int64_t bytes = (int64_t) (bagSize * recordSize);
+        const int64_t delta = bytes - threads[tid].reportedBytes;
+        if (delta) reclaimGarbage().bytes.fetch_add(delta, std::memory_order_relaxed);
+        threads[tid].reportedBytes = bytes;
+        threads[tid].retiresSinceReport = 0;
+    }
+
+public:
+    ReclaimController() : threads(NULL) {}
+    ~ReclaimController() {
+        delete[] threads;
+    }
+
+    // capacity is the reclaimer's compile-time retired bag capacity
+    void init(const int _numProcesses, const uint64_t _capacity, const size_t _recordSize) {
+        numProcesses = _numProcesses;
+        capacity = _capacity;
+        minHiWm = std::max((uint64_t) 1, capacity / 8);
+        maxHiWm = capacity * 2;
+        recordSize = _recordSize;
+        delete[] threads;
+        threads = new ThreadState[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            threads[tid].hiWm = capacity;
+            threads[tid].reportedBytes = 0;
+            threads[tid].retiresSinceReport = 0;
+            threads[tid].signalNs = 0;
+            threads[tid].numHiWmEvents = 0;
+        }
+    }
+
+    // seeds the thread's random numbers (so invoke this before nextRandom());
+    // initialHiWm = 0 means the capacity
+    void initThread(const int tid, const uint64_t initialHiWm = 0) {
+        threads[tid].rng.setSeed(get_server_clock() ^ ((tid+1) * 0x9E3779B97F4A7C15ULL));
+        setHiWm(tid, initialHiWm ? initialHiWm : capacity);
+    }
+
+    inline void setHiWm(const int tid, const uint64_t hiWm) {
+        threads[tid].hiWm = hiWm;
+    }
+
+    // invoke after the thread's retired bag has been emptied for good
+    void deinitThread(const int tid) {
+        report(tid, 0);
+    }
+
+    inline uint64_t hiWm(const int tid) const {
+        return threads[tid].hiWm;
+    }
+
+    inline uint64_t nextRandom(const int tid, const uint64_t n) {
+        return threads[tid].rng.next(n);
+    }
+
+    // a random number of retires between LoWm reclaim attempts:
+    // minFraction, 5%, 10%, ..., or 50% of the hiWm, with equal probability
+    inline unsigned int nextLoAttemptFreq(const int tid, const double minFraction) {
+        const int r = (int) nextRandom(tid, 11);
+        const uint64_t freq = (r == 0) ? (uint64_t) (minFraction * threads[tid].hiWm) : (uint64_t) threads[tid].hiWm * r * 5 / 100;
+        return (unsigned int) std::max((uint64_t) 1, freq);
+    }
+
+    // bracket the signalling of all threads in a HiWm event
+    inline void beginSignal(const int tid) {
+        threads[tid].signalStart = get_server_clock();
+    }
+    inline void endSignal(const int tid) {
+        threads[tid].signalNs = get_server_clock() - threads[tid].signalStart;
+    }
+
+    // invoke after every retire, with the thread's retired bag size
+    inline void onRetire(const int tid, const size_t bagSize) {
+        if (++threads[tid].retiresSinceReport >= RECLAIM_CONTROLLER_REPORT_RETIRES) {
+            report(tid, bagSize);
+        }
+    }
+
+    // invoke after a LoWm reclamation event
+    inline void onLoWmReclaim(const int tid, const size_t bagSizeBefore, const size_t bagSizeAfter) {
+        report(tid, bagSizeAfter);
+    }
+
+    // invoke after a HiWm reclamation event; returns the thread's new hiWm
+    uint64_t onHiWmReclaim(const int tid, const size_t bagSizeBefore, const size_t bagSizeAfter) {
+        ThreadState * const t = &threads[tid];
+        ++t->numHiWmEvents;
+        report(tid, bagSizeBefore);
+#ifndef RECLAIM_CONTROLLER_STATIC
+        const uint64_t freed = (bagSizeBefore > bagSizeAfter) ? bagSizeBefore - bagSizeAfter : 0;
+        const uint64_t budget = reclaimGarbage().budgetBytes;
+        uint64_t cap = maxHiWm;
+        if (budget) {
+            cap = std::max(minHiWm, std::min(cap, budget / (recordSize * numProcesses)));
+        }
+        uint64_t next = t->hiWm;
+        if (budget && reclaimGarbage().bytes.load(std::memory_order_relaxed) > (int64_t) budget) {
+            next = next / 2;
+        } else if (freed < RECLAIM_CONTROLLER_MIN_YIELD * bagSizeBefore
+                || t->signalNs > RECLAIM_CONTROLLER_SIGNAL_NS_PER_FREED * std::max(freed, (uint64_t) 1)) {
+            next = next + next / 4;
+        } else {
+            next = next - next / 8;
+        }
+        t->hiWm = std::max(minHiWm, std::min(cap, next));
+#endif
+        report(tid, bagSizeAfter);
+        return t->hiWm;
+    }
+
+    uint64_t averageHiWm() const {
+        uint64_t sum = 0;
+        for (int tid=0;tid<numProcesses;++tid) sum += threads[tid].hiWm;
+        return sum / numProcesses;
+    }
+};
+
+#endif /* RECLAIM_CONTROLLER_H */
@@ -0,0 +1,190 @@
+/*
+ * File:   reclaim_helpers.h
+ *
+ * Dedicated reclamation helper threads, which free records on behalf of the
+ * application threads (see pool_offload.h).
+ *
+ * A pool registers one handoff queue per record type. Application threads
+ * push whole blocks of records that are already safe to free onto their own
+ * queue (queue tid), and helper h drains the queues of threads h, h+H, h+2H,
+ * ..., where H is the number of helpers, returning each record to the
+ * allocator. So every application thread's records are freed by exactly one
+ * helper. The application thread keeps allocating with its tid meanwhile, so
+ * helpers free with the allocator's deallocateRemote(), which does not touch
+ * tid's private allocator state (e.g., allocator_slab's local free list).
+ *
+ * An idle helper yields RECLAIM_HELPER_IDLE_SPINS times, then sleeps for
+ * RECLAIM_HELPER_IDLE_SLEEP_US between polls, so helpers do not burn a core
+ * when there is little garbage.
+ *
+ * Helpers are pinned by a binding function passed to start(), so the harness
+ * can place them on spare cores or hyperthreads (see binding.h). Each helper
+ * measures its own CPU time with CLOCK_THREAD_CPUTIME_ID.
+ *
+ * Queues may only be registered and unregistered while helpers are stopped.
+ */
+
+#ifndef RECLAIM_HELPERS_H
+#define RECLAIM_HELPERS_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#include "errors.h"
+#include "plaf.h"
+
+#ifndef RECLAIM_HELPERS_MAX
+#define RECLAIM_HELPERS_MAX 64
+#endif
+#ifndef RECLAIM_HELPERS_MAX_QUEUES
+#define RECLAIM_HELPERS_MAX_QUEUES 16
+#endif
+#ifndef RECLAIM_HELPER_IDLE_SPINS
+#define RECLAIM_HELPER_IDLE_SPINS 64
+#endif
+#ifndef RECLAIM_HELPER_IDLE_SLEEP_US
+#define RECLAIM_HELPER_IDLE_SLEEP_US 50
+#endif
+
+// frees every block in queue's handoff queue for thread tid, and returns the number of records freed
+typedef size_t (*reclaim_drain_fn)(void * const queue, const int tid);
+
+class ReclaimHelpers {
+private:
+    struct HelperState {
+        PAD;
+        std::thread * thread;
+        uint64_t freed;
+        uint64_t cpuNs;
+        uint64_t wallNs;
+        PAD;
+    };
+    struct Queue {
+        void * queue;
+        reclaim_drain_fn drain;
+        int numProcesses;
+    };
+
+    PAD;
+    std::atomic<bool> running;
+    PAD;
+    int numHelpers;
+    void (*bindFn)(const int helper);
+    int numQueues;
+    Queue queues[RECLAIM_HELPERS_MAX_QUEUES];
+    HelperState helpers[RECLAIM_HELPERS_MAX];
+    PAD;
+
+    static uint64_t nowNs(const clockid_t clock) {
+        timespec ts;
+        clock_gettime(clock, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    size_t drainAll(const int helper) {
+        size_t freed = 0;
+        for (int q=0;q<numQueues;++q) {
+            for (int tid=helper;tid<queues[q].numProcesses;tid+=numHelpers) {
+                freed += queues[q].drain(queues[q].queue, tid);
+            }
+        }
+        return freed;
+    }
+
+    static void run(ReclaimHelpers * const self, const int helper) {
+        HelperState * const h = &self->helpers[helper];
+        if (self->bindFn) self->bindFn(helper);
+        const uint64_t cpuStart = nowNs(CLOCK_THREAD_CPUTIME_ID);
+        const uint64_t wallStart = nowNs(CLOCK_MONOTONIC);
+        timespec tsIdle;
+        tsIdle.tv_sec = 0;
+        tsIdle.tv_nsec = RECLAIM_HELPER_IDLE_SLEEP_US * 1000;
+        int idle = 0;
+        while (self->running.load(std::memory_order_acquire)) {
+            const size_t freed = self->drainAll(helper);
+            if (freed) {
+                h->freed += freed;
+                idle = 0;
+            } else if (++idle < RECLAIM_HELPER_IDLE_SPINS) {
+                std::this_thread::yield();
+            } else {
+                nanosleep(&tsIdle, NULL);
+            }
+        }
+        h->freed += self->drainAll(helper);
+        h->cpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+        h->wallNs = nowNs(CLOCK_MONOTONIC) - wallStart;
+    }
+
+public:
+    ReclaimHelpers() : numHelpers(0), bindFn(NULL), numQueues(0) {
+        running.store(false, std::memory_order_relaxed);
+    }
+
+    inline bool isRunning() const {
+        return running.load(std::memory_order_relaxed);
+    }
+
+    void registerQueue(void * const queue, reclaim_drain_fn drain, const int numProcesses) {
+        assert(!isRunning());
+        if (numQueues == RECLAIM_HELPERS_MAX_QUEUES) {
+            setbench_error("too many reclamation helper queues; increase RECLAIM_HELPERS_MAX_QUEUES");
+        }
+        queues[numQueues].queue = queue;
+        queues[numQueues].drain = drain;
+        queues[numQueues].numProcesses = numProcesses;
+        ++numQueues;
+    }
+
+    void unregisterQueue(void * const queue) {
+        assert(!isRunning());
+        for (int q=0;q<numQueues;++q) {
+            if (queues[q].queue == queue) {
+                queues[q] = queues[--numQueues];
+                return;
+            }
+        }
+    }
+
+    // bind(helper) is invoked by each helper thread before it starts freeing
+    void start(const int _numHelpers, void (*bind)(const int helper)) {
+        assert(!isRunning());
+        if (_numHelpers > RECLAIM_HELPERS_MAX) {
+            setbench_error("too many reclamation helpers; increase RECLAIM_HELPERS_MAX");
+        }
+        numHelpers = _numHelpers;
+        bindFn = bind;
+        if (numHelpers <= 0) return;
+        running.store(true, std::memory_order_release);
+        for (int i=0;i<numHelpers;++i) {
+            helpers[i].freed = 0;
+            helpers[i].cpuNs = 0;
+            helpers[i].wallNs = 0;
+            helpers[i].thread = new std::thread(run, this, i);
+        }
+    }
+
+    // blocks handed off after this returns are freed when their pool is destroyed
+    void stop() {
+        if (!isRunning()) return;
+        running.store(false, std::memory_order_release);
+        for (int i=0;i<numHelpers;++i) {
+            helpers[i].thread->join();
+            delete helpers[i].thread;
+        }
+    }
+
+    int getNumHelpers() const { return numHelpers; }
+    uint64_t getFreed(const int helper) const { return helpers[helper].freed; }
+    uint64_t getCpuNs(const int helper) const { return helpers[helper].cpuNs; }
+    uint64_t getWallNs(const int helper) const { return helpers[helper].wallNs; }
+};
+
+inline ReclaimHelpers & reclaimHelpers() {
+    static ReclaimHelpers helpers;
+    return helpers;
+}
+
+#endif /* RECLAIM_HELPERS_H */
@@ -9,9 +9,11 @@
 #ifndef RECLAIM_IBR_H
 #define RECLAIM_IBR_H
 
-#include <list>
+#include <vector>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "reservation_snapshot.h"
 
 // #if !defined IBR_ORIGINAL_FREE || !IBR_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -23,7 +25,6 @@ class reclaimer_2geibr : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     PAD;
     class ThreadData
     {
@@ -34,6 +35,10 @@ private:
         blockbag<T> * deamortizedFreeables;
         int numFreesPerStartOp;
     #endif        
+
+    // to snapshot global reservations once before emptying retired bag.
+    ReservedIntervals reserved;
+
     ThreadData()
     {
     }
@@ -65,9 +70,9 @@ private:
     paddedAtomic<uint64_t> *lower_reservs;
     padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
-    padded<std::list<IntervalInfo>> *retired;
+    padded<std::vector<IntervalInfo>> *retired; // in retire order, so sorted by retire_epoch
 
-    std::atomic<uint64_t> epoch;
+    EpochClock epoch;
     PAD;
 
 public:
@@ -110,9 +115,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -182,6 +184,14 @@ public:
     //     return nullptr;
     // }
 
+    // read() already extends the interval reserved at startOp to cover every record the operation reads,
+    // so a range query needs no further reservations
+    inline void startScan(const int tid, const int maxReads) {}
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return read(tid, 0, obj);
+    }
+    inline void endScan(const int tid) {}
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -189,14 +199,15 @@ public:
         {
             return;
         }
-        uint64_t birth_epoch = obj->birth_epoch;
-        std::list<IntervalInfo> *myTrash = &(retired[tid].ui);
+        uint64_t birth_epoch = EpochClock::birthLowerBound(obj->birth_epoch);
+        std::vector<IntervalInfo> *myTrash = &(retired[tid].ui);
         // for(auto it = myTrash->begin(); it!=myTrash->end(); it++){
         // 	assert(it->obj!=obj && "double retire error");
         // }
 
-        uint64_t retire_epoch = getEpoch();
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(IntervalInfo(obj, birth_epoch, retire_epoch));
+        epoch.onRetire(tid);
         retire_counters[tid] = retire_counters[tid] + 1;
         if (retire_counters[tid] % freq == 0)
         {
@@ -215,32 +226,23 @@ public:
 
     }
 
-    bool conflict(uint64_t *lower_epochs, uint64_t *upper_epochs, uint64_t birth_epoch, uint64_t retire_epoch)
-    {
-        for (int i = 0; i < num_process; i++)
-        {
-            if (upper_epochs[i] >= birth_epoch && lower_epochs[i] <= retire_epoch)
-            {
-                return true;
-            }
-        }
-        return false;
-    }
-
     void empty(const int tid)
     {
+        RECLAMATION_EVENT;
         //read all epochs
-        uint64_t upper_epochs_arr[num_process];
-        uint64_t lower_epochs_arr[num_process];
-        for (int i = 0; i < num_process; i++)
+        ReservedIntervals *reserved = &threadData[tid].reserved;
+        reserved->clear();
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             //sequence matters.
-            lower_epochs_arr[i] = lower_reservs[i].ui.load(std::memory_order_acquire);
-            upper_epochs_arr[i] = upper_reservs[i].ui.load(std::memory_order_acquire);
+            uint64_t lower = lower_reservs[i].ui.load(std::memory_order_acquire);
+            uint64_t upper = upper_reservs[i].ui.load(std::memory_order_acquire);
+            reserved->add(lower, upper);
         }
+        reserved->build();
 
         // erase safe objects
-        std::list<IntervalInfo> *myTrash = &(retired[tid].ui);
+        std::vector<IntervalInfo> *myTrash = &(retired[tid].ui);
 
         uint before_sz = myTrash->size();
         // #ifdef USE_GSTATS
@@ -248,25 +250,13 @@ public:
         // #endif        
         // COUTATOMICTID("decided to empty! bag size=" << myTrash->size() << std::endl);
 
-        for (auto iterator = myTrash->begin(), end = myTrash->end(); iterator != end;)
-        {
-            IntervalInfo res = *iterator;
-            if (!conflict(lower_epochs_arr, upper_epochs_arr, res.birth_epoch, res.retire_epoch))
-            {
-                // this->pool->add(tid, res.obj);
-            #ifdef DEAMORTIZE_FREE_CALLS
-                threadData[tid].deamortizedFreeables->add(res.obj);
-            #else
-                this->pool->add(tid, res.obj); //reclaim
-            #endif
-
-                iterator = myTrash->erase(iterator); //return iterator corresponding to next of last erased item
-            }
-            else
-            {
-                ++iterator;
-            }
-        }
+        freeUnreserved(*myTrash, *reserved, [&](T *obj) {
+        #ifdef DEAMORTIZE_FREE_CALLS
+            threadData[tid].deamortizedFreeables->add(obj);
+        #else
+            this->pool->add(tid, obj); //reclaim
+        #endif
+        });
 
         uint after_sz = myTrash->size();
         // COUTATOMICTID("before_sz= "<<before_sz<<" after_sz= " << after_sz << " reclaimed=" << (before_sz - after_sz) << std::endl);
@@ -297,7 +287,8 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
 
     /**
@@ -319,9 +310,7 @@ public:
         freq = 24576; //16384; //32000; //30; //on lines with nbr
 #endif
 
-        epoch_freq = 150; // if high then high mem usage
-
-        retired = new padded<std::list<IntervalInfo>>[num_process];
+        retired = new padded<std::vector<IntervalInfo>>[num_process];
         upper_reservs = new paddedAtomic<uint64_t>[num_process];
         lower_reservs = new paddedAtomic<uint64_t>[num_process];
         for (int i = 0; i < num_process; i++)
@@ -331,7 +320,7 @@ public:
         }
         retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, freq);
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif                
@@ -342,12 +331,11 @@ public:
         for (int i = 0; i < num_process; i++)
         {
             // COUTATOMIC(retired[i].ui.size()<<std::endl);
-            for (auto iterator = retired[i].ui.begin(), end = retired[i].ui.end(); iterator != end; )
+            for (auto iterator = retired[i].ui.begin(), end = retired[i].ui.end(); iterator != end; ++iterator)
             {
-                IntervalInfo res = *iterator;
-                iterator=retired[i].ui.erase(iterator); //return iterator corresponding to next of last erased item
-                this->pool->add(i, res.obj); //reclaim
+                this->pool->add(i, iterator->obj); //reclaim
             }
+            retired[i].ui.clear();
 
         }
 
@@ -356,7 +344,7 @@ public:
         delete [] lower_reservs;
         delete [] retire_counters;
         delete [] alloc_counters;
-		COUTATOMIC("epoch_freq= " << epoch_freq << "empty_freq= " << freq <<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() << "empty_freq= " << freq <<std::endl);
     }
 };
 
@@ -641,7 +641,8 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
 
     /**
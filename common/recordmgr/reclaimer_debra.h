@@ -158,7 +158,7 @@ public:
         return ss.str();
     }
 
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
 
     inline bool isQuiescent(const int tid) {
         return QUIESCENT(threadData[tid].announcedEpoch.load(std::memory_order_relaxed));
@@ -179,7 +179,7 @@ public:
     }
     inline static void qUnprotectAll(const int tid) {}
 
-    inline static bool shouldHelp() { return true; }
+    static constexpr bool shouldHelp() { return true; }
 
     // try to clean up: must only be called by a single thread as part of the test harness!
     template <typename First, typename... Rest>
@@ -203,6 +203,7 @@ public:
 
     // rotate the epoch bags and reclaim any objects retired two epochs ago.
     inline void rotateEpochBags(const int tid) {
+        RECLAMATION_EVENT;
         int nextIndex = (threadData[tid].index+1) % NUMBER_OF_EPOCH_BAGS;
         blockbag<T> * const freeable = threadData[tid].epochbags[(nextIndex+NUMBER_OF_ALWAYS_EMPTY_EPOCH_BAGS) % NUMBER_OF_EPOCH_BAGS];
 #ifdef GSTATS_HANDLE_STATS_DELME
@@ -402,7 +403,6 @@ public:
     // for all schemes except reference counting
     inline void retire(const int tid, T* p) {
         threadData[tid].currentBag->add(p);
-        DEBUG2 this->debug->addRetired(tid, 1);
     }
 
     void debugPrintStatus(const int tid) {
@@ -417,7 +417,8 @@ public:
                 threadData[tid].epochbags[i] = new blockbag<T>(tid, this->pool->blockpools[tid]);
             }
         }
-        threadData[tid].currentBag = threadData[tid].epochbags[0];
+        // a tid that rejoins keeps the bags (and bag index) of its predecessor
+        threadData[tid].currentBag = threadData[tid].epochbags[threadData[tid].index];
 #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
         threadData[tid].numFreesPerStartOp = 1;
@@ -434,6 +435,20 @@ public:
         // which is only safe if this thread is deinitializing specifically
         // because *ALL THREADS* have already finished accessing
         // the data structure and are now quiescent!!
+        // if some live thread is not quiescent (e.g., this thread is being
+        // replaced while others run), the bags are kept for the next thread
+        // with this tid (or freed by the destructor).
+        if (this->liveThreads) {
+            FOR_EACH_LIVE_TID(otherTid, this->liveThreads) {
+                if (otherTid != tid && !isQuiescent(otherTid)) {
+#ifdef DEAMORTIZE_FREE_CALLS
+                    this->pool->addMoveAll(tid, threadData[tid].deamortizedFreeables);
+                    delete threadData[tid].deamortizedFreeables;
+#endif
+                    return;
+                }
+            }
+        }
         for (int i=0;i<NUMBER_OF_EPOCH_BAGS;++i) {
             if (threadData[tid].epochbags[i]) {
                 this->pool->addMoveAll(tid, threadData[tid].epochbags[i]);
@@ -465,16 +480,16 @@ public:
         }
     }
     ~reclaimer_debra() {
-//        VERBOSE DEBUG std::cout<<"destructor reclaimer_debra"<<std::endl;
-//        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
-//            // move contents of all bags into pool
-//            for (int i=0;i<NUMBER_OF_EPOCH_BAGS;++i) {
-//                if (threadData[tid].epochbags[i]) {
-//                    this->pool->addMoveAll(tid, threadData[tid].epochbags[i]);
-//                    delete threadData[tid].epochbags[i];
-//                }
-//            }
-//        }
+        // move the contents of any bags kept by deinitThread into the pool
+        for (int i=0;i<this->NUM_PROCESSES;++i) {
+            for (int j=0;j<NUMBER_OF_EPOCH_BAGS;++j) {
+                if (threadData[i].epochbags[j]) {
+                    this->pool->addMoveAll(i, threadData[i].epochbags[j]);
+                    delete threadData[i].epochbags[j];
+                    threadData[i].epochbags[j] = NULL;
+                }
+            }
+        }
     }
 
 };
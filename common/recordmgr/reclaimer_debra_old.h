@@ -144,7 +144,7 @@ public:
         return ss.str();
     }
 
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
 
     inline bool isQuiescent(const int tid) {
         return QUIESCENT(threadData[tid].announcedEpoch.load(std::memory_order_relaxed));
@@ -165,7 +165,7 @@ public:
     }
     inline static void qUnprotectAll(const int tid) {}
 
-    inline static bool shouldHelp() { return true; }
+    static constexpr bool shouldHelp() { return true; }
 
     // try to clean up: must only be called by a single thread as part of the test harness!
     template <typename First, typename... Rest>
@@ -404,7 +404,6 @@ if (++(threadData[tid].deamortize_freq)%10 == 0){
     // for all schemes except reference counting
     inline void retire(const int tid, T* p) {
         threadData[tid].currentBag->add(p);
-        DEBUG2 this->debug->addRetired(tid, 1);
     }
 
     void debugPrintStatus(const int tid) {
@@ -54,9 +54,10 @@ public:
         typedef reclaimer_hazardptr<_Tp1, _Tp2> other;
     };
     
-    inline static bool shouldHelp() {
+    static constexpr bool shouldHelp() {
         return false;
     }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
     
     bool isProtected(const int tid, T * const obj) {
         return announce[tid]->contains(obj);
@@ -153,7 +154,6 @@ public:
     
     inline void retire(const int tid, T* p) {
         TRACE std::cout<<"reclaimer_hazardptr::retire(tid="<<tid<<", "<<debugPointerOutput(p)<<")"<<std::endl;
-        DEBUG2 this->debug->addRetired(tid, 1);
         retired[tid]->add(p);
         
         // if the retired bag is sufficiently large
@@ -9,9 +9,13 @@
 #ifndef RECLAIM_HE_H
 #define RECLAIM_HE_H
 
-#include <list>
+#include <vector>
 #include "ConcurrentPrimitives.h"
+#include "reservation_slots.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "reservation_snapshot.h"
+#include "scan_reservations.h"
 
 // #if !defined HE_ORIGINAL_FREE || !HE_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -23,7 +27,6 @@ class reclaimer_he : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     int num_he;
     // PAD;
     class ThreadData
@@ -37,7 +40,8 @@ private:
     #endif
 
     // to save global reservations once before emptying retired bag.
-    uint64_t *scannedHEs;
+    ReservedErasAndIntervals scannedHEs;
+    std::vector<uint64_t> reservationSnapshot; // copy of the reservations of live threads, reused by every empty()
 
     ThreadData()
     {
@@ -65,12 +69,13 @@ public:
     };
 
 private:
-    padded< std::atomic<uint64_t>*>* reservations; // per thread array of reservations 
+    ReservationSlots<uint64_t> *reservations; // per thread array of reservations, one cache line per thread
+    ScanIntervals scanIntervals; // range queries' reservations (see scan_reservations.h)
     padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
-    padded<std::list<HeInfo>> *retired;
+    padded<std::vector<HeInfo>> *retired; // in retire order, so sorted by retire_epoch
 
-    std::atomic<uint64_t> epoch;
+    EpochClock epoch;
     PAD;
 
 public:
@@ -103,17 +108,13 @@ public:
     {
         for (int i = 0; i < num_he; i++)
         {
-			reservations[tid].ui[i].store(0, std::memory_order_seq_cst);
+			reservations->at(tid, i).store(0, std::memory_order_seq_cst);
 		}
     }
 
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-            // COUTATOMICTID("epoch="<<epoch.load(std::memory_order_acquire)<<std::endl);
-		}
         // COUTATOMICTID("epoch="<<epoch.load(std::memory_order_acquire)<<std::endl);
 
     }
@@ -127,7 +128,7 @@ public:
     T* read(int tid, int idx, std::atomic<T*> &obj)
     {
 
-		uint64_t prev_epoch = reservations[tid].ui[idx].load(std::memory_order_acquire);
+		uint64_t prev_epoch = reservations->at(tid, idx).load(std::memory_order_acquire);
 		while(true){
 			T* ptr = obj.load(std::memory_order_acquire);
 
@@ -148,8 +149,8 @@ public:
         // #endif                
 				return ptr;
 			} else {
-				// reservations[tid].ui[idx].store(curr_epoch, std::memory_order_release);
-				reservations[tid].ui[idx].store(curr_epoch, std::memory_order_seq_cst);
+				// reservations->at(tid, idx).store(curr_epoch, std::memory_order_release);
+				reservations->at(tid, idx).store(curr_epoch, std::memory_order_seq_cst);
 				prev_epoch = curr_epoch;
 
         #ifdef GARBAGE_BOUND_EXP
@@ -164,6 +165,17 @@ public:
 		}
     }
 
+    // a range query reserves an interval (through readScan) that covers every record it reads until endScan
+    inline void startScan(const int tid, const int maxReads) {
+        scanIntervals.start(tid, getEpoch());
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanIntervals.read(tid, obj, [this]() { return getEpoch(); });
+    }
+    inline void endScan(const int tid) {
+        scanIntervals.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -171,14 +183,15 @@ public:
         {
             return;
         }
-        uint64_t birth_epoch = obj->birth_epoch;
-        std::list<HeInfo> *myTrash = &(retired[tid].ui);
+        uint64_t birth_epoch = EpochClock::birthLowerBound(obj->birth_epoch);
+        std::vector<HeInfo> *myTrash = &(retired[tid].ui);
         // for(auto it = myTrash->begin(); it!=myTrash->end(); it++){
         // 	assert(it->obj!=obj && "double retire error");
         // }
 
-        uint64_t retire_epoch = getEpoch();
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(HeInfo(obj, birth_epoch, retire_epoch));
+        epoch.onRetire(tid);
         retire_counters[tid] = retire_counters[tid] + 1;
         if (retire_counters[tid] % freq == 0)
         {
@@ -196,84 +209,36 @@ public:
         }
     }
 
-    bool isFreeable(uint64_t birth_epoch, uint64_t retire_epoch)
-    {
-		// for (int i = 0; i < num_process; i++)
-        // {
-		// 	for (int j = 0; j < num_he; j++)
-        //     {
-		// 		// const uint64_t epo = reservations[i].ui[j].load(std::memory_order_acquire);
-
-		// 		//NOTE: the third condition epo == 0 seems wrong in orig code.
-        //         // what if T1 did 10 alloc. Thus, global epoch is still 0. And T2
-        //         // decides to reclaim a obj that could be accessed in epoc 0 by some thread.
-        //         // A crash would occur. Indeed enabling the check causes seg fault and commenting it gives non crashing execution.
-        //         if (epo < birth_epoch || epo > retire_epoch || epo == 0)
-        //         {
-		// 			continue;
-		// 		}
-        //         else 
-        //         {
-		// 			return false;
-		// 		}
-		// 	}
-		// }
-		// return true;
-
-        for (uint64_t ith = 0; ith < num_process*num_he; ith++)
-        {
-            const uint64_t epo = threadData[tid].scannedHEs[ith];
-
-            if (epo < birth_epoch || epo > retire_epoch || epo == 0)
-            {
-                continue;
-            }
-            else 
-            {
-                return false;
-            }
-        }
-
-		return true;
-    }
-
     void empty(const int tid)
     {
+        RECLAMATION_EVENT;
         // erase safe objects
-        std::list<HeInfo> *myTrash = &(retired[tid].ui);
+        std::vector<HeInfo> *myTrash = &(retired[tid].ui);
 
         uint before_sz = myTrash->size();
         // COUTATOMICTID("decided to empty! bag size=" << myTrash->size() << std::endl);
 
 
-        for (int i = 0; i < num_process; i++)
+        std::vector<uint64_t>& snapshot = threadData[tid].reservationSnapshot;
+        snapshot.resize(reservations->size());
+        const int n = reservations->snapshot(this->liveThreads, snapshot.data(), std::memory_order_acquire);
+        threadData[tid].scannedHEs.clear();
+        for (int i = 0; i < n; i++)
         {
-			for (int j = 0; j < num_he; j++)
-            {
-                threadData[tid].scannedHEs[(i*num_he)+j] = reservations[i].ui[j].load(std::memory_order_acquire);
-            }
-        }
-
-        for (auto iterator = myTrash->begin(), end = myTrash->end(); iterator != end;)
-        {
-            HeInfo res = *iterator;
-    
-            if (isFreeable(res.birth_epoch, res.retire_epoch))
-            {
-            // this->pool->add(tid, res.obj);
-            #ifdef DEAMORTIZE_FREE_CALLS
-                threadData[tid].deamortizedFreeables->add(res.obj);
-            #else
-                this->pool->add(tid, res.obj); //reclaim
-            #endif
-
-                iterator = myTrash->erase(iterator); //return iterator corresponding to next of last erased item
-            }
-            else
-            {
-                ++iterator;
-            }
+            threadData[tid].scannedHEs.add(snapshot[i]);
         }
+        scanIntervals.forEach(this->liveThreads, [&](const uint64_t lower, const uint64_t upper) {
+            threadData[tid].scannedHEs.add(lower, upper);
+        });
+        threadData[tid].scannedHEs.build();
+
+        freeUnreserved(*myTrash, threadData[tid].scannedHEs, [&](T *obj) {
+        #ifdef DEAMORTIZE_FREE_CALLS
+            threadData[tid].deamortizedFreeables->add(obj);
+        #else
+            this->pool->add(tid, obj); //reclaim
+        #endif
+        });
 
         uint after_sz = myTrash->size();
         TRACE COUTATOMICTID("before_sz= "<<before_sz<<" after_sz= " << after_sz << " reclaimed=" << (before_sz - after_sz) << std::endl);
@@ -289,15 +254,12 @@ public:
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
         threadData[tid].numFreesPerStartOp = 1;
 #endif
-
-        threadData[tid].scannedHEs = new uint64_t [num_process * num_he];
     }
     void deinitThread(const int tid) {
 #ifdef DEAMORTIZE_FREE_CALLS
         this->pool->addMoveAll(tid, threadData[tid].deamortizedFreeables);
         delete threadData[tid].deamortizedFreeables;
 #endif
-        delete[] threadData[tid].scannedHEs;
     }
 
     inline static bool isProtected(const int tid, T *const obj) { return true; }
@@ -307,7 +269,8 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
 
     /**
@@ -329,22 +292,13 @@ public:
 #else
         freq = 24576; //16384; //32000; //30; //on lines with nbr
 #endif
-        epoch_freq = 100;//150; // increasing this causes increase in mem usage
         num_he = 3; // 3 for hmlist 2 shoudl work for harris and lazylist
 
-        retired = new padded<std::list<HeInfo>>[num_process];
-        reservations = new padded< std::atomic<uint64_t>* >[num_process];
-        for (int i = 0; i < num_process; i++)
-        {
-            reservations[i].ui = new std::atomic<uint64_t>[num_he];
-            for (int j = 0; j < num_he; j++)
-            {
-                reservations[i].ui[j].store(0, std::memory_order_release);
-            }
-        }
+        retired = new padded<std::vector<HeInfo>>[num_process];
+        reservations = new ReservationSlots<uint64_t>(num_process, num_he, 0);
         retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(1, std::memory_order_release);
+        epoch.init(num_process, 1, freq);
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif        
@@ -355,22 +309,19 @@ public:
         for (int i = 0; i < num_process; i++)
         {
             // COUTATOMIC(retired[i].ui.size()<<std::endl);
-            for (auto iterator = retired[i].ui.begin(), end = retired[i].ui.end(); iterator != end; )
+            for (auto iterator = retired[i].ui.begin(), end = retired[i].ui.end(); iterator != end; ++iterator)
             {
-                HeInfo res = *iterator;
-                iterator=retired[i].ui.erase(iterator); //return iterator corresponding to next of last erased item
-                this->pool->add(i, res.obj); //reclaim
+                this->pool->add(i, iterator->obj); //reclaim
             }
-
-            delete [] reservations[i].ui;
+            retired[i].ui.clear();
         }
 
         delete [] retired;
-        delete [] reservations;
+        delete reservations;
         delete [] retire_counters;
         delete [] alloc_counters;
         // std::cout <<"reclaimer destructor finished" <<std::endl;
-		COUTATOMIC("epoch_freq= " << epoch_freq << "empty_freq= " << freq <<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() << "empty_freq= " << freq <<std::endl);
     }
 };
 
@@ -9,9 +9,11 @@
 #ifndef RECLAIM_POPHP_H
 #define RECLAIM_POPHP_H
 
-#include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "hashtable.h"
+#include "reservation_slots.h"
+#include "scan_reservations.h"
 
 // #if !defined HP_ORIGINAL_FREE || !HP_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -25,9 +27,9 @@ private:
     int empty_freq;
     int slotsPerThread;
     // PAD;
-    paddedAtomic<T*> *slots;
+    ReservationSlots<T*> *slots; // slotsPerThread slots per thread, one cache line per thread
+    ScanHazardPointers<T> scanPtrs; // range queries' reservations (see scan_reservations.h)
     padded<int> *cntrs;
-    padded<std::list<T*>> *retired;
     // PAD;
     static const int MAX_RETIREBAG_CAPACITY_POW2 = 32768; //16384; //32768; //16384; //32768; //4096; //8192;//16384;//32768;          //16384;
 
@@ -36,6 +38,11 @@ private:
     private:
         PAD;
     public:
+        blockbag<T> *retiredBag;
+        blockbag<T> *spareBag; // holds records spared by empty(), swapped with retiredBag at the end of every empty()
+        hashset_new<T> *scannedHzptrs; // snapshot of all slots taken once per empty()
+        T** scannedSlots; // copy of the slots of live threads, filled by slots->snapshot() once per empty()
+        std::vector<T*> scannedScanPtrs; // records reserved by range queries, filled by scanPtrs.snapshot() once per empty()
     #ifdef DEAMORTIZE_FREE_CALLS
         blockbag<T> * deamortizedFreeables;
         int numFreesPerStartOp;
@@ -68,28 +75,11 @@ inline bool requestAllThreadsToRestart(const int tid)
 
     publishReservations(tid);
 
-    for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+    // deliver pings according to the strategy selected in ping_delivery.h
+    if (!this->recoveryMgr->pingDelivery->pingAll(tid))
     {
-        if (tid != otherTid)
-        {
-            //get posix thread id from application level thread id.
-            pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-            int error = 0;
-
-            error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-            if (error)
-            {
-                COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                if (error == ESRCH)
-                    COUTATOMICTID("ESRCH" << std::endl);
-                if (error == EINVAL)
-                    COUTATOMICTID("EINVAL" << std::endl);
-
-                assert("Error when trying to pthread_kill" && 0);
-                return result;
-            }
-        }
-    }     // for()
+        return result;
+    }
 
 #ifdef USE_GSTATS
     GSTATS_ADD(tid, signalall, 1);
@@ -128,7 +118,7 @@ public:
     inline void endOp(const int tid)
     {
         for(int i = 0; i<slotsPerThread; i++){
-			// slots[tid*slotsPerThread+i] = NULL;
+			// slots->at(tid, i) = NULL;
             // saving slotsPerThread global writes here
             threadData[tid].local_slots[i] = NULL;
 		}
@@ -174,11 +164,22 @@ public:
     }
 
     inline void reserve(T* ptr, int slot, int tid){
-		// slots[tid*slotsPerThread+slot] = ptr;
+		// slots->at(tid, slot) = ptr;
         // saving per read global write here. But not saving anything here as other threads only read it during retire...
         threadData[tid].local_slots[slot] = ptr;
 	}
 
+    // a range query reserves every record it reads (through readScan) until endScan, in addition to its slots
+    inline void startScan(const int tid, const int maxReads) {
+        scanPtrs.start(tid, maxReads);
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanPtrs.read(tid, obj);
+    }
+    inline void endScan(const int tid) {
+        scanPtrs.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -186,15 +187,15 @@ public:
         {
             return;
         }
-        std::list<T*> *myTrash = &(retired[tid].ui);
-        myTrash->push_back(obj);
+        blockbag<T> *myTrash = threadData[tid].retiredBag;
+        myTrash->add(obj);
 
 		if(cntrs[tid] == empty_freq)
         {
-            // if(myTrash->size() >= empty_freq){
+            // if(myTrash->computeSizeFast() >= empty_freq){
 			cntrs[tid] = 0;
 
-            for (int i = 0; i < num_process; i++){
+            FOR_EACH_LIVE_TID(i, this->liveThreads){
                 threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
             }
             if (requestAllThreadsToRestart(tid))
@@ -204,14 +205,14 @@ public:
                 {
                     for (int j = 0; j < slotsPerThread; j++)
                     {
-                        COUTATOMICTID(slots[i*slotsPerThread+j] << ":" );
+                        COUTATOMICTID(slots->at(i, j).load() << ":" );
                     }
                     COUTATOMIC(std::endl);
                 }
                 #endif
     
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -250,45 +251,57 @@ public:
 		cntrs[tid].ui++;
     }
 
-    inline bool conflict(T** scanned_objs, T* ptr)
+    /**
+     * Snapshots all slots once into a hashset so that empty() checks each retired record in O(1) expected time,
+     * i.e., O(R + n*k) per empty() instead of O(R*n*k) (R=retired records, n=#threads, k=slotsPerThread).
+    */
+    inline void collectAllSavedRecords(const int tid)
     {
-        for (int i = 0; i<num_process*slotsPerThread; i++){
-            if(ptr == scanned_objs[i]){
-                return true;
-            }
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        scanned->clear();
+        T** const snapshot = threadData[tid].scannedSlots;
+        const int n = slots->snapshot(this->liveThreads, snapshot);
+        for (int i = 0; i<n; i++){
+            if (snapshot[i]) scanned->insert(snapshot[i]);
         }
-        return false;
+        scanPtrs.snapshot(this->liveThreads, threadData[tid].scannedScanPtrs);
     }
 
-    void empty(const int tid)
+    /**
+     * Moves every record in retiredBag that is not in scannedHzptrs to the pool. Protected records are moved to
+     * spareBag, which then becomes the new retiredBag (the drained bag is reused as the next spareBag).
+    */
+    inline void sendFreeableRecordsToPool(const int tid)
     {
-		std::list<T*>* myTrash = &(retired[tid].ui);
-        uint before_sz = myTrash->size();
-
-        T* temp_local_slots[num_process*slotsPerThread];
-        for (int i = 0; i<num_process*slotsPerThread; i++){
-            temp_local_slots[i] = slots[i].ui;
-        }
-
-		for (typename std::list<T*>::iterator iterator = myTrash->begin(), end = myTrash->end(); iterator != end; ) {
-			// bool danger = false;
-			auto ptr = *iterator;
-
-			if(! conflict(temp_local_slots, ptr)){
-				// this->reclaim(ptr);
-                // this->pool->add(tid, ptr);
+        blockbag<T> *const freeable = threadData[tid].retiredBag;
+        blockbag<T> *const spareMeBag = threadData[tid].spareBag;
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+
+        while (!freeable->isEmpty()) {
+            T* ptr = freeable->remove();
+            if ((scanned->contains(ptr) || ScanHazardPointers<T>::contains(threadData[tid].scannedScanPtrs, ptr))) {
+                spareMeBag->add(ptr);
+            } else {
                 #ifdef DEAMORTIZE_FREE_CALLS
                     threadData[tid].deamortizedFreeables->add(ptr);
                 #else
                     this->pool->add(tid, ptr); //reclaim
                 #endif
+            }
+        }
+        threadData[tid].retiredBag = spareMeBag;
+        threadData[tid].spareBag = freeable;
+    }
 
-				// this->dec_retired(tid);
-				iterator = myTrash->erase(iterator);
-			}
-			else{++iterator;}
-		}
-        uint after_sz = myTrash->size();
+    void empty(const int tid)
+    {
+        RECLAMATION_EVENT;
+        uint before_sz = threadData[tid].retiredBag->computeSizeFast();
+
+        collectAllSavedRecords(tid);
+        sendFreeableRecordsToPool(tid);
+
+        uint after_sz = threadData[tid].retiredBag->computeSizeFast();
         TRACE COUTATOMICTID("before_sz= "<<before_sz<<" after_sz= " << after_sz << " reclaimed=" << (before_sz - after_sz) << std::endl);
 
 		return;
@@ -300,6 +313,13 @@ public:
 
     //dummy declaration
     void initThread(const int tid) {
+        // bags survive deinitThread (records in them may still be protected), so only create them once per tid
+        if (threadData[tid].retiredBag == NULL) {
+            threadData[tid].retiredBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
+            threadData[tid].spareBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
+            threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * slotsPerThread);
+            threadData[tid].scannedSlots = new T*[num_process * slotsPerThread];
+        }
 #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
         threadData[tid].numFreesPerStartOp = 1;
@@ -330,10 +350,11 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
     /**
      * To escape asserts at record manager assert(!supportcrash || isQuiescent())
@@ -349,7 +370,7 @@ public:
     {
         
         for(int i = 0; i<slotsPerThread; i++){
-			slots[tid*slotsPerThread+i] = threadData[tid].local_slots[i];
+			slots->at(tid, i) = threadData[tid].local_slots[i];
 		}
         // std::atomic_fetch_add(&threadData[tid].mypublishingTS, 1); //tell other threads that I commpleted publishing.        
         threadData[tid].mypublishingTS.fetch_add(1, std::memory_order_acq_rel);
@@ -364,19 +385,17 @@ public:
         empty_freq = MAX_RETIREBAG_CAPACITY_POW2; //16384;//100; //30; // 32K gives best gains for AF version. larger or lower doesn't make a much difference.
         slotsPerThread = NUM_POPHP; //3;
 
-        slots = new paddedAtomic< T* >[num_process * slotsPerThread];
-        for (int i = 0; i < num_process * slotsPerThread; i++)
-        {
-            slots[i] = NULL;
-        }
+        slots = new ReservationSlots<T*>(num_process, slotsPerThread, NULL);
 
-        retired = new padded<std::list<T*>>[num_process];
         cntrs = new padded<int>[num_process];
 
         for (int i = 0; i < num_process; i++)
         {
             cntrs[i] = 0;
-            retired[i].ui = std::list<T*> ();
+            threadData[i].retiredBag = NULL;
+            threadData[i].spareBag = NULL;
+            threadData[i].scannedHzptrs = NULL;
+            threadData[i].scannedSlots = NULL;
         }
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
@@ -385,8 +404,18 @@ public:
 
     ~reclaimer_ibr_pophp()
     {
-        delete [] retired;
-        delete [] slots;
+        // no thread is running at this point, so every remaining retired record is safe to free
+        for (int i = 0; i < num_process; i++)
+        {
+            if (threadData[i].retiredBag == NULL) continue;
+            this->pool->addMoveAll(i, threadData[i].retiredBag);
+            delete threadData[i].retiredBag;
+            delete threadData[i].spareBag;
+            delete threadData[i].scannedHzptrs;
+            delete [] threadData[i].scannedSlots;
+        }
+        delete [] cntrs;
+        delete slots;
 		COUTATOMIC("empty_freq= " << empty_freq <<std::endl);
     }
 };
@@ -9,9 +9,12 @@
 #ifndef RECLAIM_POPPLUSHP_H
 #define RECLAIM_POPPLUSHP_H
 
-#include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "hashtable.h"
+#include "reservation_slots.h"
+#include "scan_reservations.h"
+#include "reclaim_controller.h"
 
 // #if !defined HP_ORIGINAL_FREE || !HP_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -25,9 +28,10 @@ private:
     int empty_freq;
     int slotsPerThread;
     // PAD;
-    paddedAtomic<T*> *slots;
+    ReservationSlots<T*> *slots; // slotsPerThread slots per thread, one cache line per thread
+    ScanHazardPointers<T> scanPtrs; // range queries' reservations (see scan_reservations.h)
     padded<uint64_t> *cntrs;
-    padded<std::list<T*>> *retired;
+    ReclaimController controller; // tunes each thread's bagCapacityThreshold
     // paddedAtomic<uint64_t> publishing_epoch;
     // PAD;
     // padded<uint64_t> *retire_counters;
@@ -39,12 +43,17 @@ private:
     private:
         PAD;
     public:
+        blockbag<T> *retiredBag;
+        blockbag<T> *spareBag; // holds records spared by empty(), swapped with retiredBag at the end of every empty()
+        hashset_new<T> *scannedHzptrs; // snapshot of all slots taken once per empty()
+        T** scannedSlots; // copy of the slots of live threads, filled by slots->snapshot() once per empty()
+        std::vector<T*> scannedScanPtrs; // records reserved by range queries, filled by scanPtrs.snapshot() once per empty()
     #ifdef DEAMORTIZE_FREE_CALLS
         blockbag<T> * deamortizedFreeables;
         int numFreesPerStartOp;
     #endif
 
-    unsigned int bagCapacityThreshold; // NOT used, we use cntr and retire_freq instead.
+    unsigned int bagCapacityThreshold; // HiWm, tuned by controller
 
     //BEGIN OPTIMIZED_SIGNAL: LoWatermark variables
     PAD;
@@ -87,28 +96,11 @@ inline bool requestAllThreadsToRestart(const int tid)
     //Theorem: The signalling thread should also publish it's epochs so that other threads in LoWm could reclaim correctly.
     publishReservations(tid);
 
-    for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+    // deliver pings according to the strategy selected in ping_delivery.h
+    if (!this->recoveryMgr->pingDelivery->pingAll(tid))
     {
-        if (tid != otherTid)
-        {
-            //get posix thread id from application level thread id.
-            pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-            int error = 0;
-
-            error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-            if (error)
-            {
-                COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                if (error == ESRCH)
-                    COUTATOMICTID("ESRCH" << std::endl);
-                if (error == EINVAL)
-                    COUTATOMICTID("EINVAL" << std::endl);
-
-                assert("Error when trying to pthread_kill" && 0);
-                return result;
-            }
-        }
-    }     // for()
+        return result;
+    }
 
 
     // publishing_epoch.ui.fetch_add(1);
@@ -151,9 +143,13 @@ public:
     inline void endOp(const int tid)
     {
         for(int i = 0; i<slotsPerThread; i++){
-			// slots[tid*slotsPerThread+i] = NULL;
+        #ifdef POP_PUBLISH_MEMBARRIER
+            slots->at(tid, i).store(NULL, std::memory_order_relaxed);
+        #else
+			// slots->at(tid, i) = NULL;
             // saving slotsPerThread global writes here
             threadData[tid].local_slots[i] = NULL;
+        #endif
 		}
     }
 
@@ -180,8 +176,7 @@ public:
         threadData[tid].firstLoEntryFlag = false;
 
         // approach3: 1, 5, 10, 15....50%
-        int rand_val = (rand()%11);
-        threadData[tid].LoPathReclaimAttemptFreq = (rand_val==0)? (0.01*MAX_RETIREBAG_CAPACITY_POW2) : (unsigned int)((((rand_val*5))/100.0 )*MAX_RETIREBAG_CAPACITY_POW2);
+        threadData[tid].LoPathReclaimAttemptFreq = controller.nextLoAttemptFreq(tid, 0.01);
 
         // threadData[tid].LoPathReclaimAttemptFreq = 50; //30;
 
@@ -210,7 +205,7 @@ public:
 
     inline bool isOutOfPatience(const int tid, size_t myTrashSize = 0)
     {
-        bool result = (myTrashSize >= (empty_freq));
+        bool result = (myTrashSize >= threadData[tid].bagCapacityThreshold);
         // bool result = (myTrashSize >= (num_process > 192 ? 2*empty_freq : empty_freq));
         // if (result) COUTATOMICTID("myTrashSize="<<myTrashSize<< " empty_freq =" << empty_freq<< " cntrs["<<tid<<"]="<<cntrs[tid]<<std::endl);
         return result;
@@ -241,11 +236,29 @@ public:
     }
 
     inline void reserve(T* ptr, int slot, int tid){
-		// slots[tid*slotsPerThread+slot] = ptr;
+    #ifdef POP_PUBLISH_MEMBARRIER
+        // reserve directly in the shared slot; the reclaimer's membarrier makes it visible.
+        // compiler barrier keeps this store before read()'s validating load.
+        slots->at(tid, slot).store(ptr, std::memory_order_relaxed);
+        asm volatile ("" : : : "memory");
+    #else
+		// slots->at(tid, slot) = ptr;
         // saving per read global write here. But not saving anything here as other threads only read it during retire...
         threadData[tid].local_slots[slot] = ptr;
+    #endif
 	}
 
+    // a range query reserves every record it reads (through readScan) until endScan, in addition to its slots
+    inline void startScan(const int tid, const int maxReads) {
+        scanPtrs.start(tid, maxReads);
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanPtrs.read(tid, obj);
+    }
+    inline void endScan(const int tid) {
+        scanPtrs.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -253,9 +266,10 @@ public:
         {
             return;
         }
-        std::list<T*> *myTrash = &(retired[tid].ui);
-        myTrash->push_back(obj);
-        size_t myTrashSize = myTrash->size();
+        blockbag<T> *myTrash = threadData[tid].retiredBag;
+        myTrash->add(obj);
+        size_t myTrashSize = myTrash->computeSizeFast();
+        controller.onRetire(tid, myTrashSize);
 
 		if(isOutOfPatience(tid, myTrashSize)){
             // #ifdef GSTATS_HANDLE_STATS
@@ -264,18 +278,20 @@ public:
             resetLoWmMetaData(tid);
 			// cntrs[tid] = 0;
 
-            for (int i = 0; i < num_process; i++){
+            FOR_EACH_LIVE_TID(i, this->liveThreads){
                 threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
             }            
             std::atomic_fetch_add(&threadData[tid].announcedTS, 1); //tell other threads that I am starting signalling.
+            controller.beginSignal(tid);
             if (requestAllThreadsToRestart(tid))
             {
+                controller.endSignal(tid);
                 #ifdef POP_DEBUG                
                 for (int i = 0; i < num_process; i++)
                 {
                     for (int j = 0; j < slotsPerThread; j++)
                     {
-                        COUTATOMICTID(slots[i*slotsPerThread+j] << ":" );
+                        COUTATOMICTID(slots->at(i, j).load() << ":" );
                     }
                     COUTATOMIC(std::endl);
                 }
@@ -284,7 +300,7 @@ public:
 
                 // ensure all threads published.
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -296,7 +312,8 @@ public:
                 }
 
     			empty(tid);
-                // COUTATOMICTID("reclaimed at HiWm=" <<myTrashSize <<" aftersize=" << myTrash->size() << std::endl);
+                threadData[tid].bagCapacityThreshold = controller.onHiWmReclaim(tid, myTrashSize, threadData[tid].retiredBag->computeSizeFast());
+                // COUTATOMICTID("reclaimed at HiWm=" <<myTrashSize <<" aftersize=" << myTrash->computeSizeFast() << std::endl);
             }
 		}
         else if(isPastLoWatermark(tid, myTrashSize))
@@ -310,7 +327,7 @@ public:
             // check if new signal was sent
             // int64_t new_publishing_epoch = publishing_epoch.ui.load(std::memory_order_acquire);
             // if (threadData[tid].saved_publishing_epoch != new_publishing_epoch)
-            for (int i = 0; i < num_process; i++)
+            FOR_EACH_LIVE_TID(i, this->liveThreads)
             {   //TODO: skip self comparison.
                 if( threadData[i].announcedTS >= threadData[tid].savedTS[i] + 2)
                 {
@@ -321,6 +338,7 @@ public:
                     //     GSTATS_APPEND(tid, lo_reclamation_event_size, myTrashSize);
                     // #endif
                     empty(tid);
+                    controller.onLoWmReclaim(tid, myTrashSize, threadData[tid].retiredBag->computeSizeFast());
 
                     resetLoWmMetaData(tid);
                     break;
@@ -336,67 +354,75 @@ public:
 		cntrs[tid].ui++;
         if(cntrs[tid].ui% (1000) == 0){
         #ifdef USE_GSTATS
-            GSTATS_APPEND(tid, reclamation_event_size, myTrash->size());
+            GSTATS_APPEND(tid, reclamation_event_size, myTrash->computeSizeFast());
         #endif            
         }
     }
 
 
-    inline bool conflict(T** scanned_objs, T* ptr)
+    /**
+     * Snapshots all slots once into a hashset so that empty() checks each retired record in O(1) expected time,
+     * i.e., O(R + n*k) per empty() instead of O(R*n*k) (R=retired records, n=#threads, k=slotsPerThread).
+    */
+    inline void collectAllSavedRecords(const int tid)
     {
-        for (int i = 0; i<num_process*slotsPerThread; i++){
-            if(ptr == scanned_objs[i]){
-                return true;
-            }
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        scanned->clear();
+        T** const snapshot = threadData[tid].scannedSlots;
+        const int n = slots->snapshot(this->liveThreads, snapshot);
+        for (int i = 0; i<n; i++){
+            if (snapshot[i]) scanned->insert(snapshot[i]);
         }
-        return false;
+        scanPtrs.snapshot(this->liveThreads, threadData[tid].scannedScanPtrs);
     }
 
-    void empty(const int tid)
+    /**
+     * Moves every record in retiredBag that is not in scannedHzptrs to the pool. Protected records are moved to
+     * spareBag, which then becomes the new retiredBag (the drained bag is reused as the next spareBag).
+     * The newest numToSpare records are moved to spareBag without being checked.
+    */
+    inline void sendFreeableRecordsToPool(const int tid, int numToSpare)
     {
-		std::list<T*>* myTrash = &(retired[tid].ui);
-        uint before_sz = myTrash->size();
-
-        T* temp_local_slots[num_process*slotsPerThread];
-        
-        for (int i = 0; i<num_process*slotsPerThread; i++){
-            temp_local_slots[i] = slots[i].ui;
-        }        
-
-        int reclaimed_so_far = 0;
-		for (typename std::list<T*>::iterator iterator = myTrash->begin(), end = myTrash->end(); iterator != end; ) 
-        {
-
-            // If reclaiming at loWm, only reclaim upto the point when entered loWm.
-            // NOTE: ensure when calld from HiWm path this doesnt execute as ity will prevent reclaiming safe objects at HiWm.
-            if ((!threadData[tid].firstLoEntryFlag) && (reclaimed_so_far > (threadData[tid].retire_bag_size_when_entered_loWm - 1)))
-            {
-                break;
-            }
-            reclaimed_so_far++;
-
-			bool danger = false;
-			auto ptr = *iterator;
-            if (conflict(temp_local_slots, ptr))
-            {
-                danger = true;
-            }
+        blockbag<T> *const freeable = threadData[tid].retiredBag;
+        blockbag<T> *const spareMeBag = threadData[tid].spareBag;
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
 
-			if(!danger){
-				// this->reclaim(ptr);
-                // this->pool->add(tid, ptr);
+        // blockbag is a stack, so records retired after entering the LoWm path are removed first
+        for (; numToSpare > 0 && !freeable->isEmpty(); --numToSpare) {
+            spareMeBag->add(freeable->remove());
+        }
+        while (!freeable->isEmpty()) {
+            T* ptr = freeable->remove();
+            if ((scanned->contains(ptr) || ScanHazardPointers<T>::contains(threadData[tid].scannedScanPtrs, ptr))) {
+                spareMeBag->add(ptr);
+            } else {
                 #ifdef DEAMORTIZE_FREE_CALLS
                     threadData[tid].deamortizedFreeables->add(ptr);
                 #else
                     this->pool->add(tid, ptr); //reclaim
                 #endif
+            }
+        }
+        threadData[tid].retiredBag = spareMeBag;
+        threadData[tid].spareBag = freeable;
+    }
 
-				// this->dec_retired(tid);
-				iterator = myTrash->erase(iterator);
-			}
-			else{++iterator;}
-		}
-        // uint after_sz = myTrash->size();
+    void empty(const int tid)
+    {
+        RECLAMATION_EVENT;
+        int before_sz = threadData[tid].retiredBag->computeSizeFast();
+
+        // If reclaiming at loWm, only reclaim upto the point when entered loWm.
+        // NOTE: ensure when calld from HiWm path this doesnt execute as ity will prevent reclaiming safe objects at HiWm.
+        int numToSpare = 0;
+        if (!threadData[tid].firstLoEntryFlag) {
+            numToSpare = std::max(0, before_sz - (int) threadData[tid].retire_bag_size_when_entered_loWm);
+        }
+
+        collectAllSavedRecords(tid);
+        sendFreeableRecordsToPool(tid, numToSpare);
+
+        // uint after_sz = threadData[tid].retiredBag->computeSizeFast();
         // COUTATOMICTID("before_sz= "<<before_sz<<" after_sz= " << after_sz << " reclaimed=" << (before_sz - after_sz) << std::endl);
 
 		return;
@@ -408,11 +434,19 @@ public:
 
     //dummy declaration
     void initThread(const int tid) {
+        // bags survive deinitThread (records in them may still be protected), so only create them once per tid
+        if (threadData[tid].retiredBag == NULL) {
+            threadData[tid].retiredBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
+            threadData[tid].spareBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
+            threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * slotsPerThread);
+            threadData[tid].scannedSlots = new T*[num_process * slotsPerThread];
+        }
 #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
         threadData[tid].numFreesPerStartOp = 1;
 #endif
-        threadData[tid].bagCapacityThreshold = empty_freq;
+        controller.initThread(tid, empty_freq);
+        threadData[tid].bagCapacityThreshold = controller.hiWm(tid);
 
         for (int j = 0; j < NUM_POPHP; j++)
         {
@@ -448,10 +482,11 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
     /**
      * To escape asserts at record manager assert(!supportcrash || isQuiescent())
@@ -466,9 +501,11 @@ public:
     inline void publishReservations(const int tid)
     {
         
+    #ifndef POP_PUBLISH_MEMBARRIER // otherwise reservations are always in the shared slots
         for(int i = 0; i<slotsPerThread; i++){
-			slots[tid*slotsPerThread+i] = threadData[tid].local_slots[i];
-		}  
+			slots->at(tid, i) = threadData[tid].local_slots[i];
+		}
+    #endif  
         threadData[tid].mypublishingTS.fetch_add(1, std::memory_order_acq_rel);              
         return;
     } 
@@ -487,19 +524,18 @@ public:
 
         slotsPerThread = NUM_POPHP; //3;
 
-        slots = new paddedAtomic< T* >[num_process * slotsPerThread];
-        for (int i = 0; i < num_process * slotsPerThread; i++)
-        {
-            slots[i] = NULL;
-        }
+        slots = new ReservationSlots<T*>(num_process, slotsPerThread, NULL);
 
-        retired = new padded<std::list<T*>>[num_process];
         cntrs = new padded<uint64_t>[num_process];
+        controller.init(num_process, empty_freq, sizeof(T));
 
         for (int i = 0; i < num_process; i++)
         {
             cntrs[i] = 0;
-            retired[i].ui = std::list<T*> ();
+            threadData[i].retiredBag = NULL;
+            threadData[i].spareBag = NULL;
+            threadData[i].scannedHzptrs = NULL;
+            threadData[i].scannedSlots = NULL;
         }
         // publishing_epoch.ui.store(0);
 
@@ -511,10 +547,26 @@ public:
 
     ~reclaimer_ibr_popplushp()
     {
-        delete [] retired;
-        delete [] slots;
-		COUTATOMIC("empty_freq= " << empty_freq <<std::endl);
+        // no thread is running at this point, so every remaining retired record is safe to free
+        for (int i = 0; i < num_process; i++)
+        {
+            if (threadData[i].retiredBag == NULL) continue;
+            this->pool->addMoveAll(i, threadData[i].retiredBag);
+            delete threadData[i].retiredBag;
+            delete threadData[i].spareBag;
+            delete threadData[i].scannedHzptrs;
+            delete [] threadData[i].scannedSlots;
+        }
+        delete [] cntrs;
+        delete slots;
+		COUTATOMIC("empty_freq= " << empty_freq << " avg_hiwm= " << controller.averageHiWm() <<std::endl);
     }
 };
 
+#ifdef POP_PUBLISH_MEMBARRIER
+// ibr_popplushp with the membarrier publish backend (see ping_delivery.h), named separately so experiments can compare both
+template <typename T = void, class Pool = pool_interface<T>>
+using reclaimer_ibr_popplushp_mb = reclaimer_ibr_popplushp<T, Pool>;
+#endif
+
 #endif //RECLAIM_POPPLUSHP_H
@@ -11,6 +11,7 @@
 #include <list>
 #include "ConcurrentPrimitives.h" //IBR_RCU
 #include "blockbag.h"
+#include "epoch_clock.h"
 
 // #if !defined RCU_ORIGINAL_FREE || !RCU_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -22,7 +23,6 @@ class reclaimer_ibr_rcu : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int empty_freq;
-    int epoch_freq;
     // PAD;
     class ThreadData
     {
@@ -59,7 +59,7 @@ private:
     padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
 
-    std::atomic<uint64_t> epoch;
+    EpochClock epoch;
     PAD;
 
 public:
@@ -74,7 +74,8 @@ public:
         typedef reclaimer_ibr_rcu<_Tp1, _Tp2> other;
     };
 
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
     template <typename First, typename... Rest>
     inline bool startOp(const int tid, void *const *const reclaimers, const int numReclaimers, const bool readOnly = false)
@@ -108,9 +109,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
     }
 
 
@@ -123,9 +121,10 @@ public:
         }
         std::list<RCUInfo> *myTrash = &(retired[tid].ui);
 
-        uint64_t e = epoch.load(std::memory_order_acquire);
+        uint64_t e = epoch.retireEpoch();
         RCUInfo info = RCUInfo(obj, e);
         myTrash->push_back(info);
+        epoch.onRetire(tid);
         retire_counters[tid] = retire_counters[tid] + 1;
 
         if (retire_counters[tid] % empty_freq == 0)
@@ -155,8 +154,9 @@ public:
 
     void empty(const int tid)
     {
+        RECLAMATION_EVENT;
         uint64_t minEpoch = UINT64_MAX;
-        for (int i = 0; i < num_process; i++)
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             uint64_t res = reservations[i].ui.load(std::memory_order_acquire);
             if (res < minEpoch)
@@ -234,8 +234,6 @@ public:
         empty_freq = 24576; //16384; //32000; //30; //on lines with nbr
 #endif
 
-        epoch_freq = 150; //100; //150;   //this was default values ion IBR microbench
-
         retired = new padded<std::list<RCUInfo>>[numProcesses];
         reservations = new paddedAtomic<uint64_t>[numProcesses];
         retire_counters = new padded<uint64_t>[numProcesses];
@@ -246,7 +244,7 @@ public:
             reservations[i].ui.store(UINT64_MAX, std::memory_order_release);
             retired[i].ui.clear();
         }
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, empty_freq);
 
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
@@ -270,7 +268,7 @@ public:
         delete [] reservations;
         delete [] retire_counters;
         delete [] alloc_counters;
-		COUTATOMIC("epoch_freq= " << epoch_freq << "empty_freq= " << empty_freq <<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() << "empty_freq= " << empty_freq <<std::endl);
     }
 };
 
@@ -11,6 +11,7 @@
 #include "recovery_manager.h"
 #include "pool_interface.h"
 #include "globals.h"
+#include "reclamation_events.h"
 #include <iostream>
 #include <cstdlib>
 
@@ -25,6 +26,7 @@ class reclaimer_interface {
 public:
     PAD;
     RecoveryMgr<void *> * recoveryMgr;
+    const ThreadRegistry * const liveThreads; // tids between initThread and deinitThread; scans may skip all others
     debugInfo * const debug;
 
     const int NUM_PROCESSES;
@@ -44,10 +46,14 @@ public:
     std::string getSizeString() { return ""; }
     std::string getDetailsString() { return ""; }
 
-    inline static bool quiescenceIsPerRecordType() { return false; }
-    inline static bool shouldHelp() { return true; } // FOR DEBUGGING PURPOSES
-    inline static bool supportsCrashRecovery() { return false; }
-    inline static bool needsSetJmp(){ return false; } //for NBR
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool shouldHelp() { return true; } // FOR DEBUGGING PURPOSES
+    static constexpr bool supportsCrashRecovery() { return false; }
+    static constexpr bool needsSetJmp(){ return false; } //for NBR
+    // whether the record manager issues a full fence after startOp, so that what startOp publishes
+    // (e.g., an announced epoch) is visible before the operation's reads. false if startOp publishes
+    // nothing to other threads, or publishes with its own fence.
+    static constexpr bool needsFenceAfterStartOp() { return true; }
 
     inline bool isProtected(const int tid, T * const obj){ return false; }
     
@@ -139,6 +145,7 @@ public:
 
     reclaimer_interface(const int numProcesses, Pool *_pool, debugInfo * const _debug, RecoveryMgr<void *> * const _recoveryMgr = NULL)
             : recoveryMgr(_recoveryMgr)
+            , liveThreads(_recoveryMgr ? &_recoveryMgr->liveThreads : NULL)
             , debug(_debug)
             , NUM_PROCESSES(numProcesses)
             , pool(_pool) {
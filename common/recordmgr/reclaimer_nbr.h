@@ -27,6 +27,7 @@
 #include "reclaimer_interface.h"
 #include "arraylist.h"
 #include "hashtable.h"
+#include "reclaim_controller.h"
 
 // #if !defined NBR_ORIGINAL_FREE || !NBR_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -44,6 +45,8 @@ private:
     //local vars and data structures
     unsigned int num_process;
     PAD;
+    ReclaimController controller; // tunes each thread's bagCapacityThreshold
+    PAD;
 
     class ThreadData
     {
@@ -63,7 +66,7 @@ private:
         PAD;
         unsigned int bagCapacityThreshold; // using this variable to set random thresholds for out of patience.
 
-        ThreadData()
+        ThreadData() : retiredBag(NULL), proposedHzptrs(NULL), scannedHzptrs(NULL)
         {
         }
 
@@ -84,6 +87,11 @@ private:
      * Each threads threshold size is set randomly to avoid all threads reaching size threashold at the same time. Note this is an optimization
      * as it would prevent all threads from bottlenecking whole system by sending signals at the same time.   
     */
+    inline size_t retiredBagSize(const int tid)
+    {
+        return (threadData[tid].retiredBag->getSizeInBlocks() - 1) * BLOCK_SIZE + threadData[tid].retiredBag->getHeadSize();
+    }
+
     inline bool isOutOfPatience(const int tid)
     {
         // if (temp_patience == 0)
@@ -100,23 +108,24 @@ private:
     */
     inline bool requestAllThreadsToRestart(const int tid)
     {
+        RECLAMATION_EVENT;
         bool result = false;
 
         // uint64_t begClock, endClock;
         // unsigned cycles_low, cycles_high, cycles_low1, cycles_high1;
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        FOR_EACH_LIVE_TID(otherTid, this->liveThreads)
         {
             if (tid != otherTid)
             {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
                 int error = 0;
                 //send signal to other thread
                 // COUTATOMICTID("DEBUG_TID_MAP::" << " tid=" << tid << " with pid=" << pthread_self() << " registeredThreads[" << tid << "]=" << registeredThreads[tid] << " sending sig to tid= " << otherTid << " with pid=" << otherPthread << " registeredThreads[" << otherTid << "]=" << registeredThreads[otherTid] << std::endl);
 
                 // BEGIN_MEASURE(cycles_high, cycles_low)
-                error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
+                // (synchronized with otherTid's exit, and skipped if otherTid has left)
+                error = this->recoveryMgr->signalThread(otherTid);
+                if (error == ThreadSignals::NO_THREAD) continue;
                 // END_MEASURE(cycles_high1, cycles_low1)
 
         //         begClock = ( ((uint64_t)cycles_high << 32) | cycles_low );
@@ -167,18 +176,20 @@ private:
         threadData[tid].scannedHzptrs->clear();
         assert("scannedHzptrs size should be 0 before collection" && threadData[tid].scannedHzptrs->size() == 0);
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        FOR_EACH_LIVE_TID(otherTid, this->liveThreads)
         {
             // if (otherTid != tid){ //FIXME: Don't know why skipping to collect own HPs caused gtree validation failure??
             // COUTATOMICTID("begin sz otid="<<otherTid<<" "<<threadData[otherTid].proposedHzptrs<<std::endl);
             // assert(threadData[otherTid].proposedHzptrs && "HP list for this thread is NULL");
-            unsigned int sz = threadData[otherTid].proposedHzptrs->size(); //size shouldn't change during execution.
+            AtomicArrayList<T> * const otherHzptrs = threadData[otherTid].proposedHzptrs;
+            if (!otherHzptrs) continue; // otherTid is not initialized (e.g., a sweep trial with fewer threads)
+            unsigned int sz = otherHzptrs->size(); //size shouldn't change during execution.
             // assert("prposedHzptr[othertid] should be less than max" && sz <= MAX_PER_THREAD_HAZARDPTR);
 
             //for each hazard pointer in othertid proposed hazard ptrs.
             for (int ixHP = 0; ixHP < sz; ++ixHP)
             {
-                T *hp = (T *)threadData[otherTid].proposedHzptrs->get(ixHP);
+                T *hp = (T *)otherHzptrs->get(ixHP);
                 if (hp)
                 {
                     threadData[tid].scannedHzptrs->insert((T *)hp);
@@ -195,6 +206,7 @@ private:
     */
     inline void sendFreeableRecordsToPool(const int tid)
     {
+        RECLAMATION_EVENT;
         //get apointer to retirbag of current thread
         blockbag<T> *const freeable = threadData[tid].retiredBag;
         // blockbag_iterator<T> it;
@@ -354,10 +366,11 @@ else
     /*
     * Tells whether the reclaimer uses signalling. Use this API to distinguish a NBR specific call using record manager inside a ds operation. You may use this API to tell that the function is meant to invoke NBR's API and skip unnecessarily invoking NBR specific API while using Debra or other reclaimers. 
     */
-    inline static bool needsSetJmp()
+    static constexpr bool needsSetJmp()
     {
         return true;
     }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
     /**
      * Public API. A ds calls this API after logically deleting (unlinking) a record from DS. It saves the record in retireBag for a delayed free. 
@@ -370,16 +383,20 @@ else
         {
             // TRACE COUTATOMICTID("TR:: outOfPatience: SigSafe: retiredBag BlockSize=" << threadData[tid].retiredBag->getSizeInBlocks() << "retiredBag Size nodes=" << threadData[tid].retiredBag->computeSize() << std::endl);
             
+            const size_t sizeBefore = retiredBagSize(tid);
+            controller.beginSignal(tid);
             if (requestAllThreadsToRestart(tid))
             {
+                controller.endSignal(tid);
                 // TRACE COUTATOMICTID("TR:: sigSafe: outOfPatience: restarted all threads, gonna continue reclaim =" << threadData[tid].retiredBag->getSizeInBlocks() << " block" << std::endl);
                 #ifdef USE_GSTATS
-                    GSTATS_APPEND(tid, reclamation_event_size, ((threadData[tid].retiredBag->getSizeInBlocks() - 1) * BLOCK_SIZE + threadData[tid].retiredBag->getHeadSize()));
+                    GSTATS_APPEND(tid, reclamation_event_size, sizeBefore);
                 #endif                
 
                 // reclaimFreeable(tid);
                 collectAllSavedRecords(tid);
                 sendFreeableRecordsToPool(tid);
+                threadData[tid].bagCapacityThreshold = controller.onHiWmReclaim(tid, sizeBefore, retiredBagSize(tid));
             }
             else
             {
@@ -392,6 +409,7 @@ else
         assert("retiredBag ds should be non-null" && threadData[tid].retiredBag);
         assert("record to be added should be non-null" && record);
         threadData[tid].retiredBag->add(record);
+        controller.onRetire(tid, retiredBagSize(tid));
     }
 
     void debugPrintStatus(const int tid)
@@ -425,9 +443,10 @@ else
     {
 
         // COUTATOMICTID("nbr: initThread\n");
-        threadData[tid].retiredBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
-        threadData[tid].proposedHzptrs = new AtomicArrayList<T>(MAX_PER_THREAD_HAZARDPTR);
-        threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * MAX_PER_THREAD_HAZARDPTR);
+        // a tid that rejoins reuses the retired bag and lists kept by deinitThread
+        if (threadData[tid].retiredBag == NULL) threadData[tid].retiredBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
+        if (threadData[tid].proposedHzptrs == NULL) threadData[tid].proposedHzptrs = new AtomicArrayList<T>(MAX_PER_THREAD_HAZARDPTR);
+        if (threadData[tid].scannedHzptrs == NULL) threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * MAX_PER_THREAD_HAZARDPTR);
 
 #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
@@ -452,11 +471,14 @@ else
         // else
         //     threadData[tid].bagCapacityThreshold = MAX_RETIREBAG_CAPACITY_POW2;
     
+        // seed this thread's random numbers before drawing its threshold
+        controller.initThread(tid);
+
         //generate perc from rand number:
         // out of total threads
         if (num_process > 1)
         {
-            int num = rand()%100;
+            int num = controller.nextRandom(tid, 100);
             if (num < 5)
                 threadData[tid].bagCapacityThreshold = MAX_RETIREBAG_CAPACITY_POW2/8;
             else if (num < 20)
@@ -470,6 +492,7 @@ else
         {
             threadData[tid].bagCapacityThreshold = 32;
         }
+        controller.setHiWm(tid, threadData[tid].bagCapacityThreshold);
     }
 
     void deinitThread(const int tid)
@@ -478,12 +501,26 @@ else
         // COUTATOMICTID("bagCapacityThreshold=" << threadData[tid].bagCapacityThreshold << std::endl); // NOTICEME: Not sure why help me should be used here copying d+;
 
 
-        this->pool->addMoveAll(tid, threadData[tid].retiredBag);
+        // if other threads are still running (e.g., this thread is being
+        // replaced), they may hold references to records in retiredBag, and may
+        // still be reading proposedHzptrs, so these are kept for the next thread
+        // with this tid (or freed by the destructor).
+        const bool othersLive = this->liveThreads && this->liveThreads->hasMemberOtherThan(tid);
+        if (othersLive)
+        {
+            threadData[tid].proposedHzptrs->clear();
+        }
+        else
+        {
+            this->pool->addMoveAll(tid, threadData[tid].retiredBag);
+        }
+        controller.deinitThread(tid);
 #ifdef DEAMORTIZE_FREE_CALLS
         this->pool->addMoveAll(tid, threadData[tid].deamortizedFreeables);
         delete threadData[tid].deamortizedFreeables;
 #endif
 
+        if (othersLive) return;
         delete threadData[tid].retiredBag;
         delete threadData[tid].proposedHzptrs;
         delete threadData[tid].scannedHzptrs;
@@ -530,14 +567,29 @@ else
             COUTATOMIC("give a valid value for MAX_RETIREBAG_CAPACITY_POW2!" << std::endl);
             exit(-1);
         }
+        controller.init(num_process, MAX_RETIREBAG_CAPACITY_POW2, sizeof(T));
     }
 
     ~reclaimer_nbr()
     {
+        // move the contents of any bags kept by deinitThread into the pool
+        for (int i = 0; i < num_process; ++i)
+        {
+            if (threadData[i].retiredBag)
+            {
+                this->pool->addMoveAll(i, threadData[i].retiredBag);
+                delete threadData[i].retiredBag;
+                delete threadData[i].proposedHzptrs;
+                delete threadData[i].scannedHzptrs;
+                threadData[i].retiredBag = NULL;
+                threadData[i].proposedHzptrs = NULL;
+                threadData[i].scannedHzptrs = NULL;
+            }
+        }
         // COUTATOMIC("bagCapacityThreshold=" << threadData[tid].bagCapacityThreshold << std::endl); // NOTICEME: Not sure why help me should be used here copying d+;
         
         VERBOSE DEBUG COUTATOMIC("destructor reclaimer_nbr" << std::endl);
-        COUTATOMIC("MaxRetireBagCapacity=" << MAX_RETIREBAG_CAPACITY_POW2 << std::endl);
+        COUTATOMIC("MaxRetireBagCapacity=" << MAX_RETIREBAG_CAPACITY_POW2 << " avg_hiwm=" << controller.averageHiWm() << std::endl);
     }
 };
 
@@ -406,7 +406,7 @@ class reclaimer_nbr_orig : public reclaimer_interface<T, Pool>{
         /*
          * Tells whether the reclaimer supports signalling
         */
-        inline static bool needsSetJmp(){
+        static constexpr bool needsSetJmp(){
             return true;
         }
         
@@ -526,7 +526,8 @@ class reclaimer_nbr_orig : public reclaimer_interface<T, Pool>{
         }
         //NOTICEME:  if I dont write false, them startOp will be called for each rectype and which will cause startOp assrt to fail. As startOp called twice w/o matching endOP 
         //to reset restaratable to 0.
-        inline static bool quiescenceIsPerRecordType() { return false; }
+        static constexpr bool quiescenceIsPerRecordType() { return false; }
+        static constexpr bool needsFenceAfterStartOp() { return false; }
         
         /*
          * CTOR 
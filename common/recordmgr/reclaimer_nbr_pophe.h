@@ -10,9 +10,13 @@
 #ifndef RECLAIM_NBR_POPHE_H
 #define RECLAIM_NBR_POPHE_H
 
-#include <list>
+#include <vector>
 #include "ConcurrentPrimitives.h"
+#include "reservation_slots.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "reservation_snapshot.h"
+#include "scan_reservations.h"
 
 // #if !defined HE_ORIGINAL_FREE || !HE_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -25,7 +29,6 @@ class reclaimer_nbr_pophe : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     // int num_he;
     // PAD; 
     
@@ -42,7 +45,8 @@ private:
         uint64_t local_reserved_epoch[NUM_POPHE]; // pointers that are reserved but not published.
 
         // to save global reservations once before emptying retired bag.
-        uint64_t *scannedHEs;
+        ReservedErasAndIntervals scannedHEs;
+        std::vector<uint64_t> reservationSnapshot; // copy of the reservations of live threads, reused by every empty()
 
         //variables confirming publishing
         PAD;
@@ -75,55 +79,26 @@ public:
     };
 
 private:
-    padded< std::atomic<uint64_t>*>* reservations; // per thread array of reservations 
+    ReservationSlots<uint64_t> *reservations; // per thread array of reservations, one cache line per thread
+    ScanIntervals scanIntervals; // range queries' reservations (see scan_reservations.h)
 
     // padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
-    padded<std::list<HeInfo>> *retired;
+    padded<std::vector<HeInfo>> *retired; // in retire order, so sorted by retire_epoch
 
     PAD;    
-    std::atomic<uint64_t> epoch; 
+    EpochClock epoch;
     PAD;
 
     inline bool requestAllThreadsToRestart(const int tid)
     {
         bool result = false;
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        // deliver pings according to the strategy selected in ping_delivery.h
+        if (!this->recoveryMgr->pingDelivery->pingAll(tid))
         {
-            if (tid != otherTid)
-            {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-                int error = 0;
-                //send signal to other thread
-                // COUTATOMICTID("DEBUG_TID_MAP::"
-                //                     << " tid=" << tid << " with pid=" << pthread_self() << " registeredThreads[" << tid << "]=" << registeredThreads[tid] << " sending sig to tid= " << otherTid << " with pid=" << otherPthread << " registeredThreads[" << otherTid << "]=" << registeredThreads[otherTid] << std::endl);
-
-                // FIXME: I Don't know, should signal be UNblocked after a thread executes a sigandler. So that it could receive sig again?
-                error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-                if (error)
-                {
-                    COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                    if (error == ESRCH)
-                        COUTATOMICTID("ESRCH" << std::endl);
-                    if (error == EINVAL)
-                        COUTATOMICTID("EINVAL" << std::endl);
-
-                    assert("Error when trying to pthread_kill" && 0);
-                    return result;
-                }
-                // else
-                // {
-                //     COUTATOMICTID(" Signal sent via pthread_kill(pthread_tFor(" << otherTid << "  " << otherPthread << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                // }
-            }
-            // else
-            // {
-            //     // publish own reservations
-            //     publishReservations(tid);
-            // } // if (tid != otherTid){
-        }     // for()
+            return result;
+        }
 
     #ifdef USE_GSTATS
         GSTATS_ADD(tid, signalall, 1);
@@ -165,7 +140,7 @@ public:
     {
         for (int i = 0; i < NUM_POPHE; i++)
         {
-			// reservations[tid].ui[i].store(0, std::memory_order_seq_cst);
+			// reservations->at(tid, i).store(0, std::memory_order_seq_cst);
             threadData[tid].local_reserved_epoch[i] = 0;
 		}        
     }
@@ -173,9 +148,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1, std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -208,15 +180,27 @@ public:
     }
 
 
+    // a range query reserves an interval (through readScan) that covers every record it reads until endScan
+    inline void startScan(const int tid, const int maxReads) {
+        scanIntervals.start(tid, getEpoch());
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanIntervals.read(tid, obj, [this]() { return getEpoch(); });
+    }
+    inline void endScan(const int tid) {
+        scanIntervals.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
         assert(obj && "object to be retired in NULL");
 
-        std::list<HeInfo> *myTrash = &(retired[tid].ui);
-        uint64_t birth_epoch = obj->birth_epoch;
-        uint64_t retire_epoch = getEpoch();
+        std::vector<HeInfo> *myTrash = &(retired[tid].ui);
+        uint64_t birth_epoch = EpochClock::birthLowerBound(obj->birth_epoch);
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(HeInfo(obj, birth_epoch, retire_epoch));
+        epoch.onRetire(tid);
         size_t myTrashSize = myTrash->size();
 
 
@@ -232,7 +216,7 @@ public:
             // if bagthreshold has been crossed then ping all threads to publish there reservations. If 0 or a very few records were reclaimed then bag will get full earlier the next time and signal overhead will be incurred. To avoid this ie the frequent signalling overhead we should only attenmpt signalling once atleast half of max size more have been retired ad hope that this time published reserved epochs let us reclaim mor objects. This trades high mem consumption with low sigoverhead. 
             // signall all threads so that they can publish their reserved epochs.
 
-            for (int i = 0; i < num_process; i++){
+            FOR_EACH_LIVE_TID(i, this->liveThreads){
                 threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
             }
 
@@ -246,7 +230,7 @@ public:
                 {
                     // for (int j = 0; j < NUM_POPHE; j++)
                     {
-                        COUTATOMICTID(reservations[i].ui[0].load(std::memory_order_acq_rel) << ":" <<reservations[i].ui[1].load(std::memory_order_acq_rel));
+                        COUTATOMICTID(reservations->at(i, 0).load(std::memory_order_acq_rel) << ":" <<reservations->at(i, 1).load(std::memory_order_acq_rel));
                     }
                     COUTATOMIC(std::endl);
                 }
@@ -254,7 +238,7 @@ public:
 
 
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -279,90 +263,36 @@ public:
     }
 
 
-    bool isFreeable(uint64_t birth_epoch, uint64_t retire_epoch)
-    {
-		// for (int i = 0; i < num_process; i++)
-        // {
-		// 	for (int j = 0; j < NUM_POPHE; j++)
-        //     {
-		// 		const uint64_t epo = reservations[i].ui[j].load(std::memory_order_acquire); // FIXME: incurring a cost due to strict memory order for each object scanned is too many times... optimize this.
-
-		// 		//NOTE: the third condition epo == 0 seems wrong in orig code.
-        //         // what if T1 did 10 alloc. Thus, global epoch is still 0. And T2
-        //         // decides to reclaim a obj that could be accessed in epoc 0 by some thread.
-        //         // A crash would occur. Indeed enabling the check causes seg fault and commenting it gives non crashing execution.
-        //         if (epo < birth_epoch || epo > retire_epoch || epo == 0)
-        //         {
-		// 			continue;
-		// 		}
-        //         else 
-        //         {
-		// 			return false;
-		// 		}
-		// 	}
-		// }
-		// return true;
-    
-        for (uint64_t ith = 0; ith < num_process*NUM_POPHE; ith++)
-        {
-            const uint64_t epo = threadData[tid].scannedHEs[ith];
-
-            if (epo < birth_epoch || epo > retire_epoch || epo == 0)
-            {
-                continue;
-            }
-            else 
-            {
-                return false;
-            }
-        }
-
-		return true;
-    }
-
     void empty(const int tid)
     {
+        RECLAMATION_EVENT;
         
         // erase safe objects
-        std::list<HeInfo> *myTrash = &(retired[tid].ui);
+        std::vector<HeInfo> *myTrash = &(retired[tid].ui);
 
         // uint before_sz = myTrash->size();
         // if (0 == tid) COUTATOMICTID("decided to empty! bag size=" << myTrash->size() << " min_reserved_epoch=" << min_reserved_epoch <<std::endl);
 
-        for (int i = 0; i < num_process; i++)
-        {
-			for (int j = 0; j < NUM_POPHE; j++)
-            {
-                threadData[tid].scannedHEs[(i*NUM_POPHE)+j] = reservations[i].ui[j].load(std::memory_order_acquire);
-            }
-        }
-
-        // int delme_num_reclaimed = 0, delme_cntr = 0;
-        for (auto iterator = myTrash->begin(), end = myTrash->end(); iterator != end;)
+        std::vector<uint64_t>& snapshot = threadData[tid].reservationSnapshot;
+        snapshot.resize(reservations->size());
+        const int n = reservations->snapshot(this->liveThreads, snapshot.data(), std::memory_order_acquire);
+        threadData[tid].scannedHEs.clear();
+        for (int i = 0; i < n; i++)
         {
-            HeInfo res = *iterator;
-            
-            // if (0 == tid && (++delme_cntr < 10 || delme_cntr > before_sz-10)) COUTATOMIC("re="<<res.retire_epoch<<" ");
-
-            if (isFreeable(res.birth_epoch, res.retire_epoch))
-            {
-            // this->pool->add(tid, res.obj);
-            #ifdef DEAMORTIZE_FREE_CALLS
-                threadData[tid].deamortizedFreeables->add(res.obj);
-            #else
-                this->pool->add(tid, res.obj); //reclaim
-                // ++delme_num_reclaimed;
-            #endif
-
-                iterator = myTrash->erase(iterator); //return iterator corresponding to next of last erased item
-            }
-            else
-            {
-                // OPTIMIZATION2
-                // I can break frm the loop. as all the following objects are guaranteed to have a retire epoch greater than min_reserved_epoch. FIXME: Proof needed.
-                ++iterator;
-            }
+            threadData[tid].scannedHEs.add(snapshot[i]);
         }
+        scanIntervals.forEach(this->liveThreads, [&](const uint64_t lower, const uint64_t upper) {
+            threadData[tid].scannedHEs.add(lower, upper);
+        });
+        threadData[tid].scannedHEs.build();
+
+        freeUnreserved(*myTrash, threadData[tid].scannedHEs, [&](T *obj) {
+        #ifdef DEAMORTIZE_FREE_CALLS
+            threadData[tid].deamortizedFreeables->add(obj);
+        #else
+            this->pool->add(tid, obj); //reclaim
+        #endif
+        });
 
 #ifdef POP_DEBUG 
         uint after_sz = myTrash->size();
@@ -402,7 +332,6 @@ public:
             threadData[tid].local_reserved_epoch[j] = 0;
         }
         threadData[tid].num_sigallattempts_since_last_attempt = 0;
-        threadData[tid].scannedHEs = new uint64_t [num_process * NUM_POPHE];
 
         threadData[tid].mypublishingTS = 0;
         threadData[tid].myscannedTS = new unsigned int[num_process * PREFETCH_SIZE_WORDS];
@@ -414,7 +343,6 @@ public:
         delete threadData[tid].deamortizedFreeables;
 #endif
         // COUTATOMICTID("bagCapacityThreshold=" << threadData[tid].bagCapacityThreshold << std::endl);
-        delete[] threadData[tid].scannedHEs;  
         delete[] threadData[tid].myscannedTS;      
     }
     inline static bool isProtected(const int tid, T *const obj) { return true; }
@@ -424,10 +352,11 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
     
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
 
     /**
@@ -446,7 +375,7 @@ public:
         
         for (int j = 0; j < NUM_POPHE; j++)
         {
-            reservations[tid].ui[j].store(threadData[tid].local_reserved_epoch[j], std::memory_order_seq_cst); 
+            reservations->at(tid, j).store(threadData[tid].local_reserved_epoch[j], std::memory_order_seq_cst); 
             // FIXME: should it be relaxed? I think no, we need to ensure that subsequent loads do not get redordered.
         }
 
@@ -460,25 +389,16 @@ public:
         VERBOSE std::cout << "constructor reclaimer_nbr_pophe helping=" << this->shouldHelp() << std::endl;
         num_process = numProcesses;
         freq = 32768; //16384; //32768; //30;
-        epoch_freq = 100;
 
         if (_recoveryMgr)
             COUTATOMIC("SIGRTMIN=" << SIGRTMIN << " neutralizeSignal=" << this->recoveryMgr->neutralizeSignal << std::endl);
         
-        retired = new padded<std::list<HeInfo>>[num_process];
+        retired = new padded<std::vector<HeInfo>>[num_process];
 
-        reservations = new padded< std::atomic<uint64_t>* >[num_process];
-        for (int i = 0; i < num_process; i++)
-        {
-            reservations[i].ui = new std::atomic<uint64_t>[NUM_POPHE];
-            for (int j = 0; j < NUM_POPHE; j++)
-            {
-                reservations[i].ui[j].store(0);
-            }
-        }        
+        reservations = new ReservationSlots<uint64_t>(num_process, NUM_POPHE, 0);
         // retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(1);
+        epoch.init(num_process, 1, freq);
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif        
@@ -490,22 +410,19 @@ public:
         for (int i = 0; i < num_process; i++)
         {
             // COUTATOMIC(retired[i].ui.size()<<std::endl);
-            for (auto iterator = retired[i].ui.begin(), end = retired[i].ui.end(); iterator != end; )
+            for (auto iterator = retired[i].ui.begin(), end = retired[i].ui.end(); iterator != end; ++iterator)
             {
-                HeInfo res = *iterator;
-                iterator=retired[i].ui.erase(iterator); //return iterator corresponding to next of last erased item
-                this->pool->add(i, res.obj); //reclaim
+                this->pool->add(i, iterator->obj); //reclaim
             }
-
-            delete [] reservations[i].ui;
+            retired[i].ui.clear();
         }
 
         delete [] retired;
-        // delete [] reservations; //FIXME: is this needed?
+        // delete reservations; //FIXME: is this needed?
         // delete [] retire_counters;
         delete [] alloc_counters;
         // std::cout <<"reclaimer destructor finished" <<std::endl;
-		COUTATOMIC("epoch_freq= " << epoch_freq <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl);
     }
 };
 
@@ -12,7 +12,12 @@
 
 #include <list>
 #include "ConcurrentPrimitives.h"
+#include "reservation_slots.h"
+#include "reservation_snapshot.h"
+#include "scan_reservations.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "reclaim_controller.h"
 
 // #if !defined HE_ORIGINAL_FREE || !HE_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -25,7 +30,6 @@ class reclaimer_nbr_popplushe : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     // int num_he;
     // PAD; 
     
@@ -55,6 +59,8 @@ private:
 
         // to save global reservations once before emptying retired bag.
         uint64_t *scannedHEs;
+        int numScannedHEs; // number of reservations (of live threads) in scannedHEs
+        ReservedIntervals scannedScanIntervals; // range queries' reservations, taken with scannedHEs
 
         //variables confirming publishing
         PAD;
@@ -87,17 +93,19 @@ public:
     };
 
 private:
-    padded< std::atomic<uint64_t>*>* reservations; // per thread array of reservations 
+    ReservationSlots<uint64_t> *reservations; // per thread array of reservations, one cache line per thread
+    ScanIntervals scanIntervals; // range queries' reservations (see scan_reservations.h)
 
     padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
+    ReclaimController controller; // tunes each thread's bagCapacityThreshold
     padded<std::list<HeInfo>> *retired;
 
     // FIXME: following vars could be of padded type, instead of using a separate PAD.
     PAD;
     std::atomic<uint64_t> publishing_epoch; 
     PAD;    
-    std::atomic<uint64_t> epoch; 
+    EpochClock epoch;
     PAD;
 
     inline bool requestAllThreadsToRestart(const int tid)
@@ -106,36 +114,11 @@ private:
         //Theorem: The signalling thread should also publish it's epochs so that other threads in LoWm could reclaim correctly.
         publishReservations(tid);
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        // deliver pings according to the strategy selected in ping_delivery.h
+        if (!this->recoveryMgr->pingDelivery->pingAll(tid))
         {
-            if (tid != otherTid)
-            {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-                int error = 0;
-                //send signal to other thread
-                // COUTATOMICTID("DEBUG_TID_MAP::"
-                //                     << " tid=" << tid << " with pid=" << pthread_self() << " registeredThreads[" << tid << "]=" << registeredThreads[tid] << " sending sig to tid= " << otherTid << " with pid=" << otherPthread << " registeredThreads[" << otherTid << "]=" << registeredThreads[otherTid] << std::endl);
-
-                // FIXME: I Don't know, should signal be UNblocked after a thread executes a sigandler. So that it could receive sig again?
-                error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-                if (error)
-                {
-                    COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                    if (error == ESRCH)
-                        COUTATOMICTID("ESRCH" << std::endl);
-                    if (error == EINVAL)
-                        COUTATOMICTID("EINVAL" << std::endl);
-
-                    assert("Error when trying to pthread_kill" && 0);
-                    return result;
-                }
-                // else
-                // {
-                //     COUTATOMICTID(" Signal sent via pthread_kill(pthread_tFor(" << otherTid << "  " << otherPthread << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                // }
-            } // if (tid != otherTid){
-        }     // for()
+            return result;
+        }
 
         // increment the publishing epoch so that LoWm threads could reclaim.
         //FIXME: using a global atomic var seems slow? Shoudl use lamport clock like original NBR+?
@@ -184,17 +167,17 @@ public:
     {
         for (int i = 0; i < NUM_POPHE; i++)
         {
-			// reservations[tid].ui[i].store(0, std::memory_order_seq_cst);
+			// reservations->at(tid, i).store(0, std::memory_order_seq_cst);
             threadData[tid].local_reserved_epoch[i] = 0;
+        #ifdef POP_PUBLISH_MEMBARRIER
+            reservations->at(tid, i).store(0, std::memory_order_relaxed);
+        #endif
 		}        
     }
 
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1, std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -208,8 +191,7 @@ public:
 
         // approach3: 1, 5, 10, 15....50%
         // setLoWmTryReclaimFrequency();
-        int rand_val = (rand()%11);
-        threadData[tid].LoPathReclaimAttemptFreq = (rand_val==0)? (0.1*MAX_RETIREBAG_CAPACITY_POW2) : (unsigned int)((((rand_val*5))/100.0 )*MAX_RETIREBAG_CAPACITY_POW2);
+        threadData[tid].LoPathReclaimAttemptFreq = controller.nextLoAttemptFreq(tid, 0.1);
 
         // threadData[tid].LoPathReclaimAttemptFreq = 90; //30;
     }
@@ -258,6 +240,12 @@ public:
 			}
             // skip publishing untill signalled. Save locally so that it can be published when pinged.
             threadData[tid].local_reserved_epoch[idx] = curr_epoch;
+        #ifdef POP_PUBLISH_MEMBARRIER
+            // reserve directly in the shared slot; the reclaimer's membarrier makes it visible.
+            // compiler barrier keeps this store before the validating loads of the next iteration.
+            reservations->at(tid, idx).store(curr_epoch, std::memory_order_relaxed);
+            asm volatile ("" : : : "memory");
+        #endif
             prev_epoch = curr_epoch;
 
 
@@ -265,16 +253,29 @@ public:
     }
 
 
+    // a range query reserves an interval (through readScan) that covers every record it reads until endScan
+    inline void startScan(const int tid, const int maxReads) {
+        scanIntervals.start(tid, getEpoch());
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanIntervals.read(tid, obj, [this]() { return getEpoch(); });
+    }
+    inline void endScan(const int tid) {
+        scanIntervals.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
         assert(obj && "object to be retired in NULL");
 
         std::list<HeInfo> *myTrash = &(retired[tid].ui);
-        uint64_t birth_epoch = obj->birth_epoch;
-        uint64_t retire_epoch = getEpoch();
+        uint64_t birth_epoch = EpochClock::birthLowerBound(obj->birth_epoch);
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(HeInfo(obj, birth_epoch, retire_epoch));
+        epoch.onRetire(tid);
         size_t myTrashSize = myTrash->size();
+        controller.onRetire(tid, myTrashSize);
 
 
         // NOTE: unlike NBR, in POP+HE Hi Wm doesn't guarantee that all objects in the bag will be reclaimed. If all object's be and re conflict with epochs (see is Freeable) then the bag may still be full even after sigAll at HiWm. Robustness or bound on unreclaimed records is similar to HE.
@@ -286,17 +287,19 @@ public:
 
             // if bagthreshold has been crossed then ping all threads to publish there reservations. If 0 or a very few records were reclaimed then bag will get full earlier the next time and signal overhead will be incurred. To avoid this ie the frequent signalling overhead we should only attenmpt signalling once atleast half of max size more have been retired ad hope that this time published reserved epochs let us reclaim mor objects. This trades high mem consumption with low sigoverhead. 
             // sigall all threads so that they can publish their reserved epochs.
-            for (int i = 0; i < num_process; i++){
+            FOR_EACH_LIVE_TID(i, this->liveThreads){
                 threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
             }
 
+            controller.beginSignal(tid);
             if (requestAllThreadsToRestart(tid))
             {
+                controller.endSignal(tid);
 
                 // ensure all threads published.
         // #ifndef GARBAGE_BOUND_EXP
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -312,6 +315,7 @@ public:
                 // This reclaimer will use those reservations to identify unsafe objects.
                 // print reserved epoch here
                 bool empty_result = empty(tid);
+                threadData[tid].bagCapacityThreshold = controller.onHiWmReclaim(tid, myTrashSize, myTrash->size());
                 // #ifdef USE_GSTATS
                 //     GSTATS_APPEND(tid, reclamation_event_size, myTrashSize);
                 // #endif
@@ -345,6 +349,7 @@ public:
                 //     GSTATS_APPEND(tid, lo_reclamation_event_size, myTrashSize);
                 // #endif
                 empty(tid);
+                controller.onLoWmReclaim(tid, myTrashSize, myTrash->size());
 
                 resetLoWmMetaData(tid);
                 threadData[tid].retire_bag_size_when_entered_loWm = 0;
@@ -369,11 +374,13 @@ public:
 
     inline bool isFreeable(uint64_t birth_epoch, uint64_t retire_epoch, const int tid)
     {
+        if (threadData[tid].scannedScanIntervals.conflicts(birth_epoch, retire_epoch)) return false;
+
 		// for (int i = 0; i < num_process; i++)
         // {
 		// 	for (int j = 0; j < NUM_POPHE; j++)
         //     {
-		// 		const uint64_t epo = reservations[i].ui[j].load(std::memory_order_acquire); // FIXME: incurring a cost due to strict memory order for each object scanned is too many times... optimize this.
+		// 		const uint64_t epo = reservations->at(i, j).load(std::memory_order_acquire); // FIXME: incurring a cost due to strict memory order for each object scanned is too many times... optimize this.
 
 		// 		//NOTE: the third condition epo == 0 seems wrong in orig code.
         //         // what if T1 did 10 alloc. Thus, global epoch is still 0. And T2
@@ -390,7 +397,7 @@ public:
 		// 	}
 		// }
 
-        for (uint64_t ith = 0; ith < num_process*NUM_POPHE; ith++)
+        for (int ith = 0; ith < threadData[tid].numScannedHEs; ith++)
         {
             const uint64_t epo = threadData[tid].scannedHEs[ith];
 
@@ -410,6 +417,7 @@ public:
     // return type of empty() is bool. This is only specific for POPPLUS.
     bool empty(const int tid)
     {
+        RECLAMATION_EVENT;
         
         // erase safe objects
         std::list<HeInfo> *myTrash = &(retired[tid].ui);
@@ -420,13 +428,12 @@ public:
         // #endif        
         // if (0 == tid) COUTATOMICTID("decided to empty! bag size=" << myTrash->size() << " min_reserved_epoch=" << min_reserved_epoch <<std::endl);
 
-        for (int i = 0; i < num_process; i++)
-        {
-			for (int j = 0; j < NUM_POPHE; j++)
-            {
-                threadData[tid].scannedHEs[(i*NUM_POPHE)+j] = reservations[i].ui[j].load(std::memory_order_acquire);
-            }
-        }
+        threadData[tid].numScannedHEs = reservations->snapshot(this->liveThreads, threadData[tid].scannedHEs, std::memory_order_acquire);
+        threadData[tid].scannedScanIntervals.clear();
+        scanIntervals.forEach(this->liveThreads, [&](const uint64_t lower, const uint64_t upper) {
+            threadData[tid].scannedScanIntervals.add(lower, upper);
+        });
+        threadData[tid].scannedScanIntervals.build();
 
         // int delme_num_reclaimed = 0, delme_cntr = 0;
         int reclaimed_so_far = 0;
@@ -500,7 +507,8 @@ public:
         // }
         // else
         {
-            threadData[tid].bagCapacityThreshold = MAX_RETIREBAG_CAPACITY_POW2;
+            controller.initThread(tid);
+            threadData[tid].bagCapacityThreshold = controller.hiWm(tid);
         }
 
         for (int j = 0; j < NUM_POPHE; j++)
@@ -535,10 +543,11 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
     
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
 
     /**
@@ -555,11 +564,13 @@ public:
     inline void publishReservations(const int tid)
     {
         
+    #ifndef POP_PUBLISH_MEMBARRIER // otherwise reservations are always in the shared slots
         for (int j = 0; j < NUM_POPHE; j++)
         {
-            reservations[tid].ui[j].store(threadData[tid].local_reserved_epoch[j], std::memory_order_seq_cst); 
+            reservations->at(tid, j).store(threadData[tid].local_reserved_epoch[j], std::memory_order_seq_cst); 
             // FIXME: should it be relaxed? I think no, we need to ensure that subsequent loads do not get redordered.
         }
+    #endif
         threadData[tid].mypublishingTS.fetch_add(1, std::memory_order_acq_rel);              
         return;
     }    
@@ -575,29 +586,20 @@ public:
 #else
         freq = MAX_RETIREBAG_CAPACITY_POW2; //16384; //32000; //30; //on lines with nbr
 #endif
-        epoch_freq = 30;
 
         if (_recoveryMgr)
             COUTATOMIC("SIGRTMIN=" << SIGRTMIN << " neutralizeSignal=" << this->recoveryMgr->neutralizeSignal << std::endl);
         
         retired = new padded<std::list<HeInfo>>[num_process];
-        reservations = new padded< std::atomic<uint64_t>* >[num_process];
-        for (int i = 0; i < num_process; i++)
-        {
-            reservations[i].ui = new std::atomic<uint64_t>[NUM_POPHE];
-            for (int j = 0; j < NUM_POPHE; j++)
-            {
-                reservations[i].ui[j].store(0);
-            }
-        }        
+        reservations = new ReservationSlots<uint64_t>(num_process, NUM_POPHE, 0);
         retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(1);
+        epoch.init(num_process, 1, freq);
         publishing_epoch.store(0);
+        controller.init(num_process, MAX_RETIREBAG_CAPACITY_POW2, sizeof(T));
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif   
-        srand (time(NULL));     
     }
     ~reclaimer_nbr_popplushe()
     {
@@ -612,17 +614,21 @@ public:
                 iterator=retired[i].ui.erase(iterator); //return iterator corresponding to next of last erased item
                 this->pool->add(i, res.obj); //reclaim
             }
-
-            delete [] reservations[i].ui;
         }
 
         delete [] retired;
-        // delete [] reservations; //FIXME: is this needed?
+        // delete reservations; //FIXME: is this needed?
         delete [] retire_counters;
         delete [] alloc_counters;
         // std::cout <<"reclaimer destructor finished" <<std::endl;
-		COUTATOMIC("epoch_freq= " << epoch_freq <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl<< "avg_hiwm= " << controller.averageHiWm() <<std::endl);
     }
 };
 
+#ifdef POP_PUBLISH_MEMBARRIER
+// nbr_popplushe with the membarrier publish backend (see ping_delivery.h), named separately so experiments can compare both
+template <typename T = void, class Pool = pool_interface<T>>
+using reclaimer_nbr_popplushe_mb = reclaimer_nbr_popplushe<T, Pool>;
+#endif
+
 #endif //RECLAIM_NBR_POPPLUSHE_H
@@ -15,6 +15,7 @@
 #include "reclaimer_interface.h"
 #include "arraylist.h"
 #include "hashtable.h"
+#include "reclaim_controller.h"
 
 // #if !defined NBRPLUS_ORIGINAL_FREE || !NBRPLUS_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -37,6 +38,8 @@ private:
     unsigned int num_process;
     PAD;
     padded<uint64_t> *retire_counters;
+    ReclaimController controller; // tunes each thread's bagCapacityThreshold
+    PAD;
 
 
     //thread local vars and data structures
@@ -75,7 +78,7 @@ private:
 #endif
         //END OPTIMIZED_SIGNAL: LoWatermark variables
 
-        ThreadData() {}
+        ThreadData() : retiredBag(NULL), proposedHzptrs(NULL), scannedHzptrs(NULL), announcedTS(0), savedTS(NULL) {}
     private:
         PAD;
     };
@@ -167,8 +170,7 @@ private:
         // }
 
         // approach3: 1, 5, 10, 15....50%
-        int rand_val = (rand()%11);
-        threadData[tid].LoPathReclaimAttemptFreq = (rand_val==0)? (0.01*MAX_RETIREBAG_CAPACITY_POW2) : (unsigned int)((((rand_val*5))/100.0 )*MAX_RETIREBAG_CAPACITY_POW2);
+        threadData[tid].LoPathReclaimAttemptFreq = controller.nextLoAttemptFreq(tid, 0.01);
 
         // approach4: 1, 5, 10, 15....50%
         // int bias_value = rand()%10;
@@ -224,6 +226,11 @@ private:
      * Each threads threshold size is set randomly to avoid all threads reaching size threashold at the same time. Note this is an optimization
      * as it would prevent all threads from bottlenecking whole system by sending signals at the same time.   
     */
+    inline size_t retiredBagSize(const int tid)
+    {
+        return (threadData[tid].retiredBag->getSizeInBlocks() - 1) * BLOCK_SIZE + threadData[tid].retiredBag->getHeadSize();
+    }
+
     inline bool isOutOfPatience(const int tid)
     {
         // if (temp_patience == 0)
@@ -240,14 +247,13 @@ private:
     */
     inline bool requestAllThreadsToRestart(const int tid)
     {
+        RECLAMATION_EVENT;
         bool result = false;
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        FOR_EACH_LIVE_TID(otherTid, this->liveThreads)
         {
             if (tid != otherTid)
             {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
                 int error = 0;
                 //send signal to other thread
                 // DEBUG COUTATOMICTID("DEBUG_TID_MAP::"
@@ -256,7 +262,10 @@ private:
                 // assert(debug_main_thread_pid != otherPthread);
                 // assert(debug_main_thread_pid != registeredThreads[otherTid]);
 
-                if (error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal))
+                // (synchronized with otherTid's exit, and skipped if otherTid has left)
+                error = this->recoveryMgr->signalThread(otherTid);
+                if (error == ThreadSignals::NO_THREAD) continue;
+                if (error)
                 {
                     COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
                     if (error == ESRCH)
@@ -295,16 +304,18 @@ private:
         threadData[tid].scannedHzptrs->clear();
         assert("scannedHzptrs size should be 0 before collection" && threadData[tid].scannedHzptrs->size() == 0);
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        FOR_EACH_LIVE_TID(otherTid, this->liveThreads)
         {
             // if (otherTid != tid){ //FIXME: Don't know why skipping to collect own HPs caused gtree validation failure??
-            unsigned int sz = threadData[otherTid].proposedHzptrs->size(); //size shouldn't change during execution.
+            AtomicArrayList<T> * const otherHzptrs = threadData[otherTid].proposedHzptrs;
+            if (!otherHzptrs) continue; // otherTid is not initialized (e.g., a sweep trial with fewer threads)
+            unsigned int sz = otherHzptrs->size(); //size shouldn't change during execution.
             assert("prposedHzptr[othertid] should be less than max" && sz <= MAX_PER_THREAD_HAZARDPTR);
 
             //for each hazard pointer in othertid proposed hazard ptrs.
             for (int ixHP = 0; ixHP < sz; ++ixHP)
             {
-                T *hp = (T *)threadData[otherTid].proposedHzptrs->get(ixHP);
+                T *hp = (T *)otherHzptrs->get(ixHP);
                 if (hp)
                 {
                     threadData[tid].scannedHzptrs->insert((T *)hp);
@@ -321,6 +332,7 @@ private:
     */
     inline void sendFreeableRecordsToPool(const int tid, blockbag<T> *const freeable, blockbag<T> *const spareMeBag)
     {
+        RECLAMATION_EVENT;
         //get apointer to retirbag of current thread
         T *ptr;
         //one by one remove the records from retireBag. Free it if not Hp protected else add it to spareMeBag.
@@ -543,10 +555,11 @@ else
     /*
     * Tells whether the reclaimer uses signalling. Use this API to distinguish a NBR specific call using record manager inside a ds operation. You may use this API to tell that the function is meant to invoke NBR's API and skip unnecessarily invoking NBR specific API while using Debra or other reclaimers. 
     */
-    inline static bool needsSetJmp()
+    static constexpr bool needsSetJmp()
     {
         return true;
     }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
     /**
      * Public API. A ds calls this API after logically deleting (unlinking) a record from DS. It saves the record in retireBag for a delayed free. 
@@ -562,8 +575,11 @@ else
             // #ifdef OPTIMIZED_SIGNAL
             std::atomic_fetch_add(&threadData[tid].announcedTS, 1llu); //tell other threads that I am starting signalling.
 
+            const size_t sizeBefore = retiredBagSize(tid);
+            controller.beginSignal(tid);
             if (requestAllThreadsToRestart(tid))
             {
+                controller.endSignal(tid);
                 // TRACE COUTATOMICTID("retire:: outOfPatience: restarted all threads, gonna continue reclaim =" << threadData[tid].retiredBag->getSizeInBlocks() << " block" << std::endl);
                 
                 // #ifdef OPTIMIZED_SIGNAL
@@ -571,6 +587,7 @@ else
                 
                 // resetLoWmBookmark(tid); 
                 HiWmreclaimFreeable(tid);
+                threadData[tid].bagCapacityThreshold = controller.onHiWmReclaim(tid, sizeBefore, retiredBagSize(tid));
 
                 resetLoWmMetaData(tid);
 // #ifdef GSTATS_HANDLE_STATS
@@ -595,7 +612,7 @@ else
                 //entered lowWM path for the first time save metadata that would be help to reclaim when someone reaches hiWM
                 setLoWmMetaData(tid);
             }
-            for (int i = 0; i < num_process; i++){ //TODO: skip self comparison.
+            FOR_EACH_LIVE_TID(i, this->liveThreads){ //TODO: skip self comparison.
                 if( threadData[i].announcedTS >= threadData[tid].savedTS[i] + 2){
                     // TRACE COUTATOMICTID("retire:: ******reclaiming atLowWatermark Path*******"<<"announcedTS[i]="<<threadData[i].announcedTS<<"savedTS[i]="<<threadData[tid].savedTS[i]<<std::endl);
 // #ifdef GSTATS_HANDLE_STATS
@@ -604,7 +621,9 @@ else
 //                     // GSTATS_APPEND(tid, consecutive_lwm_attempts, threadData[tid].LoPathNumConsecutiveAttempts);
 // #endif
                     //reclaim freeable API
+                    const size_t sizeBefore = retiredBagSize(tid);
                     LoWmreclaimFreeable(tid); //If bag head not null then reclamation shall happen from baghead to tail in api depicting reclamation of lowatermarkpath..
+                    controller.onLoWmReclaim(tid, sizeBefore, retiredBagSize(tid));
 
                     resetLoWmMetaData(tid);
                     break;
@@ -618,6 +637,7 @@ else
         assert("retiredBag ds should be non-null" && threadData[tid].retiredBag);
         assert("record to be added should be non-null" && record);
         threadData[tid].retiredBag->add(record);
+        controller.onRetire(tid, retiredBagSize(tid));
         // if (tid == 0 ) COUTATOMICTID("retire: curr"<<(threadData[tid].retiredBag->begin()).getCurr()<<"index="<<(threadData[tid].retiredBag->begin()).getIndex()<<std::endl);
     }
 
@@ -670,9 +690,10 @@ else
             // }
         }
 
-        threadData[tid].retiredBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
-        threadData[tid].proposedHzptrs = new AtomicArrayList<T>(MAX_PER_THREAD_HAZARDPTR);
-        threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * MAX_PER_THREAD_HAZARDPTR);
+        // a tid that rejoins reuses the retired bag and lists kept by deinitThread
+        if (threadData[tid].retiredBag == NULL) threadData[tid].retiredBag = new blockbag<T>(tid, this->pool->blockpools[tid]);
+        if (threadData[tid].proposedHzptrs == NULL) threadData[tid].proposedHzptrs = new AtomicArrayList<T>(MAX_PER_THREAD_HAZARDPTR);
+        if (threadData[tid].scannedHzptrs == NULL) threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * MAX_PER_THREAD_HAZARDPTR);
 
 #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
@@ -680,7 +701,8 @@ else
 #endif
         // temp_patience = (MAX_RETIREBAG_CAPACITY_POW2/BLOCK_SIZE) + (tid%5);
         // temp_patience = (MAX_RETIREBAG_CAPACITY_POW2 / BLOCK_SIZE);
-        threadData[tid].bagCapacityThreshold = MAX_RETIREBAG_CAPACITY_POW2;
+        controller.initThread(tid);
+        threadData[tid].bagCapacityThreshold = controller.hiWm(tid);
 
         // #ifdef OPTIMIZED_SIGNAL
         threadData[tid].savedRetireBagBlockInfo = std::make_pair(nullptr, -1);
@@ -693,8 +715,6 @@ else
 #ifdef GSTATS_HANDLE_STATS_DELME        
         threadData[tid].LoPathNumConsecutiveAttempts = 0; //default 1/2 of Max bagsize
 #endif
-        srand (time(NULL));
-        
         // #endif
     }
 
@@ -716,7 +736,20 @@ else
             // }
         }
 
-        this->pool->addMoveAll(tid, threadData[tid].retiredBag);
+        // if other threads are still running (e.g., this thread is being
+        // replaced), they may hold references to records in retiredBag, and may
+        // still be reading proposedHzptrs, so these are kept for the next thread
+        // with this tid (or freed by the destructor).
+        const bool othersLive = this->liveThreads && this->liveThreads->hasMemberOtherThan(tid);
+        if (othersLive)
+        {
+            threadData[tid].proposedHzptrs->clear();
+        }
+        else
+        {
+            this->pool->addMoveAll(tid, threadData[tid].retiredBag);
+        }
+        controller.deinitThread(tid);
 #ifdef DEAMORTIZE_FREE_CALLS
         this->pool->addMoveAll(tid, threadData[tid].deamortizedFreeables);
         delete threadData[tid].deamortizedFreeables;
@@ -729,6 +762,7 @@ else
         // threadData[tid].savedBagBlockPtr = nullptr; //blockbag is reponsible to delete the pointer pointed by savedBagBlockPtr
         // #endif
 
+        if (othersLive) return;
         delete threadData[tid].retiredBag;
         delete threadData[tid].proposedHzptrs;
         delete threadData[tid].scannedHzptrs;
@@ -759,12 +793,26 @@ else
             exit(-1);
         }
         retire_counters = new padded<uint64_t>[num_process];
-
+        controller.init(num_process, MAX_RETIREBAG_CAPACITY_POW2, sizeof(T));
     }
 
     ~reclaimer_nbrplus()
     {
-        COUTATOMIC("bagCapacityThreshold=" << threadData[tid].bagCapacityThreshold << std::endl); // NOTICEME: Not sure why help me should be used here copying d+;
+        // move the contents of any bags kept by deinitThread into the pool
+        for (int i = 0; i < num_process; ++i)
+        {
+            if (threadData[i].retiredBag)
+            {
+                this->pool->addMoveAll(i, threadData[i].retiredBag);
+                delete threadData[i].retiredBag;
+                delete threadData[i].proposedHzptrs;
+                delete threadData[i].scannedHzptrs;
+                threadData[i].retiredBag = NULL;
+                threadData[i].proposedHzptrs = NULL;
+                threadData[i].scannedHzptrs = NULL;
+            }
+        }
+        COUTATOMIC("bagCapacityThreshold=" << threadData[tid].bagCapacityThreshold << " avg_hiwm=" << controller.averageHiWm() << std::endl); // NOTICEME: Not sure why help me should be used here copying d+;
         delete [] retire_counters;
 
         VERBOSE DEBUG COUTATOMIC("destructor reclaimer_nbrplus" << std::endl);
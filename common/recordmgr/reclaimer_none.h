@@ -55,9 +55,10 @@ public:
     
     std::string getDetailsString() { return "no reclaimer"; }
     std::string getSizeString() { return "no reclaimer"; }
-    inline static bool shouldHelp() {
+    static constexpr bool shouldHelp() {
         return true;
     }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
     
     inline static bool isQuiescent(const int tid) {
         return true;
@@ -12,6 +12,7 @@
 #include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
 
 // #if !defined IBR_ORIGINAL_FREE || !IBR_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -23,7 +24,6 @@ class reclaimer_popplus2geibr : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     // PAD;
 
     static const int MAX_RETIREBAG_CAPACITY_POW2 = 32768; //16384; //32768; //16384; //32768; //4096; //8192;//16384;//32768;          //16384;
@@ -90,7 +90,7 @@ private:
     padded<uint64_t> *alloc_counters;
     padded<std::list<IntervalInfo>> *retired;
 
-    std::atomic<uint64_t> epoch;
+    EpochClock epoch;
     PAD;
     std::atomic<uint64_t> publishing_epoch; 
     PAD;    
@@ -102,41 +102,11 @@ private:
         //Theorem: The signalling thread should also publish it's epochs so that other threads in LoWm could reclaim correctly.
         publishReservations(tid);
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        // deliver pings according to the strategy selected in ping_delivery.h
+        if (!this->recoveryMgr->pingDelivery->pingAll(tid))
         {
-            if (tid != otherTid)
-            {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-                int error = 0;
-                //send signal to other thread
-                // COUTATOMICTID("DEBUG_TID_MAP::"
-                //                     << " tid=" << tid << " with pid=" << pthread_self() << " registeredThreads[" << tid << "]=" << registeredThreads[tid] << " sending sig to tid= " << otherTid << " with pid=" << otherPthread << " registeredThreads[" << otherTid << "]=" << registeredThreads[otherTid] << std::endl);
-
-                // FIXME: I Don't know, should signal be UNblocked after a thread executes a sigandler. So that it could receive sig again?
-                error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-                if (error)
-                {
-                    COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                    if (error == ESRCH)
-                        COUTATOMICTID("ESRCH" << std::endl);
-                    if (error == EINVAL)
-                        COUTATOMICTID("EINVAL" << std::endl);
-
-                    assert("Error when trying to pthread_kill" && 0);
-                    return result;
-                }
-                // else
-                // {
-                //     COUTATOMICTID(" Signal sent via pthread_kill(pthread_tFor(" << otherTid << "  " << otherPthread << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                // }
-            }
-            // else
-            // {
-            //     // publish own reservations
-            //     publishReservations(tid);
-            // } // if (tid != otherTid){
-        }     // for()
+            return result;
+        }
 
         //FIXME: using a global atomic var seems slow? Shoudl use lamport clock like original NBR+?
 
@@ -202,9 +172,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -279,6 +246,14 @@ public:
     //     return nullptr;
     // }
 
+    // read() already extends the interval reserved at startOp to cover every record the operation reads,
+    // so a range query needs no further reservations
+    inline void startScan(const int tid, const int maxReads) {}
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return read(tid, 0, obj);
+    }
+    inline void endScan(const int tid) {}
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -286,14 +261,15 @@ public:
         {
             return;
         }
-        uint64_t birth_epoch = obj->birth_epoch;
+        uint64_t birth_epoch = EpochClock::birthLowerBound(obj->birth_epoch);
         std::list<IntervalInfo> *myTrash = &(retired[tid].ui);
         // for(auto it = myTrash->begin(); it!=myTrash->end(); it++){
         // 	assert(it->obj!=obj && "double retire error");
         // }
 
-        uint64_t retire_epoch = getEpoch();
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(IntervalInfo(obj, birth_epoch, retire_epoch));
+        epoch.onRetire(tid);
         size_t myTrashSize = myTrash->size();
         // retire_counters[tid] = retire_counters[tid] + 1;
         // if (retire_counters[tid] % freq == 0)
@@ -303,7 +279,7 @@ public:
             resetLoWmMetaData(tid);
             threadData[tid].retire_bag_size_when_entered_loWm = 0;            
             
-            for (int i = 0; i < num_process; i++){
+            FOR_EACH_LIVE_TID(i, this->liveThreads){
                 threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
             }            
             if (requestAllThreadsToRestart(tid))
@@ -311,7 +287,7 @@ public:
 
                 // ensure all threads published.
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -370,7 +346,7 @@ public:
 
     inline bool conflict(uint64_t *lower_epochs, uint64_t *upper_epochs, uint64_t birth_epoch, uint64_t retire_epoch)
     {
-        for (int i = 0; i < num_process; i++)
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             if (upper_epochs[i] >= birth_epoch && lower_epochs[i] <= retire_epoch)
             {
@@ -382,6 +358,7 @@ public:
 
     bool empty(const int tid)
     {
+        RECLAMATION_EVENT;
         //read all epochs
         uint64_t upper_epochs_arr[num_process];
         uint64_t lower_epochs_arr[num_process];
@@ -463,9 +440,10 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
 
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
     /**
      * To escape asserts at record manager assert(!supportcrash || isQuiescent())
     */
@@ -494,7 +472,6 @@ public:
         VERBOSE std::cout << "constructor reclaimer_popplus2geibr helping=" << this->shouldHelp() << std::endl;
         num_process = numProcesses;
         freq = MAX_RETIREBAG_CAPACITY_POW2; //16384; //32000; //30; //on lines with nbr
-        epoch_freq = 100; // if high then high mem usage
 
         retired = new padded<std::list<IntervalInfo>>[num_process];
         upper_reservs = new paddedAtomic<uint64_t>[num_process];
@@ -506,7 +483,7 @@ public:
         }
         // retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, freq);
         publishing_epoch.store(0);
 
     #ifdef DEAMORTIZE_FREE_CALLS
@@ -534,7 +511,7 @@ public:
         delete [] lower_reservs;
         // delete [] retire_counters;
         delete [] alloc_counters;
-		COUTATOMIC("epoch_freq= " << epoch_freq << "empty_freq= " << freq <<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() << "empty_freq= " << freq <<std::endl);
     }
 };
 
@@ -13,6 +13,7 @@
 #include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
 
 // #if !defined HE_ORIGINAL_FREE || !HE_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -24,7 +25,6 @@ class reclaimer_rcu_pop : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     // PAD; 
     
     class ThreadData
@@ -71,43 +71,18 @@ private:
     // padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
 
-    std::atomic<uint64_t> epoch; 
+    EpochClock epoch;
     PAD;
 
     inline bool requestAllThreadsToRestart(const int tid)
     {
         bool result = false;
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        // deliver pings according to the strategy selected in ping_delivery.h
+        if (!this->recoveryMgr->pingDelivery->pingAll(tid))
         {
-            if (tid != otherTid)
-            {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-                int error = 0;
-                //send signal to other thread
-                // COUTATOMICTID("DEBUG_TID_MAP::"
-                //                     << " tid=" << tid << " with pid=" << pthread_self() << " registeredThreads[" << tid << "]=" << registeredThreads[tid] << " sending sig to tid= " << otherTid << " with pid=" << otherPthread << " registeredThreads[" << otherTid << "]=" << registeredThreads[otherTid] << std::endl);
-
-                // FIXME: I Don't know, should signal be UNblocked after a thread executes a sigandler. So that it could receive sig again?
-                error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-                if (error)
-                {
-                    COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                    if (error == ESRCH)
-                        COUTATOMICTID("ESRCH" << std::endl);
-                    if (error == EINVAL)
-                        COUTATOMICTID("EINVAL" << std::endl);
-
-                    assert("Error when trying to pthread_kill" && 0);
-                    return result;
-                }
-                // else
-                // {
-                //     COUTATOMICTID(" Signal sent via pthread_kill(pthread_tFor(" << otherTid << "  " << otherPthread << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                // }
-            } // if (tid != otherTid){
-        }     // for()
+            return result;
+        }
 
     #ifdef USE_GSTATS
         GSTATS_ADD(tid, signalall, 1);
@@ -165,9 +140,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -181,8 +153,9 @@ public:
         assert(obj && "object to be retired in NULL");
 
         std::list<RCUPOPInfo> *myTrash = &(retired[tid].ui);
-        uint64_t retire_epoch = getEpoch();
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(RCUPOPInfo(obj, retire_epoch));
+        epoch.onRetire(tid);
         size_t myTrashSize = myTrash->size();
 
 
@@ -193,7 +166,7 @@ public:
         // (++(threadData[tid].num_sigallattempts_since_last_attempt) > 10 ) ==> this condition helps to avoid costly try signalling and empty ops right after previous reclamation attempt where none of retired objects were eligible due to all retired in epoch grater than minimum reserved epoch. So this thread shall wait for a few ops so that mimimum reserved epoch publishd can get higher than the retire epochs of retired objects in limboBag.
         // OPTIMIZATION1
         // WARNING: this lets max trash size to exceed the bag threshold capacity
-        for (int i = 0; i < num_process; i++){
+        FOR_EACH_LIVE_TID(i, this->liveThreads){
             threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
         }
 
@@ -215,7 +188,7 @@ public:
                 // if (0 == tid) COUTATOMICTID("bagCapacityThreshold exceeded, trash size=" <<myTrash->size() << " num_sigallattempts_since_last_attempt"<<threadData[tid].num_sigallattempts_since_last_attempt<< std::endl);
 
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -239,8 +212,9 @@ public:
 
     void empty(const int tid)
     {
+        RECLAMATION_EVENT;
         uint64_t min_reserved_epoch = UINT64_MAX;
-        for (int i = 0; i < num_process; i++)
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             uint64_t res = reservations[i].ui.load(std::memory_order_acquire);
             if (res < min_reserved_epoch)
@@ -337,10 +311,11 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
     
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
 
     /**
@@ -368,7 +343,6 @@ public:
         VERBOSE std::cout << "constructor reclaimer_rcu_pop helping=" << this->shouldHelp() << std::endl;
         num_process = numProcesses;
         freq = 32768; //16384; //32768; //30; //retire freq
-        epoch_freq = 150;
 
         if (_recoveryMgr)
             COUTATOMIC("SIGRTMIN=" << SIGRTMIN << " neutralizeSignal=" << this->recoveryMgr->neutralizeSignal << std::endl);
@@ -383,7 +357,7 @@ public:
         }
         // retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, freq);
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif        
@@ -403,7 +377,7 @@ public:
             // COUTATOMIC("reservations=" << reservations[i].ui.load() << " ");
             // delete [] reservations[i].ui;
         }
-		COUTATOMIC("epoch_freq= " << epoch_freq <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl);
 
         delete [] retired;
         // delete [] reservations;
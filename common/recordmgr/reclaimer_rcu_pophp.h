@@ -13,6 +13,10 @@
 #include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "hashtable.h"
+#include "reservation_slots.h"
+#include "scan_reservations.h"
 
 // #if !defined HP_ORIGINAL_FREE || !HP_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -34,10 +38,10 @@ public:
 private:
     int num_process;
     int empty_freq;
-    int epoch_freq; //RCU
     int slotsPerThread;
     // PAD;
-    paddedAtomic<T*> *slots;
+    ReservationSlots<T*> *slots; // slotsPerThread slots per thread, one cache line per thread
+    ScanHazardPointers<T> scanPtrs; // range queries' reservations (see scan_reservations.h)
     // padded<int> *cntrs;
     // padded<std::list<T*>> *retired;
     // PAD;
@@ -47,7 +51,7 @@ private:
     padded<std::list<RCUInfo>> *retired;
     padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
-    std::atomic<uint64_t> epoch; //FIXME: pad?
+    EpochClock epoch;
 
     class ThreadData
     {
@@ -62,6 +66,9 @@ private:
     unsigned int bagCapacityThreshold; // using this variable to set random thresholds for out of patience.
     int num_sigallattempts_since_last_attempt;
     T* local_slots[NUM_POPHP];
+    hashset_new<T> *scannedHzptrs; // snapshot of all slots taken once per hp_empty()
+    T** scannedSlots; // copy of the slots of live threads, filled by slots->snapshot() once per empty()
+    std::vector<T*> scannedScanPtrs; // records reserved by range queries, filled by scanPtrs.snapshot() once per empty()
 
     //variables confirming publishing
     PAD;
@@ -86,28 +93,11 @@ inline bool requestAllThreadsToRestart(const int tid)
 #ifdef USE_GSTATS
     GSTATS_ADD(tid, signalall, 1);
 #endif        
-    for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+    // deliver pings according to the strategy selected in ping_delivery.h
+    if (!this->recoveryMgr->pingDelivery->pingAll(tid))
     {
-        if (tid != otherTid)
-        {
-            //get posix thread id from application level thread id.
-            pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-            int error = 0;
-
-            error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-            if (error)
-            {
-                COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                if (error == ESRCH)
-                    COUTATOMICTID("ESRCH" << std::endl);
-                if (error == EINVAL)
-                    COUTATOMICTID("EINVAL" << std::endl);
-
-                assert("Error when trying to pthread_kill" && 0);
-                return result;
-            }
-        }
-    }     // for()
+        return result;
+    }
 
 
 
@@ -155,7 +145,7 @@ public:
     inline void endOp(const int tid)
     {
         for(int i = 0; i<slotsPerThread; i++){
-			// slots[tid*slotsPerThread+i] = NULL;
+			// slots->at(tid, i) = NULL;
             // saving slotsPerThread global writes here
             threadData[tid].local_slots[i] = NULL;
 		}
@@ -165,9 +155,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -191,15 +178,16 @@ public:
     }
 
     inline void reserve(T* ptr, int slot, int tid){
-		// slots[tid*slotsPerThread+slot] = ptr;
+		// slots->at(tid, slot) = ptr;
         // saving per read global write here. But not saving anything here as other threads only read it during retire...
         threadData[tid].local_slots[slot] = ptr;
 	}
 
     uint rcu_empty(const int tid)
     {
+        RECLAMATION_EVENT;
         uint64_t minEpoch = UINT64_MAX;
-        for (int i = 0; i < num_process; i++)
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             uint64_t res = reservations[i].ui.load(std::memory_order_acquire);
             if (res < minEpoch)
@@ -237,6 +225,17 @@ public:
         return after_sz;
     }
 
+    // a range query reserves every record it reads (through readScan) until endScan, in addition to its slots
+    inline void startScan(const int tid, const int maxReads) {
+        scanPtrs.start(tid, maxReads);
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanPtrs.read(tid, obj);
+    }
+    inline void endScan(const int tid) {
+        scanPtrs.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -247,9 +246,10 @@ public:
 
         std::list<RCUInfo> *myTrash = &(retired[tid].ui);
 
-        uint64_t e = epoch.load(std::memory_order_acquire);
+        uint64_t e = epoch.retireEpoch();
         RCUInfo info = RCUInfo(obj, e);
         myTrash->push_back(info);
+        epoch.onRetire(tid);
         retire_counters[tid] = retire_counters[tid] + 1;
 
         if (retire_counters[tid] % empty_freq == 0)
@@ -264,7 +264,7 @@ public:
             {
 
                 // scan all publishingTS to establish later that reservations were published after ping or signal
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
                 }
 
@@ -272,7 +272,7 @@ public:
                 {
                     // confirm that all reservations were published after ping
                     int assert_count = 0;
-                    for (int i = 0; i < num_process; i++){
+                    FOR_EACH_LIVE_TID(i, this->liveThreads){
                         if (tid != i)
                         {
                             if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -298,23 +298,35 @@ public:
 
     }
 
+    /**
+     * Snapshots all slots once into a hashset so that hp_empty() checks each retired record in O(1) expected time
+     * instead of scanning all num_process*slotsPerThread slots per record.
+    */
+    inline void collectAllSavedRecords(const int tid)
+    {
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        scanned->clear();
+        T** const snapshot = threadData[tid].scannedSlots;
+        const int n = slots->snapshot(this->liveThreads, snapshot);
+        for (int i = 0; i<n; i++){
+            if (snapshot[i]) scanned->insert(snapshot[i]);
+        }
+        scanPtrs.snapshot(this->liveThreads, threadData[tid].scannedScanPtrs);
+    }
+
     void hp_empty(const int tid)
     {
+		RECLAMATION_EVENT;
 		std::list<RCUInfo>* myTrash = &(retired[tid].ui);
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        collectAllSavedRecords(tid);
         uint before_sz = myTrash->size();       
 
 		for (auto iterator = myTrash->begin(), end = myTrash->end(); iterator != end; ) 
         {
-			bool danger = false;
-			
             RCUInfo res = *iterator;
             auto ptr = res.obj;
-			for (int i = 0; i<num_process*slotsPerThread; i++){
-				if(ptr == slots[i].ui){
-					danger = true;
-					break;
-				}
-			}
+			bool danger = (scanned->contains(ptr) || ScanHazardPointers<T>::contains(threadData[tid].scannedScanPtrs, ptr));
 			if(!danger){
 				// this->reclaim(ptr);
                 // this->pool->add(tid, ptr);
@@ -346,6 +358,10 @@ public:
         threadData[tid].numFreesPerStartOp = 1;
 #endif
         threadData[tid].bagCapacityThreshold = empty_freq;
+        if (threadData[tid].scannedHzptrs == NULL) {
+            threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * slotsPerThread);
+            threadData[tid].scannedSlots = new T*[num_process * slotsPerThread];
+        }
         for (int j = 0; j < NUM_POPHP; j++)
         {
             threadData[tid].local_slots[j] = NULL;
@@ -371,10 +387,10 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
 
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
     /**
      * To escape asserts at record manager assert(!supportcrash || isQuiescent())
@@ -390,7 +406,7 @@ public:
     {
         
         for(int i = 0; i<slotsPerThread; i++){
-			slots[tid*slotsPerThread+i] = threadData[tid].local_slots[i];
+			slots->at(tid, i) = threadData[tid].local_slots[i];
 		}
         // std::atomic_fetch_add(&threadData[tid].mypublishingTS, 1); //tell other threads that I commpleted publishing.        
         threadData[tid].mypublishingTS.fetch_add(1, std::memory_order_acq_rel);
@@ -404,13 +420,8 @@ public:
         num_process = numProcesses;
         empty_freq = 24576; //MAX_RETIREBAG_CAPACITY_POW2; //16384;//100; //30; // 32K gives best gains for AF version. larger or lower doesn't make a much difference.
         slotsPerThread = NUM_POPHP; //3;
-        epoch_freq = 150; //150;   //this was default values ion IBR microbench
 
-        slots = new paddedAtomic< T* >[num_process * slotsPerThread];
-        for (int i = 0; i < num_process * slotsPerThread; i++)
-        {
-            slots[i] = NULL;
-        }
+        slots = new ReservationSlots<T*>(num_process, slotsPerThread, NULL);
 
         retired = new padded<std::list<RCUInfo>>[num_process];
         // cntrs = new padded<int>[num_process];
@@ -422,8 +433,10 @@ public:
         {
             reservations[i].ui.store(UINT64_MAX, std::memory_order_release);
             retired[i].ui.clear();
+            threadData[i].scannedHzptrs = NULL;
+            threadData[i].scannedSlots = NULL;
         }
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, empty_freq);
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif                
@@ -440,16 +453,17 @@ public:
                 iterator=retired[i].ui.erase(iterator); //return iterator corresponding to next of last erased item
                 this->pool->add(i, res.obj); //reclaim
             }
-
+            delete threadData[i].scannedHzptrs;
+            delete [] threadData[i].scannedSlots;
         }
 
         delete [] retired;
         delete [] reservations;
         delete [] retire_counters;
         delete [] alloc_counters;
-        delete [] slots;
+        delete slots;
 
-		COUTATOMIC("epoch_freq= " << epoch_freq << "empty_freq= " << empty_freq <<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() << "empty_freq= " << empty_freq <<std::endl);
     }
 };
 
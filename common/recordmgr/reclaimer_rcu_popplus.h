@@ -19,6 +19,8 @@
 #include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "reclaim_controller.h"
 
 // #if !defined HE_ORIGINAL_FREE || !HE_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -30,7 +32,6 @@ class reclaimer_rcu_popplus : public reclaimer_interface<T, Pool>
 private:
     int num_process;
     int freq;
-    int epoch_freq;
     // PAD;
     static const int MAX_RETIREBAG_CAPACITY_POW2 = 32768; //16384; //32768; //16384; //32768; //4096; //8192;//16384;//32768;          //16384;
     static const int NUM_OP_BEFORE_TRYRECLAIM_LOWATERMARK = 1024; //512; //
@@ -84,12 +85,13 @@ private:
 
     // padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
+    ReclaimController controller; // tunes each thread's bagCapacityThreshold
     padded<std::list<RCUPOPInfo>> *retired;
 
     // PAD;
     std::atomic<uint64_t> publishing_epoch; 
     PAD;    
-    std::atomic<uint64_t> epoch; 
+    EpochClock epoch;
     PAD;
 
     inline bool requestAllThreadsToRestart(const int tid)
@@ -99,36 +101,11 @@ private:
         //Theorem: The signalling thread should also publish it's epochs so that other threads in LoWm could reclaim correctly.
         publishReservations(tid);        
 
-        for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+        // deliver pings according to the strategy selected in ping_delivery.h
+        if (!this->recoveryMgr->pingDelivery->pingAll(tid))
         {
-            if (tid != otherTid)
-            {
-                //get posix thread id from application level thread id.
-                pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-                int error = 0;
-                //send signal to other thread
-                // COUTATOMICTID("DEBUG_TID_MAP::"
-                //                     << " tid=" << tid << " with pid=" << pthread_self() << " registeredThreads[" << tid << "]=" << registeredThreads[tid] << " sending sig to tid= " << otherTid << " with pid=" << otherPthread << " registeredThreads[" << otherTid << "]=" << registeredThreads[otherTid] << std::endl);
-
-                // FIXME: I Don't know, should signal be UNblocked after a thread executes a sigandler. So that it could receive sig again?
-                error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-                if (error)
-                {
-                    COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                    if (error == ESRCH)
-                        COUTATOMICTID("ESRCH" << std::endl);
-                    if (error == EINVAL)
-                        COUTATOMICTID("EINVAL" << std::endl);
-
-                    assert("Error when trying to pthread_kill" && 0);
-                    return result;
-                }
-                // else
-                // {
-                //     COUTATOMICTID(" Signal sent via pthread_kill(pthread_tFor(" << otherTid << "  " << otherPthread << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                // }
-            } // if (tid != otherTid){
-        }     // for()
+            return result;
+        }
 
         // increment the publishing epoch so that LoWm threads could reclaim.
         //FIXME: using a global atomic var seems slow? Shoudl use lamport clock like original NBR+?
@@ -187,9 +164,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -203,8 +177,7 @@ public:
 
         // approach3: 1, 5, 10, 15....50%
         // setLoWmTryReclaimFrequency();
-        int rand_val = (rand()%11);
-        threadData[tid].LoPathReclaimAttemptFreq = (rand_val==0)? (0.1*MAX_RETIREBAG_CAPACITY_POW2) : (unsigned int)((((rand_val*5))/100.0 )*MAX_RETIREBAG_CAPACITY_POW2);
+        threadData[tid].LoPathReclaimAttemptFreq = controller.nextLoAttemptFreq(tid, 0.1);
 
         // threadData[tid].LoPathReclaimAttemptFreq = 100; //30;
     }
@@ -240,9 +213,11 @@ public:
         assert(obj && "object to be retired in NULL");
 
         std::list<RCUPOPInfo> *myTrash = &(retired[tid].ui);
-        uint64_t retire_epoch = getEpoch();
+        uint64_t retire_epoch = epoch.retireEpoch();
         myTrash->push_back(RCUPOPInfo(obj, retire_epoch));
+        epoch.onRetire(tid);
         size_t myTrashSize = myTrash->size();
+        controller.onRetire(tid, myTrashSize);
 
         // retire_counters[tid] = retire_counters[tid] + 1;
 
@@ -254,15 +229,17 @@ public:
 
             // if bagthreshold has been crossed then ping all threads to publish there reservations. If 0 or a very few records were reclaimed then bag will get full earlier the next time and signal overhead will be incurred. To avoid this ie the frequent signalling overhead we should only attenmpt signalling once atleast half of max size more have been retired ad hope that this time published reserved epochs let us reclaim mor objects. This trades high mem consumption with low sigoverhead. 
             // signall all threads so that they can publish their reserved epochs.
-            for (int i = 0; i < num_process; i++){
+            FOR_EACH_LIVE_TID(i, this->liveThreads){
                 threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
             }
 
+            controller.beginSignal(tid);
             if (requestAllThreadsToRestart(tid))
             {   
+                controller.endSignal(tid);
                 // ensure all threads published.
                 int assert_count = 0;
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     if (tid != i)
                     {
                         if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -274,6 +251,7 @@ public:
                 }
 
                 bool empty_result = empty(tid);
+                threadData[tid].bagCapacityThreshold = controller.onHiWmReclaim(tid, myTrashSize, myTrash->size());
                 #ifdef USE_GSTATS
                     GSTATS_APPEND(tid, reclamation_event_size, myTrashSize);
                 #endif
@@ -314,6 +292,7 @@ public:
                     GSTATS_APPEND(tid, lo_reclamation_event_size, myTrashSize);
                 #endif
                 empty(tid);
+                controller.onLoWmReclaim(tid, myTrashSize, myTrash->size());
 
                 resetLoWmMetaData(tid);
                 // thread exits LoWm path
@@ -335,7 +314,7 @@ public:
     {
         uint64_t min_reserved_epoch = UINT64_MAX;
         int mintid = 0;
-        for (int i = 0; i < num_process; i++)
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             uint64_t res = reservations[i].ui.load(std::memory_order_acquire);
             if (res < min_reserved_epoch)
@@ -417,7 +396,8 @@ public:
         // }
         // else
         {
-            threadData[tid].bagCapacityThreshold = MAX_RETIREBAG_CAPACITY_POW2;
+            controller.initThread(tid);
+            threadData[tid].bagCapacityThreshold = controller.hiWm(tid);
         }
 
         threadData[tid].reserved_epoch = UINT64_MAX; // an epoch which cannt overlap with birth and retire epoch of nodes.
@@ -445,10 +425,11 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool needsFenceAfterStartOp() { return false; }
     
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
 
     /**
@@ -477,7 +458,6 @@ public:
         VERBOSE std::cout << "constructor reclaimer_rcu_popplus helping=" << this->shouldHelp() << std::endl;
         num_process = numProcesses;
         freq = MAX_RETIREBAG_CAPACITY_POW2; //16384; //32768; //30;
-        epoch_freq = 50;
 
         if (_recoveryMgr)
             COUTATOMIC("SIGRTMIN=" << SIGRTMIN << " neutralizeSignal=" << this->recoveryMgr->neutralizeSignal << std::endl);
@@ -492,12 +472,12 @@ public:
         }
         // retire_counters = new padded<uint64_t>[num_process];
         alloc_counters = new padded<uint64_t>[num_process];
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, freq);
         publishing_epoch.store(0, std::memory_order_release);
+        controller.init(num_process, MAX_RETIREBAG_CAPACITY_POW2, sizeof(T));
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif   
-     srand (time(NULL));     
     }
     ~reclaimer_rcu_popplus()
     {
@@ -514,7 +494,7 @@ public:
             // COUTATOMIC("reservations=" << reservations[i].ui.load() << " ");
             // delete [] reservations[i].ui;
         }
-		COUTATOMIC("epoch_freq= " << epoch_freq <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() <<std::endl<< "empty_freq= " << freq <<std::endl<< "epoch= " <<getEpoch()<<std::endl<< "avg_hiwm= " << controller.averageHiWm() <<std::endl);
 
         delete [] retired;
         // delete [] reservations;
@@ -13,6 +13,11 @@
 #include <list>
 #include "ConcurrentPrimitives.h"
 #include "blockbag.h"
+#include "epoch_clock.h"
+#include "hashtable.h"
+#include "reservation_slots.h"
+#include "scan_reservations.h"
+#include "reclaim_controller.h"
 
 // #if !defined HP_ORIGINAL_FREE || !HP_ORIGINAL_FREE
 //     #define DEAMORTIZE_FREE_CALLS
@@ -34,10 +39,10 @@ public:
 private:
     int num_process;
     int empty_freq;
-    int epoch_freq; //RCU
     int slotsPerThread;
     // PAD;
-    paddedAtomic<T*> *slots;
+    ReservationSlots<T*> *slots; // slotsPerThread slots per thread, one cache line per thread
+    ScanHazardPointers<T> scanPtrs; // range queries' reservations (see scan_reservations.h)
     // padded<int> *cntrs;
     // padded<std::list<T*>> *retired;
     // PAD;
@@ -47,7 +52,8 @@ private:
     padded<std::list<RCUInfo>> *retired;
     padded<uint64_t> *retire_counters;
     padded<uint64_t> *alloc_counters;
-    std::atomic<uint64_t> epoch; //FIXME: pad?
+    ReclaimController controller; // tunes each thread's bagCapacityThreshold
+    EpochClock epoch;
 
     class ThreadData
     {
@@ -62,6 +68,9 @@ private:
     unsigned int bagCapacityThreshold; // using this variable to set random thresholds for out of patience.
     int num_sigallattempts_since_last_attempt;
     T* local_slots[NUM_POPHP];
+    hashset_new<T> *scannedHzptrs; // snapshot of all slots taken once per hp_empty()
+    T** scannedSlots; // copy of the slots of live threads, filled by slots->snapshot() once per empty()
+    std::vector<T*> scannedScanPtrs; // records reserved by range queries, filled by scanPtrs.snapshot() once per empty()
 
     //BEGIN OPTIMIZED_SIGNAL: LoWatermark variables
     PAD;
@@ -101,28 +110,11 @@ inline bool requestAllThreadsToRestart(const int tid)
 #ifdef USE_GSTATS
     GSTATS_ADD(tid, signalall, 1);
 #endif        
-    for (int otherTid = 0; otherTid < this->NUM_PROCESSES; ++otherTid)
+    // deliver pings according to the strategy selected in ping_delivery.h
+    if (!this->recoveryMgr->pingDelivery->pingAll(tid))
     {
-        if (tid != otherTid)
-        {
-            //get posix thread id from application level thread id.
-            pthread_t otherPthread = this->recoveryMgr->getPthread(otherTid);
-            int error = 0;
-
-            error = pthread_kill(otherPthread, this->recoveryMgr->neutralizeSignal);
-            if (error)
-            {
-                COUTATOMICTID("Error when trying to pthread_kill(pthread_tFor(" << otherTid << "), " << this->recoveryMgr->neutralizeSignal << ")" << std::endl);
-                if (error == ESRCH)
-                    COUTATOMICTID("ESRCH" << std::endl);
-                if (error == EINVAL)
-                    COUTATOMICTID("EINVAL" << std::endl);
-
-                assert("Error when trying to pthread_kill" && 0);
-                return result;
-            }
-        }
-    }     // for()
+        return result;
+    }
 
 
 
@@ -170,9 +162,13 @@ public:
     inline void endOp(const int tid)
     {
         for(int i = 0; i<slotsPerThread; i++){
-			// slots[tid*slotsPerThread+i] = NULL;
+        #ifdef POP_PUBLISH_MEMBARRIER
+            slots->at(tid, i).store(NULL, std::memory_order_relaxed);
+        #else
+			// slots->at(tid, i) = NULL;
             // saving slotsPerThread global writes here
             threadData[tid].local_slots[i] = NULL;
+        #endif
 		}
         reservations[tid].ui.store(UINT64_MAX, std::memory_order_release/*ajreb std::memory_order_seq_cst */);
     }
@@ -182,8 +178,7 @@ public:
         threadData[tid].firstLoEntryFlag = false;
 
         // approach3: 1, 5, 10, 15....50%
-        int rand_val = (rand()%11);
-        threadData[tid].LoPathReclaimAttemptFreq = (rand_val==0)? (0.01*MAX_RETIREBAG_CAPACITY_POW2) : (unsigned int)((((rand_val*5))/100.0 )*MAX_RETIREBAG_CAPACITY_POW2);
+        threadData[tid].LoPathReclaimAttemptFreq = controller.nextLoAttemptFreq(tid, 0.01);
 
         // threadData[tid].LoPathReclaimAttemptFreq = 50; //30;
 
@@ -216,9 +211,6 @@ public:
     inline void updateAllocCounterAndEpoch(const int tid)
     {
 		alloc_counters[tid]=alloc_counters[tid]+1;
-		if(alloc_counters[tid]%(epoch_freq*num_process)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
     }
 
     inline uint64_t getEpoch()
@@ -242,15 +234,23 @@ public:
     }
 
     inline void reserve(T* ptr, int slot, int tid){
-		// slots[tid*slotsPerThread+slot] = ptr;
+    #ifdef POP_PUBLISH_MEMBARRIER
+        // reserve directly in the shared slot; the reclaimer's membarrier makes it visible.
+        // compiler barrier keeps this store before read()'s validating load.
+        slots->at(tid, slot).store(ptr, std::memory_order_relaxed);
+        asm volatile ("" : : : "memory");
+    #else
+		// slots->at(tid, slot) = ptr;
         // saving per read global write here. But not saving anything here as other threads only read it during retire...
         threadData[tid].local_slots[slot] = ptr;
+    #endif
 	}
 
     uint rcu_empty(const int tid)
     {
+        RECLAMATION_EVENT;
         uint64_t minEpoch = UINT64_MAX;
-        for (int i = 0; i < num_process; i++)
+        FOR_EACH_LIVE_TID(i, this->liveThreads)
         {
             uint64_t res = reservations[i].ui.load(std::memory_order_acquire);
             if (res < minEpoch)
@@ -288,6 +288,17 @@ public:
         return after_sz;
     }
 
+    // a range query reserves every record it reads (through readScan) until endScan, in addition to its slots
+    inline void startScan(const int tid, const int maxReads) {
+        scanPtrs.start(tid, maxReads);
+    }
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return scanPtrs.read(tid, obj);
+    }
+    inline void endScan(const int tid) {
+        scanPtrs.end(tid);
+    }
+
     // for all schemes except reference counting
     inline void retire(const int tid, T *obj)
     {
@@ -298,12 +309,14 @@ public:
 
         std::list<RCUInfo> *myTrash = &(retired[tid].ui);
 
-        uint64_t e = epoch.load(std::memory_order_acquire);
+        uint64_t e = epoch.retireEpoch();
         RCUInfo info = RCUInfo(obj, e);
         myTrash->push_back(info);
+        epoch.onRetire(tid);
         retire_counters[tid] = retire_counters[tid] + 1;
 
         size_t myTrashSize = myTrash->size();
+        controller.onRetire(tid, myTrashSize);
         size_t myTrashSizeAfterLoWmRec = myTrashSize;
         //if entered loWm
         if(isPastLoWatermark(tid, myTrashSize)){
@@ -315,7 +328,7 @@ public:
                 threadData[tid].retire_bag_size_when_entered_loWm = myTrashSize;
             }
 
-            for (int i = 0; i < num_process; i++)
+            FOR_EACH_LIVE_TID(i, this->liveThreads)
             {   //TODO: skip self comparison.
                 if( threadData[i].announcedTS >= threadData[tid].savedTS[i] + 2)
                 {
@@ -327,6 +340,7 @@ public:
                     // #endif
                     hp_LoWmempty(tid);
                     myTrashSizeAfterLoWmRec = myTrash->size();
+                    controller.onLoWmReclaim(tid, myTrashSize, myTrashSizeAfterLoWmRec);
 
                     resetLoWmMetaData(tid);
                     break;
@@ -335,7 +349,8 @@ public:
             }            
         }    //end loWm    
         
-        if (myTrashSizeAfterLoWmRec >= empty_freq) //ou of patience
+        const unsigned int hiWm = threadData[tid].bagCapacityThreshold;
+        if (myTrashSizeAfterLoWmRec >= hiWm) //ou of patience
         {
             uint after_sz = rcu_empty(tid);
 // #ifdef GSTATS_HANDLE_STATS
@@ -343,21 +358,23 @@ public:
 // #endif
 
             // If bag is still twice the size implies some thread is delayed and time to force reclamation using pop HPs.
-            if (after_sz >= /* 2* */(empty_freq - 4096)) //was div 2
+            if (after_sz >= /* 2* */(hiWm - hiWm/6)) //was div 2
             {
 
                 // scan all publishingTS to establish later that reservations were published after ping or signal
-                for (int i = 0; i < num_process; i++){
+                FOR_EACH_LIVE_TID(i, this->liveThreads){
                     threadData[tid].myscannedTS[i] = threadData[i].mypublishingTS.load(std::memory_order_acquire);
                 }
     
                 std::atomic_fetch_add(&threadData[tid].announcedTS, 1); //tell other threads that I am starting signalling.
 
+                controller.beginSignal(tid);
                 if (requestAllThreadsToRestart(tid))
                 {
+                    controller.endSignal(tid);
                     // confirm that all reservations were published after ping
                     int assert_count = 0;
-                    for (int i = 0; i < num_process; i++){
+                    FOR_EACH_LIVE_TID(i, this->liveThreads){
                         if (tid != i)
                         {
                             if (threadData[tid].myscannedTS[i] == threadData[i].mypublishingTS.load(std::memory_order_acquire)) 
@@ -370,8 +387,13 @@ public:
                     std::atomic_fetch_add(&threadData[tid].announcedTS, 1); //tell other threads that I am done signalling
 
                     hp_empty(tid);
+                    threadData[tid].bagCapacityThreshold = controller.onHiWmReclaim(tid, after_sz, myTrash->size());
                 }
             } //if(myTrash->size() >= 2*empty_freq) HP_empty
+            else
+            {
+                controller.onLoWmReclaim(tid, myTrashSizeAfterLoWmRec, after_sz);
+            }
 
             resetLoWmMetaData(tid);
         } //rcu_empty
@@ -389,23 +411,35 @@ public:
 
     }
 
+    /**
+     * Snapshots all slots once into a hashset so that hp_empty() checks each retired record in O(1) expected time
+     * instead of scanning all num_process*slotsPerThread slots per record.
+    */
+    inline void collectAllSavedRecords(const int tid)
+    {
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        scanned->clear();
+        T** const snapshot = threadData[tid].scannedSlots;
+        const int n = slots->snapshot(this->liveThreads, snapshot);
+        for (int i = 0; i<n; i++){
+            if (snapshot[i]) scanned->insert(snapshot[i]);
+        }
+        scanPtrs.snapshot(this->liveThreads, threadData[tid].scannedScanPtrs);
+    }
+
     void hp_empty(const int tid)
     {
+		RECLAMATION_EVENT;
 		std::list<RCUInfo>* myTrash = &(retired[tid].ui);
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        collectAllSavedRecords(tid);
         uint before_sz = myTrash->size();       
 
 		for (auto iterator = myTrash->begin(), end = myTrash->end(); iterator != end; ) 
         {
-			bool danger = false;
-			
             RCUInfo res = *iterator;
             auto ptr = res.obj;
-			for (int i = 0; i<num_process*slotsPerThread; i++){
-				if(ptr == slots[i].ui){
-					danger = true;
-					break;
-				}
-			}
+			bool danger = (scanned->contains(ptr) || ScanHazardPointers<T>::contains(threadData[tid].scannedScanPtrs, ptr));
 			if(!danger){
 				// this->reclaim(ptr);
                 // this->pool->add(tid, ptr);
@@ -428,7 +462,10 @@ public:
 
     void hp_LoWmempty(const int tid)
     {
+		RECLAMATION_EVENT;
 		std::list<RCUInfo>* myTrash = &(retired[tid].ui);
+        hashset_new<T> *const scanned = threadData[tid].scannedHzptrs;
+        collectAllSavedRecords(tid);
         uint before_sz = myTrash->size(); 
         uint indx = 0;      
 
@@ -441,16 +478,9 @@ public:
                 break;
             }
             indx++;
-			bool danger = false;
-			
             RCUInfo res = *iterator;
             auto ptr = res.obj;
-			for (int i = 0; i<num_process*slotsPerThread; i++){
-				if(ptr == slots[i].ui){
-					danger = true;
-					break;
-				}
-			}
+			bool danger = (scanned->contains(ptr) || ScanHazardPointers<T>::contains(threadData[tid].scannedScanPtrs, ptr));
 			if(!danger){
 				// this->reclaim(ptr);
                 // this->pool->add(tid, ptr);
@@ -482,7 +512,12 @@ public:
         threadData[tid].deamortizedFreeables = new blockbag<T>(tid, this->pool->blockpools[tid]);
         threadData[tid].numFreesPerStartOp = 1;
 #endif
-        threadData[tid].bagCapacityThreshold = empty_freq;
+        controller.initThread(tid, empty_freq);
+        threadData[tid].bagCapacityThreshold = controller.hiWm(tid);
+        if (threadData[tid].scannedHzptrs == NULL) {
+            threadData[tid].scannedHzptrs = new hashset_new<T>(num_process * slotsPerThread);
+            threadData[tid].scannedSlots = new T*[num_process * slotsPerThread];
+        }
         for (int j = 0; j < NUM_POPHP; j++)
         {
             threadData[tid].local_slots[j] = NULL;
@@ -518,10 +553,10 @@ public:
 
     inline static bool qProtect(const int tid, T *const obj, CallbackType notRetiredCallback, CallbackArg callbackArg, bool memoryBarrier = true) { return true; }
     inline static void qUnprotectAll(const int tid) {}
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
 
     // this helps in populating tid mapping for signal handling. This function is reused from the Debra+
-    inline static bool needsSetJmp() { return true; }
+    static constexpr bool needsSetJmp() { return true; }
 
     /**
      * To escape asserts at record manager assert(!supportcrash || isQuiescent())
@@ -536,9 +571,11 @@ public:
     inline void publishReservations(const int tid)
     {
         
+    #ifndef POP_PUBLISH_MEMBARRIER // otherwise reservations are always in the shared slots
         for(int i = 0; i<slotsPerThread; i++){
-			slots[tid*slotsPerThread+i] = threadData[tid].local_slots[i];
+			slots->at(tid, i) = threadData[tid].local_slots[i];
 		}
+    #endif
         // std::atomic_fetch_add(&threadData[tid].mypublishingTS, 1); //tell other threads that I commpleted publishing.        
         threadData[tid].mypublishingTS.fetch_add(1, std::memory_order_acq_rel);
         return;
@@ -556,13 +593,8 @@ public:
         empty_freq = MAX_RETIREBAG_CAPACITY_POW2; //16384; //32000; //30; //on lines with nbr
 #endif
         slotsPerThread = NUM_POPHP; //3;
-        epoch_freq = 150; //150;   //this was default values ion IBR microbench
 
-        slots = new paddedAtomic< T* >[num_process * slotsPerThread];
-        for (int i = 0; i < num_process * slotsPerThread; i++)
-        {
-            slots[i] = NULL;
-        }
+        slots = new ReservationSlots<T*>(num_process, slotsPerThread, NULL);
 
         retired = new padded<std::list<RCUInfo>>[num_process];
         // cntrs = new padded<int>[num_process];
@@ -574,8 +606,11 @@ public:
         {
             reservations[i].ui.store(UINT64_MAX, std::memory_order_release);
             retired[i].ui.clear();
+            threadData[i].scannedHzptrs = NULL;
+            threadData[i].scannedSlots = NULL;
         }
-        epoch.store(0, std::memory_order_release);
+        epoch.init(num_process, 0, empty_freq);
+        controller.init(num_process, empty_freq, sizeof(T));
     #ifdef DEAMORTIZE_FREE_CALLS
         threadData[tid].deamortizedFreeables = NULL;
     #endif                
@@ -592,17 +627,24 @@ public:
                 iterator=retired[i].ui.erase(iterator); //return iterator corresponding to next of last erased item
                 this->pool->add(i, res.obj); //reclaim
             }
-
+            delete threadData[i].scannedHzptrs;
+            delete [] threadData[i].scannedSlots;
         }
 
         delete [] retired;
         delete [] reservations;
         delete [] retire_counters;
         delete [] alloc_counters;
-        delete [] slots;
+        delete slots;
 
-		COUTATOMIC("epoch_freq= " << epoch_freq << "empty_freq= " << empty_freq <<std::endl);
+		COUTATOMIC("retires_per_epoch= " << epoch.getRetiresPerAdvance() << "empty_freq= " << empty_freq << " avg_hiwm= " << controller.averageHiWm() <<std::endl);
     }
 };
 
+#ifdef POP_PUBLISH_MEMBARRIER
+// rcu_popplushp with the membarrier publish backend (see ping_delivery.h), named separately so experiments can compare both
+template <typename T = void, class Pool = pool_interface<T>>
+using reclaimer_rcu_popplushp_mb = reclaimer_rcu_popplushp<T, Pool>;
+#endif
+
 #endif //RECLAIM_RCU_POPPLUSHP_H
@@ -171,7 +171,7 @@ public:
         return ss.str();
     }
 
-    inline static bool quiescenceIsPerRecordType() { return false; }
+    static constexpr bool quiescenceIsPerRecordType() { return false; }
 
     inline bool isQuiescent(const int tid) {
         return false;
@@ -192,7 +192,7 @@ public:
     }
     inline static void qUnprotectAll(const int tid) {}
 
-    inline static bool shouldHelp() { return true; }
+    static constexpr bool shouldHelp() { return true; }
 
 private:
     long long getSizeInNodesForThisThread(int tid) {
@@ -379,7 +379,6 @@ public:
     // for all schemes except reference counting
     inline void retire(const int tid, T* p) {
         threadData[tid].curr->add(p);
-        DEBUG2 this->debug->addRetired(tid, 1);
     }
 
     void debugPrintStatus(const int tid) {
@@ -0,0 +1,43 @@
+/*
+ * File:   reclamation_events.h
+ *
+ * Per-thread counts of the reclamation events that affected a thread: events
+ * it ran itself (freeing a batch of retired records, or pinging/neutralizing
+ * other threads so that they can be freed), and pings or neutralization
+ * signals it received from other threads.
+ *
+ * Reclaimers mark an event with RECLAMATION_EVENT at the top of the function
+ * that performs it, and signal handlers mark a received signal with
+ * RECLAMATION_SIGNAL_RECEIVED. The microbench reads the calling thread's
+ * counts before and after an operation to tell whether that operation ran
+ * during a reclamation event (see microbench/latency_histogram.h).
+ * The counts are thread-local, and only maintained once the microbench has
+ * enabled them (with -latency), so other runs only pay for a predictable
+ * branch per event.
+ */
+
+#ifndef RECLAMATION_EVENTS_H
+#define RECLAMATION_EVENTS_H
+
+#include <cstdint>
+
+struct reclamation_events_t {
+    volatile uint64_t ran;          // reclamation events run by this thread
+    volatile uint64_t signalled;    // pings and neutralization signals received by this thread (written by its signal handlers)
+};
+
+static __thread reclamation_events_t __reclamationEvents = {0, 0};
+
+inline reclamation_events_t & reclamationEvents() {
+    return __reclamationEvents;
+}
+
+inline bool & reclamationEventsEnabled() {
+    static bool enabled = false;
+    return enabled;
+}
+
+#define RECLAMATION_EVENT do { if (reclamationEventsEnabled()) ++reclamationEvents().ran; } while (0)
+#define RECLAMATION_SIGNAL_RECEIVED do { if (reclamationEventsEnabled()) ++reclamationEvents().signalled; } while (0)
+
+#endif /* RECLAMATION_EVENTS_H */
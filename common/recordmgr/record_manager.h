@@ -17,21 +17,19 @@
 #include <exception>
 #include <stdexcept>
 #include <typeinfo>
+#include <type_traits>
 
 inline CallbackReturn callbackReturnTrue(CallbackArg arg) {
     return true;
 }
 
-// compile time check for duplicate template parameters
-// compare first with rest to find any duplicates
-template <typename T> void check_duplicates(void) {}
+// compile time check for duplicate template parameters:
+// contains_record_type<T, List...>::value is true iff T is in List...
+template <typename T, typename... List>
+struct contains_record_type : std::false_type {};
 template <typename T, typename First, typename... Rest>
-void check_duplicates(void) {
-    if (typeid(T) == typeid(First)) {
-        throw std::logic_error("duplicate template arguments provided to RecordManagerSet");
-    }
-    check_duplicates<T, Rest...>();
-}
+struct contains_record_type<T, First, Rest...>
+    : std::integral_constant<bool, std::is_same<T, First>::value || contains_record_type<T, Rest...>::value> {};
 
 // base case: empty template
 // this is a compile time check for invalid arguments
@@ -40,9 +38,10 @@ class RecordManagerSet {
     PAD;
 public:
     RecordManagerSet(const int numProcesses, RecoveryMgr<void *> * const _recoveryMgr) {}
+    // only instantiated if T is not one of the record types
     template <typename T>
     record_manager_single_type<T, Reclaim, Alloc, Pool> * get(T * const recordType) {
-        throw std::logic_error("invalid type passed to RecordManagerSet::get()");
+        static_assert(sizeof(T) == 0, "invalid type passed to RecordManagerSet::get()");
         return NULL;
     }
     void clearCounters(void) {}
@@ -65,16 +64,26 @@ public:
 // "recursive" case
 template <class Reclaim, class Alloc, class Pool, typename First, typename... Rest>
 class RecordManagerSet<Reclaim, Alloc, Pool, First, Rest...> : RecordManagerSet<Reclaim, Alloc, Pool, Rest...> {
+    static_assert(!contains_record_type<First, Rest...>::value, "duplicate template arguments provided to RecordManagerSet");
     PAD;
     record_manager_single_type<First, Reclaim, Alloc, Pool> * const mgr;
 	PAD;
+
+    // get() is resolved at compile time: it returns mgr if T is First, and recurses otherwise
+    template<typename T>
+    inline record_manager_single_type<T, Reclaim, Alloc, Pool> * get(T * const recordType, std::true_type isFirst) {
+        return mgr;
+    }
+    template<typename T>
+    inline record_manager_single_type<T, Reclaim, Alloc, Pool> * get(T * const recordType, std::false_type isFirst) {
+        return ((RecordManagerSet<Reclaim, Alloc, Pool, Rest...> *) this)->get(recordType);
+    }
 public:
     RecordManagerSet(const int numProcesses, RecoveryMgr<void *> * const _recoveryMgr)
         : RecordManagerSet<Reclaim, Alloc, Pool, Rest...>(numProcesses, _recoveryMgr)
         , mgr(new record_manager_single_type<First, Reclaim, Alloc, Pool>(numProcesses, _recoveryMgr))
         {
         //cout<<"RecordManagerSet with First="<<typeid(First).name()<<" and sizeof...(Rest)="<<sizeof...(Rest)<<std::endl;
-        check_duplicates<First, Rest...>(); // check if first is in {rest...}
     }
     ~RecordManagerSet() {
         std::cout<<"recordmanager set destructor started for object type "<<typeid(First).name()<<std::endl;
@@ -82,16 +91,10 @@ public:
         std::cout<<"recordmanager set destructor finished for object type "<<typeid(First).name()<<std::endl;
         // note: should automatically call the parent class' destructor afterwards
     }
-    // note: the compiled code for get() should be a single read and return statement
+    // note: the compiled code for get() is a single read and return statement
     template<typename T>
     inline record_manager_single_type<T, Reclaim, Alloc, Pool> * get(T * const recordType) {
-        if (typeid(First) == typeid(T)) {
-//            std::cout<<"MATCH: typeid(First)="<<typeid(First).name()<<" typeid(T)="<<typeid(T).name()<<std::endl;
-            return (record_manager_single_type<T, Reclaim, Alloc, Pool> *) mgr;
-        } else {
-//            std::cout<<"NO MATCH: typeid(First)="<<typeid(First).name()<<" typeid(T)="<<typeid(T).name()<<std::endl;
-            return ((RecordManagerSet<Reclaim, Alloc, Pool, Rest...> *) this)->get(recordType);
-        }
+        return get(recordType, std::is_same<First, T>());
     }
     // note: recursion should be compiled out
     void clearCounters(void) {
@@ -140,7 +143,7 @@ public:
             void * reclaimers[1+sizeof...(Rest)];
             getReclaimers(tid, reclaimers, 0);
             get((First *) NULL)->template startOp<First, Rest...>(tid, reclaimers, 1+sizeof...(Rest), readOnly);
-            __sync_synchronize(); // memory barrier needed (only) for epoch based schemes at the moment...
+            if (Reclaim::needsFenceAfterStartOp()) __sync_synchronize(); // compiled out for reclaimers whose startOp publishes nothing (or publishes with its own fence)
         }
     }
 
@@ -149,7 +152,7 @@ public:
         void * reclaimers[1+sizeof...(Rest)];
         getReclaimers(0, reclaimers, 0);
         get((First *) NULL)->template debugGCSingleThreaded<First, Rest...>(reclaimers, 1+sizeof...(Rest));
-        __sync_synchronize(); // memory barrier needed (only) for epoch based schemes at the moment...
+        if (Reclaim::needsFenceAfterStartOp()) __sync_synchronize();
     }
 };
 
@@ -283,6 +286,22 @@ public:
         return rmset->get((T *) NULL)->read(tid, idx, obj);
     }
 
+    // for range queries: reserves every record of type T read by readScan (at most maxReads) until endScan
+    template <typename T>
+    inline void startScan(const int tid, T * const recordType, const int maxReads) {
+        rmset->get((T *) NULL)->startScan(tid, maxReads);
+    }
+
+    template <typename T>
+    inline T* readScan(const int tid, std::atomic<T*> &obj) {
+        return rmset->get((T *) NULL)->readScan(tid, obj);
+    }
+
+    template <typename T>
+    inline void endScan(const int tid, T * const recordType) {
+        rmset->get((T *) NULL)->endScan(tid);
+    }
+
     template <typename T>
     T* readByPtrToTypeAndPtr(const int tid, int idx, std::atomic<T*> &ptrToObj, T* obj)
     {
@@ -316,6 +335,9 @@ public:
 //            std::cout<<"setting quiescent state for just one record type: "<<typeid(RecordTypesFirst).name()<<"\n";
             rmset->get((RecordTypesFirst *) NULL)->endOp(tid);
         }
+#ifdef PING_SKIP_QUIESCENT
+        if (recoveryMgr->pingDelivery) recoveryMgr->pingDelivery->exitOp(tid);
+#endif
     }
     
     //@J cannot have per record type startOp for tr because it sets restartable =1. Once in first call restartable =1 .
@@ -330,6 +352,9 @@ public:
         // if appropriate, we make a single call to startOp,
         // and it takes care of all record types managed by this record manager.
 //        std::cout<<"quiescenceIsPerRecordType = "<<Reclaim::quiescenceIsPerRecordType()<<std::endl;
+#ifdef PING_SKIP_QUIESCENT
+        if (recoveryMgr->pingDelivery) recoveryMgr->pingDelivery->enterOp(tid);
+#endif
         rmset->startOp(tid, Reclaim::quiescenceIsPerRecordType(), readOnly);
     }
 
@@ -368,13 +393,13 @@ public:
         rmset->get((T *) NULL)->deallocate(tid, p);
     }
 
-    inline static bool shouldHelp() { // FOR DEBUGGING PURPOSES
+    static constexpr bool shouldHelp() { // FOR DEBUGGING PURPOSES
         return Reclaim::shouldHelp();
     }
-    inline static bool supportsCrashRecovery() {
+    static constexpr bool supportsCrashRecovery() {
         return Reclaim::supportsCrashRecovery();
     }    
-    inline static bool needsSetJmp(){
+    static constexpr bool needsSetJmp(){
         return Reclaim::needsSetJmp();
     }
 
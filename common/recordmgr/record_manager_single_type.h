@@ -16,15 +16,20 @@
 
 #include "plaf.h"
 #include "debug_info.h"
+#include "memory_accounting.h"
 #include "globals.h"
 
 #include "recovery_manager.h"
 
 #include "allocator_interface.h"
 #include "allocator_new.h"
+#include "allocator_slab.h"
 
 #include "pool_interface.h"
 #include "pool_none.h"
+#include "pool_perthread_and_shared.h"
+#include "pool_numa.h"
+#include "pool_offload.h"
 
 #include "reclaimer_interface.h"
 #include "reclaimer_none.h"
@@ -89,6 +94,7 @@ public:
     record_manager_single_type(const int numProcesses, RecoveryMgr<void *> * const _recoveryMgr)
             : NUM_PROCESSES(numProcesses), debugInfoRecord(debugInfo(numProcesses)), recoveryMgr(_recoveryMgr) {
         VERBOSE DEBUG COUTATOMIC("constructor record_manager_single_type"<<std::endl);
+        memoryAccounting().registerType(&debugInfoRecord, typeid(Record).name(), sizeof(Record));
         alloc = new classAlloc(numProcesses, &debugInfoRecord);
         pool = new classPool(numProcesses, alloc, &debugInfoRecord);
         reclaim = new classReclaim(numProcesses, pool, &debugInfoRecord, recoveryMgr);
@@ -103,6 +109,7 @@ public:
     }
     ~record_manager_single_type() {
         VERBOSE DEBUG COUTATOMIC("destructor record_manager_single_type"<<std::endl);
+        memoryAccounting().unregisterType(&debugInfoRecord);
         delete reclaim;
         delete pool;
         delete alloc;
@@ -130,7 +137,7 @@ public:
         debugInfoRecord.clear();
     }
 
-    inline static bool shouldHelp() { // FOR DEBUGGING PURPOSES
+    static constexpr bool shouldHelp() { // FOR DEBUGGING PURPOSES
         return Reclaim::shouldHelp();
     }
     inline bool isProtected(const int tid, record_pointer obj) {
@@ -186,19 +193,32 @@ public:
         return reclaim->read(tid, slot_renamers[tid].ui[idx], obj);
     }
 
+    // for range queries, which reserve every record they read until endScan (see scan_reservations.h)
+    inline void startScan(const int tid, const int maxReads) {
+        reclaim->startScan(tid, maxReads);
+    }
+
+    inline record_pointer readScan(const int tid, std::atomic<record_pointer> &obj) {
+        return reclaim->readScan(tid, obj);
+    }
+
+    inline void endScan(const int tid) {
+        reclaim->endScan(tid);
+    }
+
     record_pointer readByPtrToTypeAndPtr(const int tid, int idx, std::atomic<record_pointer> &ptrToObj, record_pointer obj)
     {
         return reclaim->readByPtrToTypeAndPtr(tid, slot_renamers[tid].ui[idx], ptrToObj, obj);
     }
 
-    inline static bool supportsCrashRecovery() {
+    static constexpr bool supportsCrashRecovery() {
         return Reclaim::supportsCrashRecovery();
     }
-    inline static bool needsSetJmp() {
+    static constexpr bool needsSetJmp() {
         return Reclaim::needsSetJmp();
     }
     
-    inline static bool quiescenceIsPerRecordType() {
+    static constexpr bool quiescenceIsPerRecordType() {
         return Reclaim::quiescenceIsPerRecordType();
     }
     inline bool isQuiescent(const int tid) {
@@ -228,6 +248,7 @@ public:
     // for all schemes except reference counting
     inline void retire(const int tid, record_pointer p) {
         assert(!Reclaim::supportsCrashRecovery() || isQuiescent(tid));
+        MEMORY_STATS debugInfoRecord.addRetired(tid, 1);
         reclaim->retire(tid, p);
     }
     
@@ -249,6 +270,7 @@ public:
 
     inline void deallocate(const int tid, record_pointer p) {
         assert(!Reclaim::supportsCrashRecovery() || isQuiescent(tid));
+        MEMORY_STATS debugInfoRecord.addDiscarded(tid, 1);
         pool->add(tid, p);
     }
 
@@ -284,6 +306,8 @@ public:
         COUTATOMIC(typeid(Record).name()<<"_allocated_size="<<(allocatedBytes/1000000.)<<"MB"<<std::endl);
         COUTATOMIC(typeid(Record).name()<<"_get_from_pool="<<getFromPool<<std::endl);
         COUTATOMIC(typeid(Record).name()<<"_deallocated="<<deallocated<<std::endl);
+        COUTATOMIC(typeid(Record).name()<<"_retired="<<debugInfoRecord.getTotalRetired()<<std::endl);
+        COUTATOMIC(typeid(Record).name()<<"_garbage="<<debugInfoRecord.getTotalGarbage()<<std::endl);
         COUTATOMIC(typeid(Record).name()<<"_limbo_count="<<reclaim->getSizeString()<<std::endl);
         COUTATOMIC(typeid(Record).name()<<"_limbo_details="<<reclaim->getDetailsString()<<std::endl);
         //COUTATOMIC(typeid(Record).name()<<"_pool_count="<<pool->getSizeString()<<std::endl);
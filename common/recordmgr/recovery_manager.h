@@ -18,6 +18,9 @@
 #include <csignal>
 #include "globals.h"
 #include "debugcounter.h" //@J to count hanlerexec and siglongjmps
+#include "ping_delivery.h"
+#include "thread_registry.h"
+#include "thread_signals.h"
 
 //sig perf testing
 #define BEGIN_MEASURE(cycles_high, cycles_low) asm volatile (  "CPUID\n\t"\
@@ -99,6 +102,7 @@ void crashhandler(int signum, siginfo_t *info, void *uctx) {
     int tid = (int) ((long) pthread_getspecific(pthreadkey));
 #endif
     TRACE COUTATOMICTID("received signal "<<signum<<std::endl);
+    RECLAMATION_SIGNAL_RECEIVED;
 
     // if i'm active (not in a quiescent state), i must throw an exception
     // and clean up after myself, instead of continuing my operation.
@@ -136,8 +140,14 @@ void trcrashhandler(int signum, siginfo_t *info, void *uctx)
     // //USER Warning: printf cout in here with longjmp causes hang
     MasterRecordMgr * const recordmgr = (MasterRecordMgr * const) ___singleton;
     int tid = (int) ((long) pthread_getspecific(pthreadkey));
+    // a ping sent just before this thread left (e.g., to be replaced) must not
+    // republish its stale reservations after deinitThread cleared them
+    if (!recordmgr->recoveryMgr->liveThreads.contains(tid)) return;
+    RECLAMATION_SIGNAL_RECEIVED;
     
+    recordmgr->recoveryMgr->pingDelivery->onPing(tid, info);
     recordmgr->publishReservations(tid);
+    recordmgr->recoveryMgr->pingDelivery->onPublished(tid);
     // reservations[tid].ui.store(local_epoch_at_start, std::memory_order_release);
 }
 #elif defined (NZB_RECLAIMERS)
@@ -149,6 +159,7 @@ void trcrashhandler(int signum, siginfo_t *info, void *uctx)
     // MasterRecordMgr * const recordmgr = (MasterRecordMgr * const) ___singleton;
     MasterRecordMgr * const recordmgr = (MasterRecordMgr * const) ___singleton;
     int tid = (int) ((long) pthread_getspecific(pthreadkey));    
+    RECLAMATION_SIGNAL_RECEIVED;
     if(!restartable) {
         return;
     }
@@ -172,6 +183,11 @@ public:
     PAD;
     const int NUM_PROCESSES;
     const int neutralizeSignal;
+    PingDelivery * pingDelivery; // used by pop reclaimers to ping all threads (NULL unless needsSetJmp)
+    PAD;
+    ThreadRegistry liveThreads;  // tids between initThread and deinitThread, for reclaimers to scan
+    PAD;
+    ThreadSignals signals;       // pthreads of live tids, for threads that signal other threads
     PAD;
     
     inline int getTidInefficient(const pthread_t me) {
@@ -218,13 +234,16 @@ public:
         TRACE AJDBG COUTATOMICTID("getPthread:: pthreadself:"<<pthread_self()<<" registeredtid:"<<registeredThreads[tid]<<std::endl); //@J
         return registeredThreads[tid];
     }
+    // sends neutralizeSignal to the thread with tid; see ThreadSignals::signal
+    inline int signalThread(const int tid) {
+        return signals.signal(tid, neutralizeSignal);
+    }
     
     void initThread(const int tid) {
+        // create mapping between tid and pthread_self for the signal handler
+        // and for any thread that neutralizes another
+        registeredThreads[tid] = pthread_self();
         if (MasterRecordMgr::supportsCrashRecovery() || MasterRecordMgr::needsSetJmp()) {
-            // create mapping between tid and pthread_self for the signal handler
-            // and for any thread that neutralizes another
-            registeredThreads[tid] = pthread_self();
-            
             AJDBG COUTATOMICTID("RECVRY::initThread pthreadself:"<<pthread_self()<<" registeredtid:"<<registeredThreads[tid]<<std::endl); //@J
             // here, we use the fact that errno is defined to be a thread local variable
             errnoThreads[tid] = &errno;
@@ -235,11 +254,21 @@ public:
             VERBOSE DEBUG COUTATOMICTID("did pthread_setspecific, pthread_getspecific of "<<__readtid<<std::endl);
             assert(__readtid == tid);
         }
+        // only after the signal handler can find this thread, since joining lets others ping it
+        signals.set(tid, pthread_self());
+        liveThreads.join(tid);
     }
     void deinitThread(const int tid) {
         AJDBG COUTATOMICTID("RECVRY::deinitThread pthreadself:"<<pthread_self()<<" registeredtid:"<<registeredThreads[tid]<<std::endl); //@J
         if (MasterRecordMgr::needsSetJmp()) 
             assert (pthread_self() == registeredThreads[tid] && "LOL, tid's mismatch is deadly for TR");
+        // a tid that another pthread has since taken over (e.g., the main thread's tid 0 after prefilling) stays live
+        if (pthread_equal(registeredThreads[tid], pthread_self())) {
+            liveThreads.leave(tid);
+            registeredThreads[tid] = (pthread_t) 0;
+            // waits for threads that are signalling this one, so that none signals it after it exits
+            signals.clear(tid);
+        }
     }
     
     void unblockCrashRecoverySignal() {
@@ -256,7 +285,7 @@ public:
     }
     
     RecoveryMgr(const int numProcesses, const int _neutralizeSignal, MasterRecordMgr * const masterRecordMgr)
-            : NUM_PROCESSES(numProcesses) , neutralizeSignal(_neutralizeSignal){
+            : NUM_PROCESSES(numProcesses) , neutralizeSignal(_neutralizeSignal), pingDelivery(NULL){
         
         if (MasterRecordMgr::supportsCrashRecovery() || MasterRecordMgr::needsSetJmp()) {
             setjmpbuffers = new sigjmp_buf[numProcesses*JUMPBUF_PAD];
@@ -287,6 +316,10 @@ public:
                 VERBOSE COUTATOMIC("registered signal "<<_neutralizeSignal<<" for crash recovery"<<std::endl);
             }
             
+            if (MasterRecordMgr::needsSetJmp()) {
+                pingDelivery = new PingDelivery(numProcesses, _neutralizeSignal, &signals, &liveThreads);
+            }
+
             // set up shared pointer to this class instance for the signal handler
             ___singleton = (void *) masterRecordMgr;
         }
@@ -294,6 +327,7 @@ public:
     ~RecoveryMgr() {
         if (MasterRecordMgr::supportsCrashRecovery() || MasterRecordMgr::needsSetJmp() ) {
             delete[] setjmpbuffers;
+            delete pingDelivery;
         }
     }
 };
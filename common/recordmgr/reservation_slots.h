@@ -0,0 +1,111 @@
+/*
+ * File:   reservation_slots.h
+ *
+ * Per-thread reservation slots (hazard pointers or hazard eras) laid out so
+ * that the slots of one thread are contiguous and share a cache line, and the
+ * rows of different threads are PREFETCH_SIZE_BYTES apart (and so never share
+ * a cache line, even with adjacent-line prefetching). Scanning N threads with
+ * k slots each touches N cache lines (for k*sizeof(V) <= 64), rather than N*k
+ * separately padded slots.
+ *
+ * snapshot() copies every slot into a caller-provided buffer, streaming over
+ * the rows in address order and prefetching RESERVATION_SLOTS_PREFETCH_ROWS
+ * rows ahead, so that a reclaimer can take its snapshot with one pass over
+ * the array and then work on its (reusable, thread-private) copy. Given a
+ * ThreadRegistry, it copies only the rows of live threads.
+ */
+
+#ifndef RESERVATION_SLOTS_H
+#define RESERVATION_SLOTS_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "plaf.h"
+#include "thread_registry.h"
+
+#ifndef RESERVATION_SLOTS_PREFETCH_ROWS
+#define RESERVATION_SLOTS_PREFETCH_ROWS 4
+#endif
+
+template <typename V>
+class ReservationSlots {
+private:
+    static const int VALUES_PER_ROW_UNIT = PREFETCH_SIZE_BYTES / sizeof(std::atomic<V>);
+
+    const int numThreads;
+    const int slotsPerThread;
+    const int stride;           // values per row, a multiple of VALUES_PER_ROW_UNIT
+    void * mem;                 // one row unit of padding on either side of the rows
+    std::atomic<V> * rows;
+
+public:
+    ReservationSlots(const int _numThreads, const int _slotsPerThread, const V initial)
+    : numThreads(_numThreads)
+    , slotsPerThread(_slotsPerThread)
+    , stride((_slotsPerThread + VALUES_PER_ROW_UNIT - 1) / VALUES_PER_ROW_UNIT * VALUES_PER_ROW_UNIT)
+    {
+        const size_t bytes = (size_t) (numThreads * stride + 2 * VALUES_PER_ROW_UNIT) * sizeof(std::atomic<V>);
+        if (posix_memalign(&mem, PREFETCH_SIZE_BYTES, bytes)) throw std::bad_alloc();
+        rows = ((std::atomic<V> *) mem) + VALUES_PER_ROW_UNIT;
+        for (int i=0;i<numThreads*stride;++i) {
+            new (&rows[i]) std::atomic<V>(initial);
+        }
+    }
+
+    ~ReservationSlots() {
+        std::free(mem);
+    }
+
+    inline std::atomic<V>& at(const int tid, const int slot) {
+        return rows[tid*stride + slot];
+    }
+
+    inline int getSlotsPerThread() const {
+        return slotsPerThread;
+    }
+
+    // number of values written by snapshot()
+    inline int size() const {
+        return numThreads * slotsPerThread;
+    }
+
+    /**
+     * Copies the slots of every thread into out, thread by thread: the value
+     * of slot j of thread t is out[t*slotsPerThread + j]. out must hold
+     * size() values.
+     */
+    inline void snapshot(V * const out, const std::memory_order order = std::memory_order_seq_cst) {
+        for (int t=0;t<numThreads;++t) {
+            if (t + RESERVATION_SLOTS_PREFETCH_ROWS < numThreads) {
+                __builtin_prefetch(&rows[(t + RESERVATION_SLOTS_PREFETCH_ROWS)*stride], 0, 0);
+            }
+            std::atomic<V> * const row = &rows[t*stride];
+            V * const dest = &out[t*slotsPerThread];
+            for (int j=0;j<slotsPerThread;++j) {
+                dest[j] = row[j].load(order);
+            }
+        }
+    }
+
+    /**
+     * Copies the slots of the members of live (only), packed one thread after
+     * another, and returns the number of values written (a multiple of
+     * getSlotsPerThread(), at most size()).
+     */
+    inline int snapshot(const ThreadRegistry * const live, V * const out, const std::memory_order order = std::memory_order_seq_cst) {
+        int n = 0;
+        for (int t = live->first(); t != -1; ) {
+            const int nextT = live->next(t);
+            if (nextT != -1) __builtin_prefetch(&rows[nextT*stride], 0, 0);
+            std::atomic<V> * const row = &rows[t*stride];
+            for (int j=0;j<slotsPerThread;++j) {
+                out[n++] = row[j].load(order);
+            }
+            t = nextT;
+        }
+        return n;
+    }
+};
+
+#endif /* RESERVATION_SLOTS_H */
@@ -0,0 +1,161 @@
+/*
+ * File:   reservation_snapshot.h
+ *
+ * Snapshots of epoch reservations that let the interval-based reclaimers
+ * (2geibr, he, nbr_pophe) decide whether a retired record is reserved in
+ * O(log N) time rather than by scanning all N threads' reservations.
+ *
+ * ReservedIntervals holds IBR [lower, upper] reservations, sorted and merged
+ *      into disjoint intervals.
+ * ReservedEras holds hazard eras, sorted and deduplicated (0 = no era).
+ * ReservedErasAndIntervals holds both, for the hazard era reclaimers, whose
+ *      range queries reserve intervals (see scan_reservations.h).
+ *
+ * freeUnreserved() sweeps a thread's retired records. They must be kept in a
+ * vector in retire order, i.e., sorted by retire epoch. Every record retired
+ * before the oldest reservation is a prefix of that vector, and is freed
+ * without any search. The other records are each checked by binary search,
+ * and the survivors are compacted in place, so the vector stays sorted.
+ */
+
+#ifndef RESERVATION_SNAPSHOT_H
+#define RESERVATION_SNAPSHOT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class ReservedIntervals {
+private:
+    std::vector<std::pair<uint64_t, uint64_t>> intervals; // (lower, upper)
+
+public:
+    inline void clear() {
+        intervals.clear();
+    }
+
+    // lower == UINT64_MAX means the thread holds no reservation
+    inline void add(const uint64_t lower, const uint64_t upper) {
+        if (lower == UINT64_MAX || lower > upper) return;
+        intervals.push_back(std::make_pair(lower, upper));
+    }
+
+    // invoke after all add()s and before any query
+    void build() {
+        if (intervals.empty()) return;
+        std::sort(intervals.begin(), intervals.end());
+        size_t n = 0;
+        for (size_t i=1;i<intervals.size();++i) {
+            if (intervals[i].first <= intervals[n].second) {
+                intervals[n].second = std::max(intervals[n].second, intervals[i].second);
+            } else {
+                intervals[++n] = intervals[i];
+            }
+        }
+        intervals.resize(n+1);
+    }
+
+    inline uint64_t minReserved() const {
+        return intervals.empty() ? UINT64_MAX : intervals[0].first;
+    }
+
+    // true iff some reservation intersects [birth, retire]
+    inline bool conflicts(const uint64_t birth, const uint64_t retire) const {
+        // last interval whose lower bound is <= retire (intervals are disjoint, so upper bounds are sorted too)
+        auto it = std::upper_bound(intervals.begin(), intervals.end(), std::make_pair(retire, UINT64_MAX));
+        if (it == intervals.begin()) return false;
+        return (--it)->second >= birth;
+    }
+};
+
+class ReservedEras {
+private:
+    std::vector<uint64_t> eras;
+
+public:
+    inline void clear() {
+        eras.clear();
+    }
+
+    // era 0 means the slot holds no reservation
+    inline void add(const uint64_t era) {
+        if (era == 0) return;
+        eras.push_back(era);
+    }
+
+    // invoke after all add()s and before any query
+    void build() {
+        std::sort(eras.begin(), eras.end());
+        eras.erase(std::unique(eras.begin(), eras.end()), eras.end());
+    }
+
+    inline uint64_t minReserved() const {
+        return eras.empty() ? UINT64_MAX : eras[0];
+    }
+
+    // true iff some era lies in [birth, retire]
+    inline bool conflicts(const uint64_t birth, const uint64_t retire) const {
+        auto it = std::lower_bound(eras.begin(), eras.end(), birth);
+        return it != eras.end() && *it <= retire;
+    }
+};
+
+class ReservedErasAndIntervals {
+private:
+    ReservedEras eras;
+    ReservedIntervals intervals;
+
+public:
+    inline void clear() {
+        eras.clear();
+        intervals.clear();
+    }
+
+    inline void add(const uint64_t era) {
+        eras.add(era);
+    }
+
+    inline void add(const uint64_t lower, const uint64_t upper) {
+        intervals.add(lower, upper);
+    }
+
+    void build() {
+        eras.build();
+        intervals.build();
+    }
+
+    inline uint64_t minReserved() const {
+        return std::min(eras.minReserved(), intervals.minReserved());
+    }
+
+    inline bool conflicts(const uint64_t birth, const uint64_t retire) const {
+        return eras.conflicts(birth, retire) || intervals.conflicts(birth, retire);
+    }
+};
+
+// frees (via freeFn(obj)) every record in trash that is not reserved, and returns how many were freed.
+// Info must have obj, birth_epoch and retire_epoch, and trash must be sorted by retire_epoch.
+template <typename Info, typename Reservations, typename FreeFn>
+size_t freeUnreserved(std::vector<Info>& trash, const Reservations& reserved, FreeFn freeFn) {
+    const size_t n = trash.size();
+    const uint64_t minReserved = reserved.minReserved();
+
+    size_t i = 0;
+    while (i < n && trash[i].retire_epoch < minReserved) {
+        freeFn(trash[i++].obj);
+    }
+    size_t kept = 0;
+    for (;i<n;++i) {
+        if (reserved.conflicts(trash[i].birth_epoch, trash[i].retire_epoch)) {
+            if (kept != i) trash[kept] = trash[i];
+            ++kept;
+        } else {
+            freeFn(trash[i].obj);
+        }
+    }
+    trash.erase(trash.begin() + kept, trash.end());
+    return n - kept;
+}
+
+#endif /* RESERVATION_SNAPSHOT_H */
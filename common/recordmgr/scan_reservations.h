@@ -0,0 +1,175 @@
+/*
+ * File:   scan_reservations.h
+ *
+ * Reservations for range queries, which must keep every record they read
+ * reserved until they finish (e.g., to validate the nodes they visited), so
+ * they cannot take turns using a thread's few reservation slots.
+ *
+ * ScanHazardPointers, for the hazard pointer reclaimers, gives each thread a
+ * row with one hazard pointer per record its current scan has read. The
+ * scan sizes its row in start() with the most records it can read. Only the
+ * owner writes a row, and it only replaces the row's array while no scan is
+ * in progress. A reclaimer may still be reading the old array, so replaced
+ * arrays are freed by the destructor. (The capacity at least doubles on each
+ * replacement, so this costs at most as much memory as the current arrays.)
+ *
+ * ScanIntervals, for the hazard era reclaimers, gives each thread one epoch
+ * interval [lower, upper]. start() reserves the current epoch, and each read
+ * extends upper to the current epoch. Every record the scan read was in the
+ * data structure at the epoch of that read, so its [birth, retire] interval
+ * intersects the reserved interval.
+ *
+ * Both publish with seq_cst stores, as hazard pointers and eras do. This is
+ * also true in the publish-on-ping reclaimers, whose ping handlers publish
+ * only their other reservations.
+ */
+
+#ifndef SCAN_RESERVATIONS_H
+#define SCAN_RESERVATIONS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "plaf.h"
+#include "thread_registry.h"
+
+template <typename T>
+class ScanHazardPointers {
+private:
+    struct Row {
+        PAD;
+        std::atomic<std::atomic<T*> *> ptrs;
+        std::atomic<int> size;                      // ptrs[0..size) are reserved
+        int capacity;
+        std::vector<std::atomic<T*> *> replaced;    // old arrays, which reclaimers may still read
+        PAD;
+    };
+    Row rows[MAX_THREADS_POW2];
+
+public:
+    ScanHazardPointers() {
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            rows[i].ptrs.store(NULL, std::memory_order_relaxed);
+            rows[i].size.store(0, std::memory_order_relaxed);
+            rows[i].capacity = 0;
+        }
+    }
+
+    ~ScanHazardPointers() {
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            delete[] rows[i].ptrs.load(std::memory_order_relaxed);
+            for (auto p : rows[i].replaced) delete[] p;
+        }
+    }
+
+    // begins a scan that will read at most maxReads records
+    void start(const int tid, const int maxReads) {
+        Row * const r = &rows[tid];
+        assert(r->size.load(std::memory_order_relaxed) == 0);
+        if (maxReads <= r->capacity) return;
+        const int capacity = std::max(maxReads, 2*r->capacity);
+        std::atomic<T*> * const ptrs = new std::atomic<T*>[capacity];
+        for (int i=0;i<capacity;++i) {
+            ptrs[i].store(NULL, std::memory_order_relaxed);
+        }
+        std::atomic<T*> * const old = r->ptrs.load(std::memory_order_relaxed);
+        if (old) r->replaced.push_back(old);
+        r->ptrs.store(ptrs, std::memory_order_seq_cst);
+        r->capacity = capacity;
+    }
+
+    // reads obj, and reserves the record it points to until end()
+    inline T* read(const int tid, std::atomic<T*> &obj) {
+        Row * const r = &rows[tid];
+        const int i = r->size.load(std::memory_order_relaxed);
+        assert(i < r->capacity);
+        std::atomic<T*> * const slot = &r->ptrs.load(std::memory_order_relaxed)[i];
+        r->size.store(i+1, std::memory_order_seq_cst);
+        while (true) {
+            T* const ret = obj.load(std::memory_order_acquire);
+            slot->store((T*) ((size_t) ret & 0xfffffffffffffffc), std::memory_order_seq_cst);
+            if (ret == obj.load(std::memory_order_acquire)) return ret;
+        }
+    }
+
+    inline void end(const int tid) {
+        rows[tid].size.store(0, std::memory_order_release);
+    }
+
+    // replaces out with the records reserved by the scans of the members of live, sorted
+    void snapshot(const ThreadRegistry * const live, std::vector<T*>& out) {
+        out.clear();
+        FOR_EACH_LIVE_TID(t, live) {
+            Row * const r = &rows[t];
+            const int size = r->size.load(std::memory_order_seq_cst);
+            if (size == 0) continue;
+            std::atomic<T*> * const ptrs = r->ptrs.load(std::memory_order_seq_cst);
+            for (int i=0;i<size;++i) {
+                T* const p = ptrs[i].load(std::memory_order_seq_cst);
+                if (p) out.push_back(p);
+            }
+        }
+        std::sort(out.begin(), out.end());
+    }
+
+    // is ptr in a (sorted) snapshot?
+    static inline bool contains(const std::vector<T*>& snapshot, T* const ptr) {
+        return !snapshot.empty() && std::binary_search(snapshot.begin(), snapshot.end(), ptr);
+    }
+};
+
+class ScanIntervals {
+private:
+    struct Row {
+        PAD;
+        std::atomic<uint64_t> lower;    // UINT64_MAX if no scan is in progress
+        std::atomic<uint64_t> upper;
+        PAD;
+    };
+    Row rows[MAX_THREADS_POW2];
+
+public:
+    ScanIntervals() {
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            rows[i].lower.store(UINT64_MAX, std::memory_order_relaxed);
+            rows[i].upper.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // begins a scan at the given (current) epoch
+    inline void start(const int tid, const uint64_t epoch) {
+        rows[tid].upper.store(epoch, std::memory_order_seq_cst);
+        rows[tid].lower.store(epoch, std::memory_order_seq_cst);
+    }
+
+    // reads obj, extending the reservation to the epoch at which it is read (getEpoch())
+    template <typename T, typename GetEpoch>
+    inline T* read(const int tid, std::atomic<T*> &obj, GetEpoch getEpoch) {
+        uint64_t prev = rows[tid].upper.load(std::memory_order_relaxed);
+        while (true) {
+            T* const ptr = obj.load(std::memory_order_acquire);
+            const uint64_t curr = getEpoch();
+            if (curr == prev) return ptr;
+            rows[tid].upper.store(curr, std::memory_order_seq_cst);
+            prev = curr;
+        }
+    }
+
+    inline void end(const int tid) {
+        rows[tid].lower.store(UINT64_MAX, std::memory_order_release);
+    }
+
+    // invokes add(lower, upper) for the scan of each member of live that has one
+    template <typename AddFn>
+    inline void forEach(const ThreadRegistry * const live, AddFn add) {
+        FOR_EACH_LIVE_TID(t, live) {
+            const uint64_t lower = rows[t].lower.load(std::memory_order_seq_cst);
+            if (lower == UINT64_MAX) continue;
+            add(lower, rows[t].upper.load(std::memory_order_seq_cst));
+        }
+    }
+};
+
+#endif /* SCAN_RESERVATIONS_H */
@@ -0,0 +1,160 @@
+/*
+ * File:   thread_registry.h
+ *
+ * Registry of the tids that are currently between initThread and deinitThread,
+ * so that reclaimers scan, wait for and ping only live threads rather than all
+ * NUM_PROCESSES tids (most of which may never have started, or may have left).
+ *
+ * Membership is kept twice:
+ *  - a bitmap (one bit per tid), read with plain atomic loads; first() and
+ *    next() walk the set bits, and contains() tests one.
+ *  - a dense list of the live tids, for callers that want a compact array
+ *    (e.g., to index per-thread state by position). snapshot() copies it.
+ *
+ * join() and leave() are serialized by a spin lock (they are rare), and bump
+ * a version number around each change (odd while a change is in progress), so
+ * that snapshot() is lock-free for readers: it retries if the version changed.
+ *
+ * Why skipping non-members is safe: a thread joins (with a seq_cst RMW) before
+ * it performs any operation, and leaves only after its last operation, when
+ * it holds no reservations. A record in a reclaimer's retired bag was unlinked
+ * before the reclaimer reads the registry; if the reclaimer does not see a
+ * thread's join, that thread joined (and so began to read the data structure)
+ * after the record became unreachable, and cannot hold a reference to it.
+ */
+
+#ifndef THREAD_REGISTRY_H
+#define THREAD_REGISTRY_H
+
+#include <atomic>
+#include <sched.h>
+#include "plaf.h"
+
+// iterates tid over the members of (ThreadRegistry *) registry, in increasing order
+#define FOR_EACH_LIVE_TID(tid, registry) for (int tid = (registry)->first(); (tid) != -1; (tid) = (registry)->next(tid))
+
+class ThreadRegistry {
+private:
+    static const int WORDS = (MAX_THREADS_POW2 + 63) / 64;
+
+    PAD;
+    std::atomic<uint64_t> bits[WORDS];
+    PAD;
+    std::atomic<uint64_t> version;          // odd while a join or leave is in progress
+    std::atomic<int> count;
+    std::atomic<int> dense[MAX_THREADS_POW2];
+    int position[MAX_THREADS_POW2];         // position of each member in dense (only accessed under lock)
+    PAD;
+    std::atomic<bool> lock;
+    PAD;
+
+    inline void acquire() {
+        while (lock.exchange(true, std::memory_order_acquire)) {
+            while (lock.load(std::memory_order_relaxed)) sched_yield();
+        }
+    }
+    inline void release() {
+        lock.store(false, std::memory_order_release);
+    }
+
+public:
+    ThreadRegistry() {
+        for (int i=0;i<WORDS;++i) bits[i].store(0, std::memory_order_relaxed);
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            dense[i].store(-1, std::memory_order_relaxed);
+            position[i] = -1;
+        }
+        version.store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        lock.store(false, std::memory_order_relaxed);
+    }
+
+    // adds tid to the registry (no effect if it is already a member)
+    void join(const int tid) {
+        acquire();
+        if (position[tid] == -1) {
+            version.fetch_add(1, std::memory_order_seq_cst);
+            const int n = count.load(std::memory_order_relaxed);
+            dense[n].store(tid, std::memory_order_relaxed);
+            position[tid] = n;
+            count.store(n+1, std::memory_order_relaxed);
+            bits[tid >> 6].fetch_or(1ULL << (tid & 63), std::memory_order_seq_cst);
+            version.fetch_add(1, std::memory_order_seq_cst);
+        }
+        release();
+    }
+
+    // removes tid from the registry (no effect if it is not a member)
+    void leave(const int tid) {
+        acquire();
+        const int p = position[tid];
+        if (p != -1) {
+            version.fetch_add(1, std::memory_order_seq_cst);
+            bits[tid >> 6].fetch_and(~(1ULL << (tid & 63)), std::memory_order_seq_cst);
+            const int last = count.load(std::memory_order_relaxed) - 1;
+            const int moved = dense[last].load(std::memory_order_relaxed);
+            dense[p].store(moved, std::memory_order_relaxed);
+            position[moved] = p;
+            dense[last].store(-1, std::memory_order_relaxed);
+            position[tid] = -1;
+            count.store(last, std::memory_order_relaxed);
+            version.fetch_add(1, std::memory_order_seq_cst);
+        }
+        release();
+    }
+
+    inline bool contains(const int tid) const {
+        return bits[tid >> 6].load(std::memory_order_seq_cst) & (1ULL << (tid & 63));
+    }
+
+    inline int size() const {
+        return count.load(std::memory_order_acquire);
+    }
+
+    // true iff some thread other than tid is a member (whether or not tid is)
+    inline bool hasMemberOtherThan(const int tid) const {
+        return size() > (contains(tid) ? 1 : 0);
+    }
+
+    // incremented twice by every change of membership
+    inline uint64_t getVersion() const {
+        return version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * The smallest member greater than tid, or -1 if there is none. Iterate
+     * over the members (in increasing order) with
+     *     for (int t = reg.first(); t != -1; t = reg.next(t))
+     */
+    inline int next(const int tid) const {
+        int w = (tid + 1) >> 6;
+        if (w >= WORDS) return -1;
+        uint64_t word = bits[w].load(std::memory_order_seq_cst) & (~0ULL << ((tid + 1) & 63));
+        while (!word) {
+            if (++w >= WORDS) return -1;
+            word = bits[w].load(std::memory_order_seq_cst);
+        }
+        return (w << 6) + __builtin_ctzll(word);
+    }
+    inline int first() const {
+        return next(-1);
+    }
+
+    /**
+     * Copies the dense list of members into out (which must have room for
+     * every tid that may join) and returns the number of members. The copy
+     * is a consistent view of the membership at some point during the call.
+     */
+    int snapshot(int * const out) const {
+        while (true) {
+            const uint64_t v = version.load(std::memory_order_seq_cst);
+            if (v & 1) { sched_yield(); continue; }
+            const int n = count.load(std::memory_order_acquire);
+            for (int i=0;i<n;++i) out[i] = dense[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version.load(std::memory_order_relaxed) == v) return n;
+        }
+    }
+};
+
+#endif /* THREAD_REGISTRY_H */
@@ -0,0 +1,87 @@
+/*
+ * File:   thread_signals.h
+ *
+ * The pthread registered for each tid, for threads that signal (ping or
+ * neutralize) other threads by tid.
+ *
+ * Looking up a pthread_t and then calling pthread_kill on it is unsafe if the
+ * thread can exit in between: the signal would go to a dead (or reused)
+ * pthread_t, which is undefined behaviour. So each slot pairs an atomic
+ * pthread_t with a count of signallers in flight. A signaller increments the
+ * count before it reads the pthread_t, and decrements it after pthread_kill
+ * returns. clear() (invoked by a thread before it exits) resets the pthread_t
+ * and then waits until the count drops to zero. Both sides use seq_cst, so
+ * either the signaller sees the reset (and sends nothing), or clear() sees
+ * the signaller (and waits for it), and no signal is sent to a thread that
+ * has returned from clear().
+ *
+ * signal() is async-signal-safe, so a pinged thread may forward pings from
+ * its signal handler.
+ */
+
+#ifndef THREAD_SIGNALS_H
+#define THREAD_SIGNALS_H
+
+#include <atomic>
+#include <csignal>
+#include <pthread.h>
+#include <sched.h>
+#include "plaf.h"
+
+class ThreadSignals {
+private:
+    struct Slot {
+        PAD;
+        std::atomic<pthread_t> pthread;     // 0 if no thread has this tid
+        std::atomic<int> signallers;        // signallers between reading pthread and returning from pthread_kill
+        PAD;
+    };
+
+    Slot slots[MAX_THREADS_POW2];
+
+public:
+    // returned by signal() if no thread has the tid
+    static const int NO_THREAD = -1;
+
+    ThreadSignals() {
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            slots[i].pthread.store((pthread_t) 0, std::memory_order_relaxed);
+            slots[i].signallers.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void set(const int tid, const pthread_t thread) {
+        slots[tid].pthread.store(thread, std::memory_order_seq_cst);
+    }
+
+    // after this returns, no signal() for tid reaches the thread that had it
+    void clear(const int tid) {
+        slots[tid].pthread.store((pthread_t) 0, std::memory_order_seq_cst);
+        while (slots[tid].signallers.load(std::memory_order_seq_cst)) sched_yield();
+    }
+
+    /**
+     * Sends signum to the thread with tid, and returns the result of
+     * pthread_kill, or NO_THREAD (without sending) if no thread has tid.
+     */
+    inline int signal(const int tid, const int signum) {
+        Slot * const s = &slots[tid];
+        s->signallers.fetch_add(1, std::memory_order_seq_cst);
+        const pthread_t thread = s->pthread.load(std::memory_order_seq_cst);
+        const int result = (thread == (pthread_t) 0) ? NO_THREAD : pthread_kill(thread, signum);
+        s->signallers.fetch_sub(1, std::memory_order_release);
+        return result;
+    }
+
+    // as signal(), but with pthread_sigqueue, so the handler receives value
+    inline int signal(const int tid, const int signum, const union sigval value) {
+        Slot * const s = &slots[tid];
+        s->signallers.fetch_add(1, std::memory_order_seq_cst);
+        const pthread_t thread = s->pthread.load(std::memory_order_seq_cst);
+        const int result = (thread == (pthread_t) 0) ? NO_THREAD : pthread_sigqueue(thread, signum, value);
+        s->signallers.fetch_sub(1, std::memory_order_release);
+        return result;
+    }
+};
+
+#endif /* THREAD_SIGNALS_H */
@@ -0,0 +1,261 @@
+/*
+ * File:   rq_limbo.h
+ *
+ * Deleted-node limbo shared by the timestamp-based RQProviders
+ * (rq_rwlock.h, rq_htm_rwlock.h and rq_dcssp.h).
+ *
+ * A range query that is linearized at time L must return every key whose node
+ * was inserted before L and deleted at or after L. If such a node is unlinked
+ * while the query is traversing, the traversal can miss it, so every deleted
+ * node is first announced by its deleter and then kept in the deleter's limbo
+ * ring, tagged with its dtime, where traversal_end can find it.
+ *
+ * Nodes are retired to the record manager only once no range query can still
+ * need them, i.e., once their push time is older than the start of every
+ * announced range query. Because the limbo is kept here rather than inside
+ * the reclaimer's own retired bags, the providers work with any reclaimer, and
+ * a long-running range query delays reclamation exactly as long as it needs to.
+ *
+ * Each thread owns one ring. Only the owner writes it; other threads only scan
+ * it. A full ring is first pruned and, if it is still full, replaced by one
+ * twice as large. Old rings are kept until the limbo is destroyed, since a
+ * concurrent scanner may still be reading them.
+ */
+
+#ifndef RQ_LIMBO_H
+#define RQ_LIMBO_H
+
+#include <climits>
+#include <cstdlib>
+#include "plaf.h"
+#include "errors.h"
+
+#ifndef MAX_NODES_DELETED_ATOMICALLY
+    #define MAX_NODES_DELETED_ATOMICALLY 4
+#endif
+
+#ifndef RQ_LIMBO_INITIAL_CAPACITY
+    #define RQ_LIMBO_INITIAL_CAPACITY 256 // per thread; must be a power of two
+#endif
+
+// try to retire nodes from the limbo after this many deletions
+#ifndef RQ_LIMBO_PRUNE_INTERVAL
+    #define RQ_LIMBO_PRUNE_INTERVAL 32
+#endif
+
+#define RQ_LIMBO_NO_RQ LLONG_MAX
+
+template <typename NodeType, typename RecordManager>
+class RQLimbo {
+private:
+    struct Entry {
+        NodeType * volatile node;
+        volatile long long dtime;
+        long long pushTime;             // only accessed by the owner
+    };
+    struct Ring {
+        long long capacity;
+        Entry * entries;
+        Ring * older;                   // rings this one replaced
+    };
+    struct ThreadState {
+        PAD;
+        Ring * volatile ring;
+        volatile long long head;        // index of the next entry to push
+        volatile long long tail;        // index of the oldest entry that has not been retired
+        long long sinceLastPrune;
+        NodeType * volatile announced[MAX_NODES_DELETED_ATOMICALLY+1];
+        volatile long long rqStart;     // timestamp when this thread's current rq started (or RQ_LIMBO_NO_RQ)
+        PAD;
+    };
+
+    const int NUM_PROCESSES;
+    RecordManager * const recmgr;
+    volatile long long * const timestamp;
+    ThreadState * threadState;
+
+    static Ring * newRing(const long long capacity, Ring * const older) {
+        Ring * r = new Ring();
+        r->capacity = capacity;
+        r->entries = (Entry *) calloc(capacity, sizeof(Entry));
+        if (r->entries == NULL) {
+            setbench_error("RQLimbo could not allocate a ring of "<<capacity<<" entries");
+        }
+        r->older = older;
+        return r;
+    }
+
+    // replace the ring of tid by one twice as large, keeping every entry at the same index
+    void grow(const int tid) {
+        ThreadState * const ts = &threadState[tid];
+        Ring * const oldRing = ts->ring;
+        Ring * const r = newRing(2*oldRing->capacity, oldRing);
+        const long long oldMask = oldRing->capacity - 1;
+        const long long mask = r->capacity - 1;
+        for (long long i=ts->tail;i<ts->head;++i) {
+            r->entries[i & mask] = oldRing->entries[i & oldMask];
+        }
+        SOFTWARE_BARRIER;
+        ts->ring = r;
+    }
+
+    // the oldest start time of any announced range query
+    long long getOldestRQStart() {
+        __sync_synchronize();
+        long long result = *timestamp;
+        for (int i=0;i<NUM_PROCESSES;++i) {
+            const long long t = threadState[i].rqStart;
+            if (t < result) result = t;
+        }
+        return result;
+    }
+
+    // retire every node pushed before the oldest announced range query started
+    void prune(const int tid) {
+        ThreadState * const ts = &threadState[tid];
+        ts->sinceLastPrune = 0;
+        const long long bound = getOldestRQStart();
+        Ring * const r = ts->ring;
+        const long long mask = r->capacity - 1;
+        long long tail = ts->tail;
+        while (tail < ts->head && r->entries[tail & mask].pushTime < bound) {
+            recmgr->retire(tid, r->entries[tail & mask].node);
+            ++tail;
+        }
+        ts->tail = tail;
+    }
+
+    inline void push(const int tid, NodeType * const node) {
+        ThreadState * const ts = &threadState[tid];
+        if (ts->head - ts->tail == ts->ring->capacity) {
+            prune(tid);
+            if (ts->head - ts->tail == ts->ring->capacity) grow(tid);
+        }
+        Ring * const r = ts->ring;
+        Entry * const e = &r->entries[ts->head & (r->capacity - 1)];
+        e->node = node;
+        e->pushTime = RQ_LIMBO_NO_RQ; // cannot be retired before its announcement is cleared
+        SOFTWARE_BARRIER;
+        e->dtime = node->dtime;
+        SOFTWARE_BARRIER;
+        ts->head = ts->head + 1;
+    }
+
+public:
+    RQLimbo(const int numProcesses, RecordManager * const _recmgr, volatile long long * const _timestamp)
+            : NUM_PROCESSES(numProcesses), recmgr(_recmgr), timestamp(_timestamp) {
+        threadState = new ThreadState[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            ThreadState * const ts = &threadState[tid];
+            ts->ring = newRing(RQ_LIMBO_INITIAL_CAPACITY, NULL);
+            ts->head = 0;
+            ts->tail = 0;
+            ts->sinceLastPrune = 0;
+            for (int i=0;i<=MAX_NODES_DELETED_ATOMICALLY;++i) {
+                ts->announced[i] = NULL;
+            }
+            ts->rqStart = RQ_LIMBO_NO_RQ;
+        }
+    }
+
+    // nodes still in limbo were never retired, so they are freed here
+    ~RQLimbo() {
+        const int dummyTid = 0;
+        for (int tid=0;tid<NUM_PROCESSES;++tid) {
+            ThreadState * const ts = &threadState[tid];
+            Ring * r = ts->ring;
+            for (long long i=ts->tail;i<ts->head;++i) {
+                recmgr->deallocate(dummyTid, r->entries[i & (r->capacity - 1)].node);
+            }
+            while (r) {
+                Ring * const older = r->older;
+                free(r->entries);
+                delete r;
+                r = older;
+            }
+        }
+        delete[] threadState;
+    }
+
+    // invoke BEFORE a range query reads its linearization time
+    inline void announceRQ(const int tid) {
+        threadState[tid].rqStart = *timestamp;
+        __sync_synchronize();
+    }
+    inline void unannounceRQ(const int tid) {
+        threadState[tid].rqStart = RQ_LIMBO_NO_RQ;
+    }
+
+    // invoke BEFORE deletedNodes (NULL terminated) can be unlinked
+    inline void announceDeletion(const int tid, NodeType * const * const deletedNodes) {
+        ThreadState * const ts = &threadState[tid];
+        int i;
+        for (i=0;deletedNodes[i];++i) {
+            assert(i < MAX_NODES_DELETED_ATOMICALLY);
+            ts->announced[i] = deletedNodes[i];
+        }
+        ts->announced[i] = NULL;
+        __sync_synchronize();
+    }
+    inline void clearAnnouncement(const int tid) {
+        threadState[tid].announced[0] = NULL;
+    }
+
+    // invoke AFTER deletedNodes (NULL terminated) have been unlinked and their dtimes set
+    inline void deletionSucceeded(const int tid, NodeType * const * const deletedNodes) {
+        ThreadState * const ts = &threadState[tid];
+        const long long firstPushed = ts->head;
+        for (int i=0;deletedNodes[i];++i) {
+            push(tid, deletedNodes[i]);
+        }
+        // a scanner that still sees the announcement started before we read the push time below
+        clearAnnouncement(tid);
+        __sync_synchronize();
+        const long long pushTime = *timestamp;
+        Ring * const r = ts->ring;
+        for (long long i=firstPushed;i<ts->head;++i) {
+            r->entries[i & (r->capacity - 1)].pushTime = pushTime;
+        }
+        ts->sinceLastPrune += ts->head - firstPushed;
+        if (ts->sinceLastPrune >= RQ_LIMBO_PRUNE_INTERVAL) prune(tid);
+    }
+
+    /**
+     * invoke visit(node) for every announced or limbo node whose dtime is at
+     * least lin_time. the caller must have announced its range query before
+     * reading lin_time, and must finish its traversal before calling this.
+     * announcements are scanned before rings: a node whose announcement is
+     * cleared has already been pushed.
+     */
+    template <typename Visitor>
+    void visitDeletedSince(const long long lin_time, Visitor visit) {
+        for (int i=0;i<NUM_PROCESSES;++i) {
+            ThreadState * const ts = &threadState[i];
+            for (int j=0;j<MAX_NODES_DELETED_ATOMICALLY;++j) {
+                NodeType * const node = ts->announced[j];
+                if (node == NULL) break;
+                visit(node);
+            }
+        }
+        SOFTWARE_BARRIER;
+        for (int i=0;i<NUM_PROCESSES;++i) {
+            ThreadState * const ts = &threadState[i];
+            Ring * const r = ts->ring;
+            SOFTWARE_BARRIER;
+            const long long head = ts->head;
+            const long long tail = ts->tail;
+            const long long mask = r->capacity - 1;
+            // if the owner replaced r since we read it, [tail, head) may not fit in r: scan all of r
+            const long long start = (head - tail < r->capacity) ? tail : head - r->capacity;
+            for (long long j=start;j<head;++j) {
+                Entry * const e = &r->entries[j & mask];
+                const long long dtime = e->dtime;
+                SOFTWARE_BARRIER;
+                // entries with dtime >= lin_time cannot be retired while our rq is announced
+                if (dtime >= lin_time) visit(e->node);
+            }
+        }
+    }
+};
+
+#endif /* RQ_LIMBO_H */
@@ -25,5 +25,11 @@
     //#error NO RQ PROVIDER DEFINED
 #endif
 
+// the providers that stamp nodes with their insertion and deletion times:
+// data structures give their nodes itime and dtime fields only if this is defined
+#if defined RQ_LOCKFREE || defined RQ_RWLOCK || defined RQ_HTM_RWLOCK
+    #define RQ_NODE_TIMESTAMPS
+#endif
+
 #endif /* RQ_PROVIDER_H */
 
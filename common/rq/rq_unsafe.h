@@ -92,7 +92,11 @@ public:
     inline T read_addr(const int tid, T volatile * const addr) {
         return *addr;
     }
-    
+
+    // invoke when a search, or an update that fails because of what it found,
+    // returns a result that depends on whether node is logically deleted
+    inline void search_report(const int tid, NodeType * const node, const bool deleted) {}
+
     // IF DATA STRUCTURE PERFORMS LOGICAL DELETION
     // run some time BEFORE the physical deletion of a node
     // whose key has ALREADY been logically deleted.
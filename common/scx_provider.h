@@ -191,6 +191,13 @@ public:
     bool isSuccessfulLLXResult(scx_handle_t const handle) {
         return (handle != FINALIZED && handle != FAILED);
     }
+
+    // returns true iff no SCX has frozen srcNode since the llx(srcNode) that
+    // returned handle, i.e., everything read from srcNode since then is current.
+    // (a VLX on a set of nodes is a vlx on each of them, done after all their LLXs.)
+    inline bool vlx(NodeT const * const srcNode, scx_handle_t const handle) {
+        return ((tagptr_t) srcNode->scxPtr == (tagptr_t) handle);
+    }
     
     inline void scxInit(const int tid) {
         SCXRecord * scxptr = &DESC1_ARRAY[tid];
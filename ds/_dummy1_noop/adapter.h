@@ -25,6 +25,18 @@ public:
     : recmgr(new RECORD_MANAGER_T(NUM_THREADS, SIGQUIT))
     , NO_VALUE(unused3)
     {}
+    // bulk construction (this data structure never contains any keys)
+    ds_adapter(const int NUM_THREADS,
+               const K& unused1,
+               const K& unused2,
+               const V& unused3,
+               RandomFNV1A * const unused4,
+               K const * keys,
+               V const * values,
+               const size_t size,
+               const int seed)
+    : ds_adapter(NUM_THREADS, unused1, unused2, unused3, unused4)
+    {}
     ~ds_adapter() {
         delete recmgr;
     }
@@ -85,6 +85,26 @@ public:
             setbench_error("NUM_THREADS exceeds MAX_THREADS_POW2");
         }
     }
+    // bulk construction from keys[0..size), which must be sorted and distinct.
+    // the tree is built bottom-up, so its shape depends only on size (seed is unused)
+    ds_adapter(const int NUM_THREADS,
+               const K& KEY_ANY,
+               const K& unused1,
+               const V& unused2,
+               RandomFNV1A * const unused3,
+               K const * keys,
+               V const * values,
+               const size_t size,
+               const int seed)
+    : ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_ANY, keys, (void * const *) values, size, NUM_THREADS))
+    {
+        if (sizeof(V) > sizeof(void *)) {
+            setbench_error("Value type V is too large to fit in void *. This data structure stores all values in fields of type void *, so this is a problem.");
+        }
+        if (NUM_THREADS > MAX_THREADS_POW2) {
+            setbench_error("NUM_THREADS exceeds MAX_THREADS_POW2");
+        }
+    }
     ~ds_adapter() {
         delete ds;
     }
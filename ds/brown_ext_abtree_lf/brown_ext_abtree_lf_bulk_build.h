@@ -0,0 +1,151 @@
+/**
+ * Bottom-up bulk-build of a relaxed (a,b)-tree from sorted, distinct keys.
+ * Shared by every abtree implementation in this directory.
+ *
+ * The shape depends only on the number of keys and DEGREE: leaves are filled
+ * to ABTREE_BULK_FILL_PERCENT of DEGREE, the keys are spread evenly over
+ * them, and each level of internal nodes is built the same way over the
+ * level below, until one node remains. So every build of the same keys
+ * produces the same tree, with all leaves at the same depth.
+ *
+ * Nodes are allocated in DFS pre-order (each node before its children), so
+ * a root-to-leaf path is close together in memory, and a subtree that is
+ * built by one thread occupies a contiguous run of that thread's
+ * allocations. Subtrees with more than ABTREE_BULK_TASK_LEAVES leaves are
+ * built by OpenMP tasks.
+ */
+
+#ifndef ABTREE_BULK_BUILD_H
+#define ABTREE_BULK_BUILD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#ifndef ABTREE_BULK_FILL_PERCENT
+#define ABTREE_BULK_FILL_PERCENT 75
+#endif
+#ifndef ABTREE_BULK_TASK_LEAVES
+#define ABTREE_BULK_TASK_LEAVES 256
+#endif
+
+namespace abtree_ns {
+
+    template <int DEGREE, typename K>
+    struct Node;
+
+    // AllocateNode is invoked as allocateNode(tid) and returns a node whose
+    // scx fields are initialized; the builder sets every other field
+    template <int DEGREE, typename K, class AllocateNode>
+    class BulkBuilder {
+    private:
+        const K * const keys;
+        void * const * const values;
+        const size_t size;
+        AllocateNode allocateNode;
+        std::vector<size_t> levelSize;  // levelSize[0] = #leaves, levelSize.back() = 1
+
+        static inline int getTid() {
+#ifdef _OPENMP
+            return omp_get_thread_num();
+#else
+            return 0;
+#endif
+        }
+
+        // number of leaves in the subtree of node j at level
+        size_t leavesBelow(const int level, const size_t j) {
+            return (j+1) * levelSize[0] / levelSize[level] - j * levelSize[0] / levelSize[level];
+        }
+
+        Node<DEGREE,K> * build(const int level, const size_t j, K * const minKey) {
+            Node<DEGREE,K> * node = allocateNode(getTid());
+            node->weight = true;
+            if (level == 0) {
+                const size_t begin = j * size / levelSize[0];
+                const size_t end = (j+1) * size / levelSize[0];
+                node->leaf = true;
+                node->size = end - begin;
+                for (size_t i=begin;i<end;++i) {
+                    node->keys[i-begin] = keys[i];
+                    node->ptrs[i-begin] = (Node<DEGREE,K> *) values[i];
+                }
+                node->searchKey = keys[begin];
+                *minKey = keys[begin];
+                return node;
+            }
+
+            // children of node j are nodes [begin, end) of the level below
+            const size_t begin = j * levelSize[level-1] / levelSize[level];
+            const size_t end = (j+1) * levelSize[level-1] / levelSize[level];
+            Node<DEGREE,K> * children[DEGREE];
+            K childMin[DEGREE];
+            const bool spawn = leavesBelow(level, j) > ABTREE_BULK_TASK_LEAVES;
+            for (size_t c=begin;c<end;++c) {
+                if (spawn) {
+                    #pragma omp task shared(children, childMin)
+                    children[c-begin] = build(level-1, c, &childMin[c-begin]);
+                } else {
+                    children[c-begin] = build(level-1, c, &childMin[c-begin]);
+                }
+            }
+            if (spawn) {
+                #pragma omp taskwait
+            }
+            node->leaf = false;
+            node->size = end - begin;
+            for (size_t i=0;i<end-begin;++i) {
+                node->ptrs[i] = children[i];
+                if (i > 0) node->keys[i-1] = childMin[i];
+            }
+            node->searchKey = childMin[0];
+            *minKey = childMin[0];
+            return node;
+        }
+
+    public:
+        BulkBuilder(const K * const _keys, void * const * const _values, const size_t _size, AllocateNode _allocateNode)
+        : keys(_keys), values(_values), size(_size), allocateNode(_allocateNode) {
+            const size_t leafFill = std::max(2, DEGREE * ABTREE_BULK_FILL_PERCENT / 100);
+            const size_t internalFill = leafFill;
+            levelSize.push_back((size + leafFill - 1) / leafFill);
+            while (levelSize.back() > 1) {
+                levelSize.push_back((levelSize.back() + internalFill - 1) / internalFill);
+            }
+        }
+
+        /**
+         * Builds the tree with up to numThreads OpenMP threads, and returns
+         * its root. size must be positive. Threads use tids 0, 1, ..., and
+         * call initThread(tid) before they allocate and deinitThread(tid)
+         * when the tree is built.
+         */
+        template <class InitThread, class DeinitThread>
+        Node<DEGREE,K> * run(const int numThreads, InitThread initThread, DeinitThread deinitThread) {
+            Node<DEGREE,K> * root = NULL;
+            K rootMin;
+#ifdef _OPENMP
+            const int ompThreads = std::max(1, std::min(numThreads, omp_get_max_threads()));
+#else
+            const int ompThreads = 1;
+#endif
+            #pragma omp parallel num_threads(ompThreads)
+            {
+                const int tid = getTid();
+                initThread(tid);
+                #pragma omp barrier
+                #pragma omp single
+                root = build(levelSize.size()-1, 0, &rootMin);
+                // the implicit barrier after single waits for every task
+                deinitThread(tid);
+            }
+            return root;
+        }
+    };
+
+} // namespace
+
+#endif /* ABTREE_BULK_BUILD_H */
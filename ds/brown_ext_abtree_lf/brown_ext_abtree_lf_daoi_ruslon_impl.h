@@ -51,11 +51,18 @@
 #include "record_manager.h"
 #include "prefetching.h"
 #include "scx_provider.h"
+#include "brown_ext_abtree_lf_bulk_build.h"
+#include "brown_ext_abtree_lf_search.h"
 
 namespace abtree_ns {
     
     #define MAX_NODE_DEPENDENCIES_PER_SCX 4
 
+    // number of internal nodes a rangeQuery can visit before its scratch space must grow
+    #ifndef ABTREE_RQ_INITIAL_CAPACITY
+    #define ABTREE_RQ_INITIAL_CAPACITY 64
+    #endif
+
     #ifndef TRACE
     #define TRACE if(0)
     #endif
@@ -72,14 +79,14 @@ namespace abtree_ns {
     #define ABTREE_ENABLE_DESTRUCTOR
 
     template <int DEGREE, typename K>
-    struct Node {
+    struct ABTREE_NODE_ALIGNAS Node {
         scx_handle_t volatile scxPtr;
         int leaf; // 0 or 1
         volatile int marked; // 0 or 1
         int weight; // 0 or 1
         int size; // degree of node
         K searchKey;
-        K keys[DEGREE];
+        ABTREE_KEYS_ALIGNAS K keys[KeySlots<DEGREE,K>::value];
         // Node<DEGREE,K> * volatile ptrs[DEGREE];
         std::atomic< Node<DEGREE,K> *>  ptrs[DEGREE];
 
@@ -94,21 +101,11 @@ namespace abtree_ns {
         }
         template <class Compare>
         inline int getChildIndex(const K& key, Compare cmp) {
-            int nkeys = getKeyCount();
-            int retval = 0;
-            while (retval < nkeys && !cmp(key, (const K&) keys[retval])) {
-                ++retval;
-            }
-            return retval;
+            return NodeSearch<DEGREE,K,Compare>::childIndex(keys, getKeyCount(), key, cmp);
         }
         template <class Compare>
         inline int getKeyIndex(const K& key, Compare cmp) {
-            int nkeys = getKeyCount();
-            int retval = 0;
-            while (retval < nkeys && cmp((const K&) keys[retval], key)) {
-                ++retval;
-            }
-            return retval;
+            return NodeSearch<DEGREE,K,Compare>::keyIndex(keys, getKeyCount(), key, cmp);
         }
     };
 
@@ -171,6 +168,28 @@ namespace abtree_ns {
         }
 
         int init[MAX_THREADS_POW2] = {0,};
+
+        // per-thread scratch space for rangeQuery
+        struct RQScratch {
+            PAD;
+            int capacity;                   // max internal nodes one attempt can visit
+            Node<DEGREE,K> ** visited;      // internal nodes LLXed by the current attempt
+            scx_handle_t * handles;         // handles[i] = result of the LLX of visited[i]
+            Node<DEGREE,K> ** stack;        // nodes the current attempt has yet to visit (capacity*DEGREE entries)
+            PAD;
+        };
+        RQScratch rqScratch[MAX_THREADS_POW2];
+
+        void growRQScratch(const int tid) {
+            RQScratch * const rq = &rqScratch[tid];
+            delete[] rq->visited;
+            delete[] rq->handles;
+            delete[] rq->stack;
+            rq->capacity = (rq->capacity == 0) ? ABTREE_RQ_INITIAL_CAPACITY : 2*rq->capacity;
+            rq->visited = new Node<DEGREE,K> * [rq->capacity];
+            rq->handles = new scx_handle_t[rq->capacity];
+            rq->stack = new Node<DEGREE,K> * [rq->capacity*DEGREE];
+        }
 public:
         void * const NO_VALUE;
         const int NUM_PROCESSES;
@@ -232,6 +251,37 @@ public:
             _entry->ptrs[0].store(_entryLeft, std::memory_order_relaxed);
 
             entry = _entry;
+
+            for (int i=0;i<MAX_THREADS_POW2;++i) {
+                rqScratch[i].capacity = 0;
+                rqScratch[i].visited = NULL;
+                rqScratch[i].handles = NULL;
+                rqScratch[i].stack = NULL;
+            }
+        }
+
+        /**
+         * Creates a relaxed (a,b)-tree that contains keys[0..size), which
+         * must be sorted and distinct, with values[0..size), by building it
+         * bottom-up with up to numThreads OpenMP threads (see
+         * brown_ext_abtree_lf_bulk_build.h).
+         */
+        abtree(const int numProcesses,
+                const K anyKey,
+                const K * const keys,
+                void * const * const values,
+                const size_t size,
+                const int numThreads,
+                int suspectedCrashSignal = SIGQUIT)
+        : abtree(numProcesses, anyKey, suspectedCrashSignal)
+        {
+            if (size == 0) return;
+            auto alloc = [this](const int tid) { return allocateNode(tid); };
+            BulkBuilder<DEGREE, K, decltype(alloc)> builder(keys, values, size, alloc);
+            recordmgr->deallocate(0, (Node<DEGREE,K> *) entry->ptrs[0]);
+            entry->ptrs[0] = builder.run(std::min(numThreads, NUM_PROCESSES),
+                    [this](const int tid) { initThread(tid); },
+                    [this](const int tid) { deinitThread(tid); });
         }
     
     #ifdef ABTREE_ENABLE_DESTRUCTOR    
@@ -240,6 +290,11 @@ public:
             freeSubtree(entry, &nodes);
         //    COUTATOMIC("main thread: deleted tree containing "<<nodes<<" nodes" <<sizeof(Node<DEGREE,K>)<<std::endl);
             delete prov;
+            for (int i=0;i<MAX_THREADS_POW2;++i) {
+                delete[] rqScratch[i].visited;
+                delete[] rqScratch[i].handles;
+                delete[] rqScratch[i].stack;
+            }
 //            recordmgr->printStatus();
             delete recordmgr;
         }
@@ -495,9 +550,75 @@ bool abtree_ns::abtree<DEGREE,K,Compare,RecManager>::contains(const int tid, con
     return find(tid, key).second;
 }
 
+/**
+ * Linearizable range query built on LLX/VLX.
+ * Every internal node on a path to a leaf that can hold a key in [lo, hi] is
+ * LLXed before its children are read. (Leaves are immutable, so they need no
+ * LLX.) Once all such leaves are collected, a VLX checks that no SCX changed any
+ * of the LLXed nodes, so the nodes and leaves visited were all in the tree at
+ * once, just before the VLX, which is where the query is linearized.
+ * If an LLX or the VLX fails, the query restarts.
+ * As in find, each child pointer followed is read through recordmgr->read.
+ */
 template<int DEGREE, typename K, class Compare, class RecManager>
 int abtree_ns::abtree<DEGREE,K,Compare,RecManager>::rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, void ** const resultValues) {
-    setbench_error("not implemented");
+    RQScratch * const rq = &rqScratch[tid];
+    if (rq->capacity == 0) growRQScratch(tid);
+
+    while (true) {
+        auto guard = recordmgr->getGuard(tid, true);
+        int cnt = 0;
+        int nVisited = 0;
+        int stackSize = 0;
+        bool overflow = false;
+        bool changed = false;
+        uint64_t idx = 0;
+        rq->stack[stackSize++] = entry;
+        while (stackSize > 0) {
+            Node<DEGREE,K> * const n = rq->stack[--stackSize];
+            if (n->isLeaf()) {
+                for (int i=0;i<n->getKeyCount();++i) {
+                    if (!cmp(n->keys[i], lo) && !cmp(hi, n->keys[i])) {
+                        resultKeys[cnt] = n->keys[i];
+                        resultValues[cnt] = n->ptrs[i];
+                        ++cnt;
+                    }
+                }
+                continue;
+            }
+            if (nVisited == rq->capacity) {
+                overflow = true;
+                break;
+            }
+            auto llxResult = prov->llx(tid, n);
+            if (!prov->isSuccessfulLLXResult(llxResult)) {
+                changed = true;
+                break;
+            }
+            rq->visited[nVisited] = n;
+            rq->handles[nVisited] = llxResult;
+            ++nVisited;
+
+            // push the children whose key ranges intersect [lo, hi], leftmost on top
+            const int first = n->getChildIndex(lo, cmp);
+            const int last = n->getChildIndex(hi, cmp);
+            for (int i=last;i>=first;--i) {
+#ifdef DAOI_RUSLONRDPTR_RECLAIMERS
+                rq->stack[stackSize++] = recordmgr->readByPtrToTypeAndPtr(tid, (idx++%3), n->ptrs[i], n);
+#else
+                rq->stack[stackSize++] = recordmgr->read(tid, (idx++%3), n->ptrs[i]);
+#endif
+            }
+        }
+        if (overflow) {
+            growRQScratch(tid);
+            continue;
+        }
+        for (int i=0;i<nVisited && !changed;++i) {
+            changed = !prov->vlx(rq->visited[i], rq->handles[i]);
+        }
+        if (!changed) return cnt;
+    }
 }
 
 
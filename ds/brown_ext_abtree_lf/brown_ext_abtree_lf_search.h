@@ -0,0 +1,170 @@
+/**
+ * Key search inside (a,b)-tree nodes. Shared by every abtree implementation
+ * in this directory.
+ *
+ * Keys in a node are sorted, so the child index of a key (the number of
+ * keys <= it) and its key index (the number of keys < it) are counts. When
+ * Compare is std::less<K> and K is integral, the counts are computed without
+ * branches: the node's key slots are compared with the key all at once
+ * (with AVX2 or SSE4.2 when the compiler targets them, for 4 and 8 byte
+ * signed keys), the resulting bitmask is truncated to the node's key count,
+ * and its bits are counted. Otherwise the original scan is used.
+ *
+ * ABTREE_SIMD_LAYOUT pads each node's keys to a whole number of 32 byte
+ * vectors, aligns them to 32 bytes and aligns nodes to cache lines (build
+ * with -faligned-new under C++14). With FAT_NODE_DEGREE 16 and 8 byte keys,
+ * the keys of a node fill exactly two cache lines.
+ */
+
+#ifndef ABTREE_SEARCH_H
+#define ABTREE_SEARCH_H
+
+#include <functional>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#   include <immintrin.h>
+#endif
+
+#ifdef ABTREE_SIMD_LAYOUT
+#   define ABTREE_NODE_ALIGNAS alignas(64)
+#   define ABTREE_KEYS_ALIGNAS alignas(32)
+#else
+#   define ABTREE_NODE_ALIGNAS
+#   define ABTREE_KEYS_ALIGNAS
+#endif
+
+namespace abtree_ns {
+
+    // number of key slots in a node
+    template <int DEGREE, typename K>
+    struct KeySlots {
+#ifdef ABTREE_SIMD_LAYOUT
+        static const int value = (DEGREE * sizeof(K) + 31) / 32 * 32 / sizeof(K);
+#else
+        static const int value = DEGREE;
+#endif
+    };
+
+    // generic search: scan until the first key that is too large
+    template <int DEGREE, typename K, class Compare,
+              bool Branchless = std::is_integral<K>::value && std::is_same<Compare, std::less<K> >::value>
+    struct NodeSearch {
+        static inline int childIndex(const K * const keys, const int nkeys, const K& key, Compare cmp) {
+            int retval = 0;
+            while (retval < nkeys && !cmp(key, (const K&) keys[retval])) {
+                ++retval;
+            }
+            return retval;
+        }
+        static inline int keyIndex(const K * const keys, const int nkeys, const K& key, Compare cmp) {
+            int retval = 0;
+            while (retval < nkeys && cmp((const K&) keys[retval], key)) {
+                ++retval;
+            }
+            return retval;
+        }
+    };
+
+    // branchless search for integral keys ordered by std::less
+    template <int DEGREE, typename K, class Compare>
+    struct NodeSearch<DEGREE, K, Compare, true> {
+    private:
+        static const int SLOTS = KeySlots<DEGREE, K>::value;
+        static_assert(SLOTS <= 64, "branchless node search supports at most 64 key slots");
+
+        // bit i is set iff keys[i] > key, for every slot i
+        static inline unsigned long long greaterMask(const K * const keys, const K key) {
+            unsigned long long mask = 0;
+            int i = 0;
+#if defined(__AVX2__)
+            if (sizeof(K) == 8 && std::is_signed<K>::value) {
+                const __m256i k = _mm256_set1_epi64x((long long) key);
+                for (;i+4<=SLOTS;i+=4) {
+                    const __m256i v = _mm256_loadu_si256((const __m256i *) (keys+i));
+                    mask |= (unsigned long long) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k))) << i;
+                }
+            } else if (sizeof(K) == 4 && std::is_signed<K>::value) {
+                const __m256i k = _mm256_set1_epi32((int) key);
+                for (;i+8<=SLOTS;i+=8) {
+                    const __m256i v = _mm256_loadu_si256((const __m256i *) (keys+i));
+                    mask |= (unsigned long long) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, k))) << i;
+                }
+            }
+#elif defined(__SSE4_2__)
+            if (sizeof(K) == 8 && std::is_signed<K>::value) {
+                const __m128i k = _mm_set1_epi64x((long long) key);
+                for (;i+2<=SLOTS;i+=2) {
+                    const __m128i v = _mm_loadu_si128((const __m128i *) (keys+i));
+                    mask |= (unsigned long long) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, k))) << i;
+                }
+            } else if (sizeof(K) == 4 && std::is_signed<K>::value) {
+                const __m128i k = _mm_set1_epi32((int) key);
+                for (;i+4<=SLOTS;i+=4) {
+                    const __m128i v = _mm_loadu_si128((const __m128i *) (keys+i));
+                    mask |= (unsigned long long) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k))) << i;
+                }
+            }
+#endif
+            for (;i<SLOTS;++i) {
+                mask |= (unsigned long long) (keys[i] > key) << i;
+            }
+            return mask;
+        }
+
+        // bit i is set iff keys[i] < key, for every slot i
+        static inline unsigned long long lessMask(const K * const keys, const K key) {
+            unsigned long long mask = 0;
+            int i = 0;
+#if defined(__AVX2__)
+            if (sizeof(K) == 8 && std::is_signed<K>::value) {
+                const __m256i k = _mm256_set1_epi64x((long long) key);
+                for (;i+4<=SLOTS;i+=4) {
+                    const __m256i v = _mm256_loadu_si256((const __m256i *) (keys+i));
+                    mask |= (unsigned long long) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))) << i;
+                }
+            } else if (sizeof(K) == 4 && std::is_signed<K>::value) {
+                const __m256i k = _mm256_set1_epi32((int) key);
+                for (;i+8<=SLOTS;i+=8) {
+                    const __m256i v = _mm256_loadu_si256((const __m256i *) (keys+i));
+                    mask |= (unsigned long long) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))) << i;
+                }
+            }
+#elif defined(__SSE4_2__)
+            if (sizeof(K) == 8 && std::is_signed<K>::value) {
+                const __m128i k = _mm_set1_epi64x((long long) key);
+                for (;i+2<=SLOTS;i+=2) {
+                    const __m128i v = _mm_loadu_si128((const __m128i *) (keys+i));
+                    mask |= (unsigned long long) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))) << i;
+                }
+            } else if (sizeof(K) == 4 && std::is_signed<K>::value) {
+                const __m128i k = _mm_set1_epi32((int) key);
+                for (;i+4<=SLOTS;i+=4) {
+                    const __m128i v = _mm_loadu_si128((const __m128i *) (keys+i));
+                    mask |= (unsigned long long) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v))) << i;
+                }
+            }
+#endif
+            for (;i<SLOTS;++i) {
+                mask |= (unsigned long long) (keys[i] < key) << i;
+            }
+            return mask;
+        }
+
+        // bits [0, nkeys)
+        static inline unsigned long long prefixMask(const int nkeys) {
+            return (nkeys >= 64) ? ~0ULL : ((1ULL << nkeys) - 1);
+        }
+
+    public:
+        // slots at and beyond nkeys may hold stale keys; their bits are masked off
+        static inline int childIndex(const K * const keys, const int nkeys, const K& key, Compare cmp) {
+            return __builtin_popcountll(~greaterMask(keys, key) & prefixMask(nkeys));
+        }
+        static inline int keyIndex(const K * const keys, const int nkeys, const K& key, Compare cmp) {
+            return __builtin_popcountll(lessMask(keys, key) & prefixMask(nkeys));
+        }
+    };
+
+} // namespace
+
+#endif /* ABTREE_SEARCH_H */
@@ -20,8 +20,9 @@
 
 #if defined (OOI_RECLAIMERS) || defined (OOI_POP_RECLAIMERS)
     #include "ticket_ooi_impl.h"
-    #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, node_t<K,V>>
+    #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, node_t<K,V> RQ_SNAPCOLLECTOR_OBJECT_TYPES>
     #define DATA_STRUCTURE_T ticketOOI<K, V, RECORD_MANAGER_T>
+    #define TICKET_HAS_RANGE_QUERY
 #elif NZB_RECLAIMERS
     #include "ticket_nzb_impl.h"
     #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, node_t<K,V>>
@@ -75,6 +76,20 @@ public:
     : NO_VALUE(VALUE_RESERVED)
     , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, NO_VALUE, 0 /* unused */))
     {}
+    // bulk construction from keys[0..size), which must be sorted and distinct.
+    // the tree is built bottom-up, so its shape depends only on size (seed is unused)
+    ds_adapter(const int NUM_THREADS,
+               const K& KEY_MIN,
+               const K& KEY_MAX,
+               const V& VALUE_RESERVED,
+               RandomFNV1A * const unused2,
+               K const * keys,
+               V const * values,
+               const size_t size,
+               const int seed)
+    : NO_VALUE(VALUE_RESERVED)
+    , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, NO_VALUE, 0 /* unused */, keys, values, size, NUM_THREADS))
+    {}
     ~ds_adapter() {
         delete ds;
     }
@@ -106,7 +121,11 @@ public:
         return find(tid, key) != getNoValue();
     }
     int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
+#ifdef TICKET_HAS_RANGE_QUERY
+        return ds->rangeQuery(tid, lo, hi, resultKeys, resultValues);
+#else
         setbench_error("not implemented");
+#endif
     }
     void printSummary() {
         auto recmgr = ds->debugGetRecMgr();
@@ -0,0 +1,110 @@
+/**
+ * Bottom-up bulk-build of the external BST from sorted, distinct keys.
+ * Shared by every ticket implementation in this directory.
+ *
+ * The leaves are the KEY_MIN sentinel followed by one leaf per key, and each
+ * internal node splits its leaves in half, with the key of the first leaf of
+ * its right half as its routing key. So the tree is perfectly balanced, and
+ * its shape depends only on the number of keys.
+ *
+ * Nodes are allocated in DFS pre-order (each node before its children), so
+ * a root-to-leaf path is close together in memory, and a subtree that is
+ * built by one thread occupies a contiguous run of that thread's
+ * allocations. Subtrees with more than TICKET_BULK_TASK_LEAVES leaves are
+ * built by OpenMP tasks.
+ */
+
+#ifndef TICKET_BULK_BUILD_H
+#define TICKET_BULK_BUILD_H
+
+#include <algorithm>
+#include <cstddef>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#ifndef TICKET_BULK_TASK_LEAVES
+#define TICKET_BULK_TASK_LEAVES 4096
+#endif
+
+template <typename skey_t, typename sval_t>
+struct node_t;
+
+// NewNode is invoked as newNode(tid, key, val, left, right), like new_node
+template <typename skey_t, typename sval_t, class NewNode>
+class TicketBulkBuilder {
+private:
+    const skey_t * const keys;
+    const sval_t * const values;
+    const size_t size;
+    const sval_t NO_VALUE;
+    node_t<skey_t, sval_t> * const minLeaf;
+    NewNode newNode;
+
+    static inline int getTid() {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    // leaf 0 is minLeaf, and leaf i > 0 holds keys[i-1]
+    node_t<skey_t, sval_t> * build(const size_t begin, const size_t end) {
+        const int tid = getTid();
+        if (end - begin == 1) {
+            if (begin == 0) return minLeaf;
+            return newNode(tid, keys[begin-1], values[begin-1], NULL, NULL);
+        }
+        const size_t mid = begin + (end - begin) / 2;
+        node_t<skey_t, sval_t> * node = newNode(tid, keys[mid-1], NO_VALUE, NULL, NULL);
+        node_t<skey_t, sval_t> * left;
+        node_t<skey_t, sval_t> * right;
+        if (end - begin > TICKET_BULK_TASK_LEAVES) {
+            #pragma omp task shared(left)
+            left = build(begin, mid);
+            right = build(mid, end);
+            #pragma omp taskwait
+        } else {
+            left = build(begin, mid);
+            right = build(mid, end);
+        }
+        node->left = left;
+        node->right = right;
+        return node;
+    }
+
+public:
+    TicketBulkBuilder(const skey_t * const _keys, const sval_t * const _values, const size_t _size,
+            const sval_t _NO_VALUE, node_t<skey_t, sval_t> * const _minLeaf, NewNode _newNode)
+    : keys(_keys), values(_values), size(_size), NO_VALUE(_NO_VALUE), minLeaf(_minLeaf), newNode(_newNode) {}
+
+    /**
+     * Builds the tree with up to numThreads OpenMP threads, and returns its
+     * root, which replaces minLeaf as the left child of the root sentinel.
+     * Threads use tids 0, 1, ..., and call initThread(tid) before they
+     * allocate and deinitThread(tid) when the tree is built.
+     */
+    template <class InitThread, class DeinitThread>
+    node_t<skey_t, sval_t> * run(const int numThreads, InitThread initThread, DeinitThread deinitThread) {
+        node_t<skey_t, sval_t> * root = NULL;
+#ifdef _OPENMP
+        const int ompThreads = std::max(1, std::min(numThreads, omp_get_max_threads()));
+#else
+        const int ompThreads = 1;
+#endif
+        #pragma omp parallel num_threads(ompThreads)
+        {
+            const int tid = getTid();
+            initThread(tid);
+            #pragma omp barrier
+            #pragma omp single
+            root = build(0, size+1);
+            // the implicit barrier after single waits for every task
+            deinitThread(tid);
+        }
+        return root;
+    }
+};
+
+#endif /* TICKET_BULK_BUILD_H */
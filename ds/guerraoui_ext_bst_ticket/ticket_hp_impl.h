@@ -35,6 +35,7 @@
 #define TICKET_HP_RECLAIMER_H
 
 #include "record_manager.h"
+#include "ticket_bulk_build.h"
 
 #define likely(x)       __builtin_expect((x), 1)
 #define unlikely(x)     __builtin_expect((x), 0)
@@ -218,6 +219,23 @@ public:
         root = new_node(tid, KEY_MAX, NO_VALUE, _min, _max);
     }
 
+    // contains keys[0..size), which must be sorted and distinct, with
+    // values[0..size); built bottom-up with up to numThreads OpenMP threads
+    // (see ticket_bulk_build.h)
+    ticketHP(const int _NUM_THREADS, const skey_t& _KEY_MIN, const skey_t& _KEY_MAX, const sval_t& _VALUE_RESERVED, unsigned int id,
+            const skey_t * keys, const sval_t * values, const size_t size, const int numThreads)
+    : ticketHP(_NUM_THREADS, _KEY_MIN, _KEY_MAX, _VALUE_RESERVED, id) {
+        if (size == 0) return;
+        auto alloc = [this](const int tid, skey_t key, sval_t val, node_t<skey_t, sval_t>* l, node_t<skey_t, sval_t>* r) {
+            return new_node(tid, key, val, l, r);
+        };
+        node_t<skey_t, sval_t>* _min = get_root()->left;
+        TicketBulkBuilder<skey_t, sval_t, decltype(alloc)> builder(keys, values, size, NO_VALUE, _min, alloc);
+        get_root()->left = builder.run(std::min(numThreads, NUM_THREADS),
+                [this](const int tid) { initThread(tid); },
+                [this](const int tid) { deinitThread(tid); });
+    }
+
     ~ticketHP() {
         recmgr->printStatus();
         delete recmgr;
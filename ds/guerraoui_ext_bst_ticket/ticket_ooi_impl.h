@@ -29,16 +29,30 @@
  * Substantial improvements to interface, memory reclamation and bug fixing.
  *
  * Created on June 7, 2017, 1:38 PM
+ *
+ * range queries are linearizable with every RQProvider in common/rq (see rq_provider.h):
+ * all reads of left, right and marked go through the provider, and the linearization
+ * points of insert (the write to pred->left/right) and delete (the write to curr->marked,
+ * which logically deletes the leaf while ppred and pred are locked) are performed by the
+ * provider.
  */
 
 #ifndef TICKET_OP_ONLY_INSTR_RECLAIMER_H
 #define TICKET_OP_ONLY_INSTR_RECLAIMER_H
 
+#include <algorithm>
 #include "record_manager.h"
+#include "rq_provider.h"
+#include "ticket_bulk_build.h"
 
 #define likely(x)       __builtin_expect((x), 1)
 #define unlikely(x)     __builtin_expect((x), 0)
 
+// number of nodes a rangeQuery can have yet to visit before its stack must grow
+#ifndef TICKET_RQ_INITIAL_CAPACITY
+#define TICKET_RQ_INITIAL_CAPACITY 64
+#endif
+
 #if !defined(COMPILER_BARRIER)
 #define COMPILER_BARRIER asm volatile ("" ::: "memory")
 #endif
@@ -125,6 +139,11 @@ struct node_t {
     struct node_t<skey_t, sval_t> * volatile left;
     struct node_t<skey_t, sval_t> * volatile right;
     volatile tl_t lock;
+    volatile long long marked; // set when the leaf is deleted (a long long so the lock-free RQProvider can write it)
+#ifdef RQ_NODE_TIMESTAMPS
+    volatile long long itime; // for use by range query algorithm
+    volatile long long dtime; // for use by range query algorithm
+#endif
 #ifdef USE_PADDING
     char pad[PAD_SIZE];
 #endif
@@ -145,17 +164,56 @@ PAD;
     const sval_t NO_VALUE;
 PAD;
     RecMgr * const recmgr;
+PAD;
+    RQProvider<skey_t, sval_t, node_t<skey_t, sval_t>, ticketOOI<skey_t, sval_t, RecMgr>, RecMgr, true, false> * const rqProvider;
 PAD;
     int init[MAX_THREADS_POW2] = {0,};
 PAD;
+    // per-thread stack of nodes a rangeQuery has yet to visit
+    struct RQStack {
+        PAD;
+        int capacity;
+        node_t<skey_t, sval_t> ** nodes;
+        PAD;
+    };
+    RQStack rqStack[MAX_THREADS_POW2];
+
+    void growRQStack(const int tid, const int size) {
+        RQStack * const rq = &rqStack[tid];
+        const int capacity = (rq->capacity == 0) ? TICKET_RQ_INITIAL_CAPACITY : 2*rq->capacity;
+        node_t<skey_t, sval_t> ** const nodes = new node_t<skey_t, sval_t> * [capacity];
+        std::copy(rq->nodes, rq->nodes+size, nodes);
+        delete[] rq->nodes;
+        rq->capacity = capacity;
+        rq->nodes = nodes;
+    }
 
     node_t<skey_t, sval_t>* new_node(const int tid, skey_t key, sval_t val, node_t<skey_t, sval_t>* l, node_t<skey_t, sval_t>* r);
     node_t<skey_t, sval_t>* new_node_no_init(const int tid);
 
+#ifdef RQ_NODE_TIMESTAMPS
+    // gives every leaf of a bulk-built subtree that is not yet reachable an
+    // insertion time, so range queries return its key
+    void stampBulkLeaves(const int tid, node_t<skey_t, sval_t>* node) {
+        while (node->left != NULL) {
+            stampBulkLeaves(tid, node->left);
+            node = node->right;
+        }
+        node_t<skey_t, sval_t>* insertedNodes[] = {node, NULL};
+        node_t<skey_t, sval_t>* deletedNodes[] = {NULL};
+        rqProvider->linearize_update_at_write(tid, &node->marked, 0LL, insertedNodes, deletedNodes);
+    }
+#endif
+
 public:
 
     ticketOOI(const int _NUM_THREADS, const skey_t& _KEY_MIN, const skey_t& _KEY_MAX, const sval_t& _VALUE_RESERVED, unsigned int id)
-    : NUM_THREADS(_NUM_THREADS), KEY_MIN(_KEY_MIN), KEY_MAX(_KEY_MAX), NO_VALUE(_VALUE_RESERVED), idx_id(id), recmgr(new RecMgr(NUM_THREADS, SIGQUIT)) {
+    : NUM_THREADS(_NUM_THREADS), KEY_MIN(_KEY_MIN), KEY_MAX(_KEY_MAX), NO_VALUE(_VALUE_RESERVED), idx_id(id), recmgr(new RecMgr(NUM_THREADS, SIGQUIT))
+    , rqProvider(new RQProvider<skey_t, sval_t, node_t<skey_t, sval_t>, ticketOOI<skey_t, sval_t, RecMgr>, RecMgr, true, false>(NUM_THREADS, this, recmgr)) {
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            rqStack[i].capacity = 0;
+            rqStack[i].nodes = NULL;
+        }
         const int tid = 0;
         initThread(tid);
 
@@ -166,22 +224,52 @@ public:
         root = new_node(tid, KEY_MAX, NO_VALUE, _min, _max);
     }
 
+    // contains keys[0..size), which must be sorted and distinct, with
+    // values[0..size); built bottom-up with up to numThreads OpenMP threads
+    // (see ticket_bulk_build.h)
+    ticketOOI(const int _NUM_THREADS, const skey_t& _KEY_MIN, const skey_t& _KEY_MAX, const sval_t& _VALUE_RESERVED, unsigned int id,
+            const skey_t * keys, const sval_t * values, const size_t size, const int numThreads)
+    : ticketOOI(_NUM_THREADS, _KEY_MIN, _KEY_MAX, _VALUE_RESERVED, id) {
+        if (size == 0) return;
+        auto alloc = [this](const int tid, skey_t key, sval_t val, node_t<skey_t, sval_t>* l, node_t<skey_t, sval_t>* r) {
+            return new_node(tid, key, val, l, r);
+        };
+        node_t<skey_t, sval_t>* _min = get_root()->left;
+        TicketBulkBuilder<skey_t, sval_t, decltype(alloc)> builder(keys, values, size, NO_VALUE, _min, alloc);
+        node_t<skey_t, sval_t>* subtree = builder.run(std::min(numThreads, NUM_THREADS),
+                [this](const int tid) { initThread(tid); },
+                [this](const int tid) { deinitThread(tid); });
+#ifdef RQ_NODE_TIMESTAMPS
+        initThread(0);
+        stampBulkLeaves(0, subtree);
+        deinitThread(0);
+#endif
+        get_root()->left = subtree;
+    }
+
     ~ticketOOI() {
+        delete rqProvider; // frees any deleted nodes it still holds
+        for (int i=0;i<MAX_THREADS_POW2;++i) {
+            delete[] rqStack[i].nodes;
+        }
         recmgr->printStatus();
         delete recmgr;
     }
 
     void initThread(const int tid) {
         recmgr->initThread(tid);
+        rqProvider->initThread(tid);
     }
 
     void deinitThread(const int tid) {
+        rqProvider->deinitThread(tid);
         recmgr->deinitThread(tid);
     }
 
     sval_t bst_tk_find(const int tid, skey_t key);
     sval_t bst_tk_insert(const int tid, skey_t key, sval_t val);
     sval_t bst_tk_delete(const int tid, skey_t key);
+    int rangeQuery(const int tid, const skey_t& lo, const skey_t& hi, skey_t * const resultKeys, sval_t * const resultValues);
 
     node_t<skey_t, sval_t> * get_root() {
         return root;
@@ -190,6 +278,31 @@ public:
     RecMgr * debugGetRecMgr() {
         return recmgr;
     }
+
+    /**
+     * BEGIN FUNCTIONS FOR RANGE QUERY SUPPORT
+     */
+
+    inline bool isLogicallyDeleted(const int tid, node_t<skey_t, sval_t> * node) {
+        return rqProvider->read_addr(tid, &node->marked) != 0;
+    }
+
+    // only leaves hold keys, and the sentinel leaves hold none
+    inline int getKeys(const int tid, node_t<skey_t, sval_t> * node, skey_t * const outputKeys, sval_t * const outputValues) {
+        if (rqProvider->read_addr(tid, &node->left) != NULL) return 0;
+        if (node->key == KEY_MIN || node->key == KEY_MAX) return 0;
+        outputKeys[0] = node->key;
+        outputValues[0] = node->val;
+        return 1;
+    }
+
+    bool isInRange(const skey_t& key, const skey_t& lo, const skey_t& hi) {
+        return (lo <= key && key <= hi);
+    }
+
+    /**
+     * END FUNCTIONS FOR RANGE QUERY SUPPORT
+     */
 };
 
 template <typename skey_t, typename sval_t, class RecMgr>
@@ -197,8 +310,8 @@ node_t<skey_t, sval_t>* ticketOOI<skey_t, sval_t, RecMgr>::new_node(const int ti
     auto node = new_node_no_init(tid);
     node->val = val;
     node->key = key;
-    node->left = l;
-    node->right = r;
+    rqProvider->write_addr(tid, &node->left, l);
+    rqProvider->write_addr(tid, &node->right, r);
     return node;
 }
 
@@ -209,8 +322,10 @@ node_t<skey_t, sval_t>* ticketOOI<skey_t, sval_t, RecMgr>::new_node_no_init(cons
         perror("malloc @ new_node");
         exit(1);
     }
+    rqProvider->init_node(tid, node);
     node->lock.to_uint64 = 0;
     node->val = NO_VALUE;
+    rqProvider->write_addr(tid, &node->marked, 0LL);
     return node;
 }
 
@@ -220,16 +335,18 @@ sval_t ticketOOI<skey_t, sval_t, RecMgr>::bst_tk_find(const int tid, skey_t key)
     auto guard = recmgr->getGuard(tid, true);
     node_t<skey_t, sval_t>* curr = root;
 
-    while (likely(curr->left != NULL)) {
+    while (likely(rqProvider->read_addr(tid, &curr->left) != NULL)) {
         if (key < curr->key) {
-            curr = curr->left;
+            curr = rqProvider->read_addr(tid, &curr->left);
         } else {
-            curr = curr->right;
+            curr = rqProvider->read_addr(tid, &curr->right);
         }
     }
 
     if (curr->key == key) {
-        return curr->val;
+        const bool deleted = isLogicallyDeleted(tid, curr);
+        rqProvider->search_report(tid, curr, deleted);
+        if (!deleted) return curr->val;
     }
 
     return NO_VALUE;
@@ -257,12 +374,12 @@ retry:
 
             if (key < curr->key) {
                 right = 0;
-                curr = curr->left;
+                curr = rqProvider->read_addr(tid, &curr->left);
             } else {
                 right = 1;
-                curr = curr->right;
+                curr = rqProvider->read_addr(tid, &curr->right);
             }
-        } while (likely(curr->left != NULL));
+        } while (likely(rqProvider->read_addr(tid, &curr->left) != NULL));
 
         // #ifdef GARBAGE_BOUND_EXP
         //     if (tid == 1)
@@ -276,6 +393,10 @@ retry:
         neutralizable back to False*/
         if (curr->key == key) {
             // insert if absent
+            if (isLogicallyDeleted(tid, curr)) {
+                goto retry; // its delete is about to unlink it
+            }
+            rqProvider->search_report(tid, curr, false);
             return curr->val;
         }
 
@@ -294,19 +415,17 @@ retry:
 
         if (key < curr->key) {
             nr->key = curr->key;
-            nr->left = nn;
-            nr->right = curr;
+            rqProvider->write_addr(tid, &nr->left, nn);
+            rqProvider->write_addr(tid, &nr->right, curr);
         } else {
             nr->key = key;
-            nr->left = curr;
-            nr->right = nn;
+            rqProvider->write_addr(tid, &nr->left, curr);
+            rqProvider->write_addr(tid, &nr->right, nn);
         }
 
-        if (right) {
-            pred->right = nr;
-        } else {
-            pred->left = nr;
-        }
+        node_t<skey_t, sval_t>* insertedNodes[] = {nn, nr, NULL};
+        node_t<skey_t, sval_t>* deletedNodes[] = {NULL};
+        rqProvider->linearize_update_at_write(tid, (right ? &pred->right : &pred->left), nr, insertedNodes, deletedNodes); // LINEARIZATION POINT
 
         tl_unlock(&pred->lock, right);
         return NO_VALUE;
@@ -341,12 +460,12 @@ sval_t ticketOOI<skey_t, sval_t, RecMgr>::bst_tk_delete(const int tid, skey_t ke
 
             if (key < curr->key) {
                 right = 0;
-                curr = curr->left;
+                curr = rqProvider->read_addr(tid, &curr->left);
             } else {
                 right = 1;
-                curr = curr->right;
+                curr = rqProvider->read_addr(tid, &curr->right);
             }
-        } while (likely(curr->left != NULL));
+        } while (likely(rqProvider->read_addr(tid, &curr->left) != NULL));
 
         // #ifdef GARBAGE_BOUND_EXP
         //     if (tid == 1)
@@ -368,28 +487,52 @@ sval_t ticketOOI<skey_t, sval_t, RecMgr>::bst_tk_delete(const int tid, skey_t ke
             goto retry;
         }
 
-        if (pright) {
-            if (right) {
-                ppred->right = pred->left;
-            } else {
-                ppred->right = pred->right;
-            }
+        const sval_t result = curr->val;
+        node_t<skey_t, sval_t>* sibling = rqProvider->read_addr(tid, (right ? &pred->left : &pred->right));
 
+        node_t<skey_t, sval_t>* insertedNodes[] = {NULL};
+        node_t<skey_t, sval_t>* deletedNodes[] = {curr, pred, NULL};
+        rqProvider->linearize_update_at_write(tid, &curr->marked, 1LL, insertedNodes, deletedNodes); // LINEARIZATION POINT
+        rqProvider->announce_physical_deletion(tid, deletedNodes);
+        if (pright) {
+            ppred->right = sibling;
         } else {
-            if (right) {
-                ppred->left = pred->left;
-            } else {
-                ppred->left = pred->right;
-            }
+            ppred->left = sibling;
         }
+        rqProvider->physical_deletion_succeeded(tid, deletedNodes); // retires curr and pred
 
         tl_unlock(&ppred->lock, pright);
 
-        recmgr->retire(tid, curr);
-        recmgr->retire(tid, pred);
-        
-        return curr->val;
+        return result;
+    }
+}
+
+template <typename skey_t, typename sval_t, class RecMgr>
+int ticketOOI<skey_t, sval_t, RecMgr>::rangeQuery(const int tid, const skey_t& lo, const skey_t& hi, skey_t * const resultKeys, sval_t * const resultValues) {
+    auto guard = recmgr->getGuard(tid, true);
+    rqProvider->traversal_start(tid);
+    int cnt = 0;
+    int size = 0;
+    if (rqStack[tid].capacity < 2) growRQStack(tid, size);
+    node_t<skey_t, sval_t> ** stack = rqStack[tid].nodes;
+    stack[size++] = root;
+    while (size > 0) {
+        node_t<skey_t, sval_t>* node = stack[--size];
+        node_t<skey_t, sval_t>* left = rqProvider->read_addr(tid, &node->left);
+        if (left == NULL) {
+            rqProvider->traversal_try_add(tid, node, resultKeys, resultValues, &cnt, lo, hi);
+            continue;
+        }
+        // keys in the left subtree are < node->key, and keys in the right subtree are >= it
+        if (size+2 > rqStack[tid].capacity) {
+            growRQStack(tid, size);
+            stack = rqStack[tid].nodes;
+        }
+        if (hi >= node->key) stack[size++] = rqProvider->read_addr(tid, &node->right);
+        if (lo < node->key) stack[size++] = left;
     }
+    rqProvider->traversal_end(tid, resultKeys, resultValues, &cnt, lo, hi);
+    return cnt;
 }
 
 #endif /* TICKET_OP_ONLY_INSTR_RECLAIMER_H */
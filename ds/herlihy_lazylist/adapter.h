@@ -18,14 +18,16 @@
 #include <csignal>
 #include "errors.h"
 #include "random_fnv1a.h"
+#include "bulk_insert.h"
 #ifdef USE_TREE_STATS
 #   include "tree_stats.h"
 #endif
 
 #if defined (OOI_RECLAIMERS) || defined (OOI_POP_RECLAIMERS)
     #include "lazylist_ooi_impl.h"
-    #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, node_t<K,V>>
+    #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, node_t<K,V> RQ_SNAPCOLLECTOR_OBJECT_TYPES>
     #define DATA_STRUCTURE_T lazylistOOI<K, V, RECORD_MANAGER_T>
+    #define LAZYLIST_HAS_RANGE_QUERY
 #elif NZB_RECLAIMERS
     #include "lazylist_nzb_impl.h"
     #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, node_t<K,V>>
@@ -86,6 +88,21 @@ public:
     , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, NO_VALUE, 0 /* unused */))
     { }
     
+    // bulk construction from keys[0..size), which must be sorted and distinct
+    ds_adapter(const int NUM_THREADS,
+               const K& KEY_MIN,
+               const K& KEY_MAX,
+               const V& VALUE_RESERVED,
+               RandomFNV1A * const unused2,
+               K const * keys,
+               V const * values,
+               const size_t size,
+               const int seed)
+    : ds_adapter(NUM_THREADS, KEY_MIN, KEY_MAX, VALUE_RESERVED, unused2)
+    {
+        bulkInsertSorted(this, NUM_THREADS, keys, values, size);
+    }
+    
     ~ds_adapter() {
         delete ds;
     }
@@ -121,7 +138,11 @@ public:
         return ds->contains(tid, key);
     }
     int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
+#ifdef LAZYLIST_HAS_RANGE_QUERY
+        return ds->rangeQuery(tid, lo, hi, resultKeys, resultValues);
+#else
         setbench_error("not implemented");
+#endif
     }
     void printSummary() {
         ds->debugKeySum();
@@ -9,12 +9,18 @@
  *   Vasileios Trigonakis http://lpd.epfl.ch/site/ascylib - http://lpd.epfl.ch/site/optik
  * 
  * the lazylistOOI version implements operation only instrumentation based reclaimers like: debra
+ *
+ * range queries are linearizable with every RQProvider in common/rq (see rq_provider.h):
+ * all reads of next and marked go through the provider, and the linearization points
+ * of insert (the write to pred->next) and erase (the write to curr->marked) are
+ * performed by the provider.
  */
 
 #ifndef LAZYLIST_OOI_IMPL_H
 #define LAZYLIST_OOI_IMPL_H
 
 #include "record_manager.h"
+#include "rq_provider.h"
 #include <string>
 using namespace std;
 
@@ -26,6 +32,10 @@ public:
     node_t<K,V> * volatile next;
     volatile int lock;
     volatile long long marked; // is stored as a long long simply so it is large enough to be used with the lock-free RQProvider (which requires all fields that are modified at linearization points of operations to be at least as large as a machine word)
+#ifdef RQ_NODE_TIMESTAMPS
+    volatile long long itime; // for use by range query algorithm
+    volatile long long dtime; // for use by range query algorithm
+#endif
 };
 
 #define nodeptr node_t<K,V> *
@@ -34,6 +44,7 @@ template <typename K, typename V, class RecManager>
 class lazylistOOI {
 private:
     RecManager * const recmgr;
+    RQProvider<K, V, node_t<K,V>, lazylistOOI<K,V,RecManager>, RecManager, true, false> * const rqProvider;
     nodeptr head;
 
     const K KEY_MIN;
@@ -57,6 +68,7 @@ public:
         return doInsert(tid, key, val, true);
     }
     V erase(const int tid, const K& key);
+    int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues);
     
     void initThread(const int tid);
     void deinitThread(const int tid);
@@ -90,11 +102,36 @@ public:
     }
    
     node_t<K,V> * debug_getEntryPoint() { return head; }
+
+    /**
+     * BEGIN FUNCTIONS FOR RANGE QUERY SUPPORT
+     */
+
+    inline bool isLogicallyDeleted(const int tid, node_t<K,V> * node) {
+        return rqProvider->read_addr(tid, &node->marked) != 0;
+    }
+
+    inline int getKeys(const int tid, node_t<K,V> * node, K * const outputKeys, V * const outputValues) {
+        if (node->key == KEY_MIN || node->key == KEY_MAX) return 0;
+        outputKeys[0] = node->key;
+        outputValues[0] = node->val;
+        return 1;
+    }
+
+    bool isInRange(const K& key, const K& lo, const K& hi) {
+        return (lo <= key && key <= hi);
+    }
+
+    /**
+     * END FUNCTIONS FOR RANGE QUERY SUPPORT
+     */
 };
 
 template <typename K, typename V, class RecManager>
 lazylistOOI<K,V,RecManager>::lazylistOOI(const int numProcesses, const K _KEY_MIN, const K _KEY_MAX, const V _NO_VALUE, unsigned int id)
-        : recmgr(new RecManager(numProcesses, /*SIGRTMIN+1*/SIGQUIT)), KEY_MIN(_KEY_MIN), KEY_MAX(_KEY_MAX), NO_VALUE(_NO_VALUE)
+        : recmgr(new RecManager(numProcesses, /*SIGRTMIN+1*/SIGQUIT))
+        , rqProvider(new RQProvider<K, V, node_t<K,V>, lazylistOOI<K,V,RecManager>, RecManager, true, false>(numProcesses, this, recmgr))
+        , KEY_MIN(_KEY_MIN), KEY_MAX(_KEY_MAX), NO_VALUE(_NO_VALUE)
 {
     const int tid = 0;
     initThread(tid);
@@ -112,6 +149,7 @@ lazylistOOI<K,V,RecManager>::~lazylistOOI() {
         curr = next;
     }
     recmgr->deallocate(dummyTid, curr);
+    delete rqProvider; // frees any deleted nodes it still holds
     
     recmgr->printStatus();
     
@@ -121,10 +159,12 @@ lazylistOOI<K,V,RecManager>::~lazylistOOI() {
 template <typename K, typename V, class RecManager>
 void lazylistOOI<K,V,RecManager>::initThread(const int tid) {
     recmgr->initThread(tid);
+    rqProvider->initThread(tid);
 }
 
 template <typename K, typename V, class RecManager>
 void lazylistOOI<K,V,RecManager>::deinitThread(const int tid) {
+    rqProvider->deinitThread(tid);
     recmgr->deinitThread(tid);
 }
 
@@ -135,18 +175,21 @@ nodeptr lazylistOOI<K,V,RecManager>::new_node(const int tid, const K& key, const
         cout<<"out of memory"<<endl;
         exit(1);
     }
+    rqProvider->init_node(tid, nnode);
     nnode->key = key;
     nnode->val = val;
-    nnode->next = next;
+    rqProvider->write_addr(tid, &nnode->next, next);
     nnode->lock = false;
-    nnode->marked = 0;
+    rqProvider->write_addr(tid, &nnode->marked, 0LL);
 
     return nnode;
 }
 
 template <typename K, typename V, class RecManager>
 inline bool lazylistOOI<K,V,RecManager>::validateLinks(const int tid, nodeptr pred, nodeptr curr) {
-    return (!pred->marked && !curr->marked && pred->next == curr);
+    return (!rqProvider->read_addr(tid, &pred->marked)
+            && !rqProvider->read_addr(tid, &curr->marked)
+            && rqProvider->read_addr(tid, &pred->next) == curr);
 }
 
 template <typename K, typename V, class RecManager>
@@ -154,12 +197,14 @@ bool lazylistOOI<K,V,RecManager>::contains(const int tid, const K& key) {
     auto guard = recmgr->getGuard(tid, true);
     nodeptr curr = head;
     while (curr->key < key) {
-    curr = curr->next;
+        curr = rqProvider->read_addr(tid, &curr->next);
     }
 
     V res = NO_VALUE; 
-    if ((curr->key == key) && !curr->marked) {
-    res = curr->val;
+    if (curr->key == key) {
+        const bool deleted = isLogicallyDeleted(tid, curr);
+        rqProvider->search_report(tid, curr, deleted);
+        if (!deleted) res = curr->val;
     }
     return (res != NO_VALUE);
 }
@@ -175,16 +220,17 @@ V lazylistOOI<K,V,RecManager>::doInsert(const int tid, const K& key, const V& va
     while (true) 
     {
         pred = head;
-        curr = pred->next;
+        curr = rqProvider->read_addr(tid, &pred->next);
         while (curr->key < key) {
             pred = curr;
-            curr = curr->next;
+            curr = rqProvider->read_addr(tid, &curr->next);
         }
 
         acquireLock(&(pred->lock));
         if (validateLinks(tid, pred, curr)) {
             if (curr->key == key) { //key is in list
                 V result = curr->val;
+                rqProvider->search_report(tid, curr, false);
                 releaseLock(&(pred->lock));
                 return result; //failed
             }
@@ -195,7 +241,9 @@ V lazylistOOI<K,V,RecManager>::doInsert(const int tid, const K& key, const V& va
 #ifdef OOI_IBR_RECLAIMERS //qsbr and rcu that need alloc counter updation otherwise is similar to debraOOI
             recmgr->updateAllocCounterAndEpoch(tid);
 #endif            
-            pred->next = newnode;
+            nodeptr insertedNodes[] = {newnode, NULL};
+            nodeptr deletedNodes[] = {NULL};
+            rqProvider->linearize_update_at_write(tid, &pred->next, newnode, insertedNodes, deletedNodes);
 
             releaseLock(&(pred->lock));
             return result;
@@ -234,10 +282,10 @@ V lazylistOOI<K,V,RecManager>::erase(const int tid, const K& key) {
     while (true)
     {
         pred = head;
-        curr = pred->next;
+        curr = rqProvider->read_addr(tid, &pred->next);
         while (curr->key < key) {
             pred = curr;
-            curr = curr->next;
+            curr = rqProvider->read_addr(tid, &curr->next);
         }
 
         if (curr->key != key) {
@@ -250,12 +298,14 @@ V lazylistOOI<K,V,RecManager>::erase(const int tid, const K& key) {
         if (validateLinks(tid, pred, curr)) {
             assert(curr->key == key);
             result = curr->val;
-            nodeptr c_nxt = curr->next;
+            nodeptr c_nxt = rqProvider->read_addr(tid, &curr->next);
 
-            curr->marked = 1;                                                   // LINEARIZATION POINT
+            nodeptr insertedNodes[] = {NULL};
+            nodeptr deletedNodes[] = {curr, NULL};
+            rqProvider->linearize_update_at_write(tid, &curr->marked, 1LL, insertedNodes, deletedNodes); // LINEARIZATION POINT
+            rqProvider->announce_physical_deletion(tid, deletedNodes);
             pred->next = c_nxt;
-
-            recmgr->retire(tid, curr);
+            rqProvider->physical_deletion_succeeded(tid, deletedNodes); // retires curr
 
             releaseLock(&(curr->lock));
             releaseLock(&(pred->lock));
@@ -282,6 +332,23 @@ V lazylistOOI<K,V,RecManager>::erase(const int tid, const K& key) {
     }//While
 }
 
+template <typename K, typename V, class RecManager>
+int lazylistOOI<K,V,RecManager>::rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
+    auto guard = recmgr->getGuard(tid, true);
+    rqProvider->traversal_start(tid);
+    int cnt = 0;
+    nodeptr curr = rqProvider->read_addr(tid, &head->next);
+    while (curr->key < lo) {
+        curr = rqProvider->read_addr(tid, &curr->next);
+    }
+    while (curr->key <= hi && curr->key != KEY_MAX) {
+        rqProvider->traversal_try_add(tid, curr, resultKeys, resultValues, &cnt, lo, hi);
+        curr = rqProvider->read_addr(tid, &curr->next);
+    }
+    rqProvider->traversal_end(tid, resultKeys, resultValues, &cnt, lo, hi);
+    return cnt;
+}
+
 template <typename K, typename V, class RecManager>
 long long lazylistOOI<K,V,RecManager>::debugKeySum(nodeptr head) {
     long long result = 0;
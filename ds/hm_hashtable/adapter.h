@@ -18,6 +18,7 @@
 #include <csignal>
 #include "errors.h"
 #include "random_fnv1a.h"
+#include "bulk_insert.h"
 #ifdef USE_TREE_STATS
 #   include "tree_stats.h"
 #endif
@@ -72,6 +73,21 @@ public:
     , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, NO_VALUE, 0 /* unused */))
     { }
     
+    // bulk construction from keys[0..size), which must be sorted and distinct
+    ds_adapter(const int NUM_THREADS,
+               const K& KEY_MIN,
+               const K& KEY_MAX,
+               const V& VALUE_RESERVED,
+               RandomFNV1A * const unused2,
+               K const * keys,
+               V const * values,
+               const size_t size,
+               const int seed)
+    : ds_adapter(NUM_THREADS, KEY_MIN, KEY_MAX, VALUE_RESERVED, unused2)
+    {
+        bulkInsertSorted(this, NUM_THREADS, keys, values, size);
+    }
+    
     ~ds_adapter() {
         delete ds;
     }
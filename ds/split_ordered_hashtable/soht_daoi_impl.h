@@ -0,0 +1,390 @@
+/**
+ * Title = Split-Ordered Lists: Lock-Free Extensible Hash Tables by Ori Shalev and Nir Shavit.
+ * The underlying list is the Harris-Michael list of ds/hm_hashtable (see soht_directory.h).
+ *
+ */
+
+#ifndef SOHT_DAOI_IMPL_H
+#define SOHT_DAOI_IMPL_H
+
+#include "record_manager.h"
+#include "locks_impl.h"
+#include "soht_directory.h"
+#include <string>
+using namespace std;
+
+
+template<typename K, typename V>
+class node_t {
+public:
+    uint64_t so_key; // split-order key. even for dummy nodes, odd for regular nodes
+    K key;
+    V val;
+    std::atomic<node_t<K,V>*> next;
+#ifdef DAOI_IBR_RECLAIMERS
+    uint64_t birth_epoch;
+#endif
+};
+
+#define nodeptr node_t<K,V> *
+
+template <typename K, typename V, class RecManager>
+class sohtDAOI {
+private:
+    RecManager * const recmgr;
+PAD;
+    soht_directory<nodeptr> * const directory;
+    nodeptr head; // dummy node of bucket 0
+    nodeptr tail;
+PAD;
+
+    const K KEY_MIN;
+    const K KEY_MAX;
+    const V NO_VALUE;
+
+    nodeptr new_node(const int tid, const uint64_t so_key, const K& key, const V& val, nodeptr next);
+    nodeptr get_bucket(const int tid, const uint64_t bucketid);
+    nodeptr initialize_bucket(const int tid, const uint64_t bucketid, std::atomic<nodeptr> * const slot);
+    V doInsert(const int tid, const K& key, const V& value, bool onlyIfAbsent);
+    bool list_search(const int tid, nodeptr start, const uint64_t so_key, std::atomic<nodeptr>* &prev , nodeptr &curr, nodeptr &next);
+
+public:
+
+    sohtDAOI(int numProcesses, const K _KEY_MIN, const K _KEY_MAX, const V NO_VALUE, unsigned int id);
+    ~sohtDAOI();
+    bool contains(const int tid, const K& key);
+    V insertIfAbsent(const int tid, const K& key, const V& val) {
+        return doInsert(tid, key, val, true);
+    }
+    V erase(const int tid, const K& key);
+
+    void initThread(const int tid);
+    void deinitThread(const int tid);
+
+    long long debugKeySum();
+    long long getKeyChecksum();
+    bool validate(const long long keysum, const bool checkkeysum) {
+        return true;
+    }
+
+    long long getDSSize();
+
+    long long getSizeInNodes() {
+        long long size = 0;
+        for (nodeptr curr = getPtr(head->next.load()); curr != tail; curr = getPtr(curr->next.load())) {
+            size += !soht_is_dummy_key(curr->so_key);
+        }
+        return size;
+    }
+    string getSizeString() {
+        stringstream ss;
+        ss<<getSizeInNodes()<<" nodes in data structure, "<<directory->getNumBuckets()<<" buckets";
+        return ss.str();
+    }
+
+    RecManager * const debugGetRecMgr() {
+        return recmgr;
+    }
+
+    node_t<K,V> * debug_getEntryPoint() {
+        return head;
+    }
+
+
+    //getMk = isMarked. Checks with mark bit is set
+    bool getMk(node_t<K,V> * node) {
+    	return ((size_t) node & 0x1);
+    }
+
+    //mixPtrMk. get the whole next pointer field with mar bit.
+    node_t<K,V> * mixPtrMk(node_t<K,V> * node, bool mk) {
+    	return (node_t<K,V>*)((size_t) node | mk);
+    }
+
+    //getPtr = getUnmarked. Get the real next pointer field by hiding the mark bit.
+    node_t<K,V> * getPtr(node_t<K,V> * node) {
+    	return (node_t<K,V>*)((size_t) node & (~0x1));
+    }
+
+    //setMk = getMarked. Set the mark field of the pointer.
+	inline node_t<K,V>* setMk(node_t<K,V>* node){
+		return mixPtrMk(node,true);
+	}
+
+    void printList() {
+        nodeptr curr = head;
+        while (curr != tail) {
+            COUTATOMIC("-->"<<(soht_is_dummy_key(curr->so_key) ? "d" : "")<<curr->key<<"("<<curr<<")"<<"("<<getMk(curr->next.load())<<")" );
+            curr = getPtr(curr->next.load());
+        }
+        COUTATOMIC("-->tail("<<curr<<")"<<std::endl<<std::endl);
+    }
+};
+
+template <typename K, typename V, class RecManager>
+void sohtDAOI<K,V,RecManager>::initThread(const int tid) {
+    recmgr->initThread(tid);
+}
+
+template <typename K, typename V, class RecManager>
+void sohtDAOI<K,V,RecManager>::deinitThread(const int tid) {
+    recmgr->deinitThread(tid);
+}
+
+template <typename K, typename V, class RecManager>
+nodeptr sohtDAOI<K,V,RecManager>::new_node(const int tid, const uint64_t so_key, const K& key, const V& val, nodeptr next) {
+    nodeptr nnode = recmgr->template allocate<node_t<K,V> >(tid);
+
+    if (nnode == NULL) {
+        cout<<"out of memory"<<endl;
+        exit(1);
+    }
+    nnode->so_key = so_key;
+    nnode->key = key;
+    nnode->val = val;
+    nnode->next.store(next);
+#ifdef DAOI_IBR_RECLAIMERS
+    nnode->birth_epoch = recmgr->getEpoch();
+#endif
+
+    return nnode;
+}
+
+template <typename K, typename V, class RecManager>
+sohtDAOI<K,V,RecManager>::sohtDAOI(const int numProcesses, const K _KEY_MIN, const K _KEY_MAX, const V _NO_VALUE, unsigned int id)
+        : recmgr(new RecManager(numProcesses, /*SIGRTMIN+1*/SIGQUIT)), directory(new soht_directory<nodeptr>(numProcesses)), KEY_MIN(_KEY_MIN), KEY_MAX(_KEY_MAX), NO_VALUE(_NO_VALUE)
+{
+    const int tid = 0;
+    initThread(tid);
+
+    tail = new_node(tid, ~0ULL, KEY_MAX, 0, NULL);
+    head = new_node(tid, soht_dummy_key(0), KEY_MIN, 0, tail);
+    directory->getSlot(0)->store(head);
+}
+
+template <typename K, typename V, class RecManager>
+sohtDAOI<K,V,RecManager>::~sohtDAOI() {
+    const int dummyTid = 0;
+
+    // dummy nodes are never retired, so freeing the whole list frees every bucket too
+    nodeptr curr = head;
+    while (curr != tail) {
+        nodeptr next = getPtr(curr->next.load());
+        recmgr->deallocate(dummyTid, curr);
+        curr = next;
+    }
+    recmgr->deallocate(dummyTid, curr);
+    delete directory;
+
+    recmgr->printStatus();
+
+    delete recmgr;
+}
+
+/*
+ * Returns the dummy node of bucket bucketid, initializing the bucket if needed.
+ */
+template <typename K, typename V, class RecManager>
+nodeptr sohtDAOI<K,V,RecManager>::get_bucket(const int tid, const uint64_t bucketid) {
+    std::atomic<nodeptr> * const slot = directory->getSlot(bucketid);
+    nodeptr dummy = slot->load(std::memory_order_acquire);
+    if (dummy == NULL) {
+        dummy = initialize_bucket(tid, bucketid, slot);
+    }
+    return dummy;
+}
+
+/*
+ * Inserts the dummy node of bucket bucketid after the dummy node of its parent
+ * bucket and publishes it in slot. Dummy nodes are never removed.
+ */
+template <typename K, typename V, class RecManager>
+nodeptr sohtDAOI<K,V,RecManager>::initialize_bucket(const int tid, const uint64_t bucketid, std::atomic<nodeptr> * const slot) {
+    nodeptr parent = get_bucket(tid, soht_parent_bucket(bucketid));
+    nodeptr dummy = new_node(tid, soht_dummy_key(bucketid), KEY_MIN, NO_VALUE, NULL);
+    nodeptr curr = nullptr;
+    nodeptr next = nullptr;
+    std::atomic<nodeptr> *prev = nullptr;
+    while (true) {
+        if (list_search(tid, parent, dummy->so_key, prev, curr, next)) {
+            // another thread inserted this bucket's dummy first
+            recmgr->deallocate(tid, dummy);
+            dummy = curr;
+            break;
+        }
+        dummy->next.store(curr, std::memory_order_release);
+        if (prev->compare_exchange_strong(curr, dummy, std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+    nodeptr expected = NULL;
+    slot->compare_exchange_strong(expected, dummy, std::memory_order_acq_rel); // on failure, slot already holds dummy
+    return dummy;
+}
+
+template <typename K, typename V, class RecManager>
+bool sohtDAOI<K,V,RecManager>::list_search(const int tid, nodeptr start, const uint64_t so_key, std::atomic<nodeptr>* &prev , nodeptr &curr, nodeptr &nxt) {
+    while(true)
+    {
+        bool cmark = false;
+        // start from the dummy node of the bucket (never deleted)
+        prev = &(start->next);
+        //load the nodeptr from atomic type
+        // curr = prev->load();
+        curr = recmgr->read(tid, 1, (*prev));
+        while (true) {
+            // this cherck seems redundant curr can never be null as we have sentinel tail
+            if (curr == nullptr)
+                return false;
+            // in base case curr will be nodeptr tail
+            // nxt = curr->next.load();
+            nxt = recmgr->read(tid, 0, curr->next);
+            cmark = getMk(nxt);
+            nxt = getPtr(nxt);
+
+            // load again the pointer in the next field, somebody marked the pointer/change the actual ptr in next field of curr retry
+            if (mixPtrMk(nxt, cmark) != recmgr->read(tid, 1, curr->next))
+                break;
+
+            auto ckey = curr->so_key;
+            //if somebody changed the next field of thge node we reached to curr
+            if (recmgr->read(tid, 2, (*prev)) != curr)
+                break;
+            if (!(cmark))
+            {
+                if (ckey >= so_key) return ckey == so_key;
+                prev = &(curr->next);
+            }
+            else
+            {
+                // the curr ptr was marked so unlink it
+                if (prev->compare_exchange_strong(curr, nxt, std::memory_order_acq_rel))
+                {
+                    recmgr->retire(tid, curr);
+                }
+                else
+                    break;
+            }
+            curr = nxt;
+        } //while(true)
+    }//while(true)
+}
+
+
+
+template <typename K, typename V, class RecManager>
+bool sohtDAOI<K,V,RecManager>::contains(const int tid, const K& key) {
+    recmgr->startOp(tid);
+    nodeptr curr = nullptr; nodeptr next = nullptr;
+    std::atomic<nodeptr> *prev = nullptr;
+
+    nodeptr start = get_bucket(tid, directory->bucketOf(key));
+    bool isContains = list_search(tid, start, soht_regular_key(key), prev , curr, next);
+
+    recmgr->endOp(tid);
+    return isContains;
+
+}
+
+template <typename K, typename V, class RecManager>
+V sohtDAOI<K,V,RecManager>::doInsert(const int tid, const K& key, const V& val, bool onlyIfAbsent) {
+    recmgr->startOp(tid);
+    nodeptr curr = nullptr;
+    nodeptr next = nullptr;
+    std::atomic<nodeptr> *prev = nullptr;
+    const uint64_t so_key = soht_regular_key(key);
+    nodeptr newNode = new_node(tid, so_key, key, val, NULL);
+    nodeptr start = get_bucket(tid, directory->bucketOf(key));
+    while (true) {
+        if (list_search(tid, start, so_key, prev , curr, next))
+        {
+            // There is already a matching key
+            //use deallocate of allocator
+            recmgr->deallocate(tid, newNode);
+            recmgr->endOp(tid);
+            return curr->val;
+        }
+
+#ifdef DAOI_IBR_RECLAIMERS //2geibr and HE that need alloc counter updation
+            recmgr->updateAllocCounterAndEpoch(tid);
+#endif
+        newNode->next.store(curr, std::memory_order_release);
+        if (prev->compare_exchange_strong(curr, newNode, std::memory_order_acq_rel))
+        {
+            recmgr->endOp(tid);
+            directory->onInsert(tid);
+            return NO_VALUE;
+        }
+    }
+    assert(0);
+}
+
+/*
+ * Logically remove an element by setting a mark bit to 1
+ * before removing it physically.
+ */
+template <typename K, typename V, class RecManager>
+V sohtDAOI<K,V,RecManager>::erase(const int tid, const K& key) {
+   recmgr->startOp(tid);
+    nodeptr curr = nullptr;
+    nodeptr next = nullptr;
+    std::atomic<nodeptr> *prev = nullptr;
+    const uint64_t so_key = soht_regular_key(key);
+    nodeptr start = get_bucket(tid, directory->bucketOf(key));
+
+    while (true) {
+        /* Try to find the key in the list. */
+        if (!list_search(tid, start, so_key, prev , curr, next)) {
+            recmgr->endOp(tid);
+            return NO_VALUE;
+        }
+
+        V res = curr->val;
+        // attempting marking the curr's next field
+        if (!curr->next.compare_exchange_strong(next, setMk(next), std::memory_order_acq_rel)) {
+            continue; /* Another thread interfered. */
+        }
+
+        if (prev->compare_exchange_strong(curr, next, std::memory_order_acq_rel)) { /* Unlink */
+            recmgr->retire(tid, curr);
+        }
+        else
+        {
+            //failed to unlink the marked node. search again and try removing.
+            list_search(tid, start, so_key, prev , curr, next);
+        }
+        recmgr->endOp(tid);
+        directory->onErase(tid);
+        return res;
+    }
+    assert(0);
+}
+
+template <typename K, typename V, class RecManager>
+long long sohtDAOI<K,V,RecManager>::debugKeySum() {
+    long long result = 0;
+    int marked_count = 0;
+
+    nodeptr curr = getPtr(head->next.load());
+    while (curr != tail) {
+        if (!soht_is_dummy_key(curr->so_key)) result += curr->key;
+        if (getMk(curr->next.load())) marked_count++;
+        curr = getPtr(curr->next.load());
+    }
+    assert(marked_count == 0 && "need to not count marked nodes in size calculation");
+    return result;
+}
+
+template <typename K, typename V, class RecManager>
+long long sohtDAOI<K,V,RecManager>::getDSSize()
+{
+    return getSizeInNodes();
+}
+
+template <typename K, typename V, class RecManager>
+long long sohtDAOI<K,V,RecManager>::getKeyChecksum()
+{
+    return debugKeySum();
+}
+
+#endif	/* SOHT_DAOI_IMPL_H */
@@ -0,0 +1,160 @@
+/**
+ * Title = Split-Ordered Lists: Lock-Free Extensible Hash Tables by Ori Shalev and Nir Shavit.
+ *
+ * Helpers shared by every soht_*_impl.h: split-order key computation and the
+ * bucket directory.
+ *
+ * All keys live in ONE Harris-Michael list sorted by split-order key, i.e.,
+ * the bit-reversed hash. Bucket b is a pointer to a dummy (sentinel) node with
+ * split-order key reverse(b); regular nodes have reverse(key) | 1. Doubling
+ * the number of buckets therefore never moves a node: new bucket b is
+ * initialized on first use by inserting its dummy after the dummy of its
+ * parent bucket (b with its highest set bit cleared).
+ *
+ * The directory is a table of segments: segment 0 holds the first
+ * SOHT_INITIAL_BUCKETS buckets and segment s > 0 holds buckets
+ * [SOHT_INITIAL_BUCKETS << (s-1), SOHT_INITIAL_BUCKETS << s). Segments are
+ * allocated on first use and never move, so growing the table only CASes the
+ * bucket count, and memory grows with the number of keys (8 bytes per bucket).
+ * Insert/erase counts are kept per thread and folded into a shared count
+ * every SOHT_COUNT_BATCH updates; the bucket count doubles when the average
+ * bucket holds more than SOHT_MAX_LOAD keys.
+ */
+
+#ifndef SOHT_DIRECTORY_H
+#define SOHT_DIRECTORY_H
+
+#include <atomic>
+#include <cstdint>
+#include "plaf.h"
+#include "ConcurrentPrimitives.h"
+
+#ifndef SOHT_INITIAL_BUCKETS
+#define SOHT_INITIAL_BUCKETS 16     // must be a power of two
+#endif
+#ifndef SOHT_MAX_LOAD
+#define SOHT_MAX_LOAD 2
+#endif
+#ifndef SOHT_COUNT_BATCH
+#define SOHT_COUNT_BATCH 64
+#endif
+#define SOHT_MAX_SEGMENTS 48
+
+static inline uint64_t soht_reverse_bits(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x);
+}
+// split-order key of a regular node (keys must be non-negative, so bit 63 is free for the tag)
+static inline uint64_t soht_regular_key(const uint64_t key) {
+    return soht_reverse_bits(key) | 1;
+}
+// split-order key of the dummy node of bucket b
+static inline uint64_t soht_dummy_key(const uint64_t b) {
+    return soht_reverse_bits(b);
+}
+static inline bool soht_is_dummy_key(const uint64_t so_key) {
+    return (so_key & 1) == 0;
+}
+// b with its highest set bit cleared (b > 0)
+static inline uint64_t soht_parent_bucket(const uint64_t b) {
+    return b & ~(1ULL << (63 - __builtin_clzll(b)));
+}
+
+template <typename NodePtr>
+class soht_directory {
+private:
+PAD;
+    std::atomic<std::atomic<NodePtr> *> segments[SOHT_MAX_SEGMENTS];
+PAD;
+    std::atomic<uint64_t> numBuckets;
+PAD;
+    std::atomic<long long> count;
+PAD;
+    padded<long long> * localCount;     // updates not yet folded into count
+PAD;
+    const int numProcesses;
+
+    static inline int segmentOf(const uint64_t b) {
+        return (b < SOHT_INITIAL_BUCKETS) ? 0 : 64 - __builtin_clzll(b / SOHT_INITIAL_BUCKETS);
+    }
+    static inline uint64_t segmentStart(const int s) {
+        return (s == 0) ? 0 : ((uint64_t) SOHT_INITIAL_BUCKETS << (s-1));
+    }
+    static inline uint64_t segmentCapacity(const int s) {
+        return (s == 0) ? SOHT_INITIAL_BUCKETS : ((uint64_t) SOHT_INITIAL_BUCKETS << (s-1));
+    }
+
+    void flushCount(const int tid) {
+        const long long total = count.fetch_add(localCount[tid].ui, std::memory_order_relaxed) + localCount[tid].ui;
+        localCount[tid].ui = 0;
+        uint64_t n = numBuckets.load(std::memory_order_relaxed);
+        if (total > (long long) (n * SOHT_MAX_LOAD) && segmentOf(2*n - 1) < SOHT_MAX_SEGMENTS) {
+            numBuckets.compare_exchange_strong(n, 2*n, std::memory_order_release);
+        }
+    }
+
+public:
+    soht_directory(const int _numProcesses) : numProcesses(_numProcesses) {
+        for (int s=0;s<SOHT_MAX_SEGMENTS;++s) {
+            segments[s].store(NULL, std::memory_order_relaxed);
+        }
+        numBuckets.store(SOHT_INITIAL_BUCKETS, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        localCount = new padded<long long>[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            localCount[tid].ui = 0;
+        }
+    }
+    ~soht_directory() {
+        for (int s=0;s<SOHT_MAX_SEGMENTS;++s) {
+            delete[] segments[s].load(std::memory_order_relaxed);
+        }
+        delete[] localCount;
+    }
+
+    inline uint64_t getNumBuckets() {
+        return numBuckets.load(std::memory_order_acquire);
+    }
+    inline uint64_t bucketOf(const uint64_t key) {
+        return key & (getNumBuckets() - 1);
+    }
+
+    // slot of bucket b, allocating its segment if needed. the slot is NULL until bucket b is initialized.
+    std::atomic<NodePtr> * getSlot(const uint64_t b) {
+        const int s = segmentOf(b);
+        std::atomic<NodePtr> * seg = segments[s].load(std::memory_order_acquire);
+        if (seg == NULL) {
+            const uint64_t capacity = segmentCapacity(s);
+            std::atomic<NodePtr> * const newSeg = new std::atomic<NodePtr>[capacity];
+            for (uint64_t i=0;i<capacity;++i) {
+                newSeg[i].store(NULL, std::memory_order_relaxed);
+            }
+            if (segments[s].compare_exchange_strong(seg, newSeg, std::memory_order_acq_rel)) {
+                seg = newSeg;
+            } else {
+                delete[] newSeg; // seg now holds the winner's segment
+            }
+        }
+        return &seg[b - segmentStart(s)];
+    }
+
+    inline void onInsert(const int tid) {
+        if (++localCount[tid].ui >= SOHT_COUNT_BATCH) flushCount(tid);
+    }
+    inline void onErase(const int tid) {
+        if (--localCount[tid].ui <= -SOHT_COUNT_BATCH) flushCount(tid);
+    }
+
+    // bytes used by allocated segments
+    long long getSizeInBytes() {
+        long long result = 0;
+        for (int s=0;s<SOHT_MAX_SEGMENTS;++s) {
+            if (segments[s].load(std::memory_order_relaxed)) result += segmentCapacity(s) * sizeof(std::atomic<NodePtr>);
+        }
+        return result;
+    }
+};
+
+#endif /* SOHT_DIRECTORY_H */
@@ -430,6 +430,29 @@
     gstats_handle_stat(LONG_LONG, signalall, 1, { \
             gstats_output_item(PRINT_RAW, SUM, TOTAL) \
     }) \
+    gstats_handle_stat(LONG_LONG, pings_sent, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
+    gstats_handle_stat(LONG_LONG, pings_coalesced, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
+    gstats_handle_stat(LONG_LONG, ping_to_publish_latency, 100000, { \
+            gstats_output_item(PRINT_RAW, COUNT, TOTAL) \
+      __AND gstats_output_item(PRINT_RAW, AVERAGE, TOTAL) \
+      __AND gstats_output_item(PRINT_RAW, MAX, TOTAL) \
+    }) \
+    gstats_handle_stat(LONG_LONG, numa_local_frees, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
+    gstats_handle_stat(LONG_LONG, numa_remote_frees, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
+    gstats_handle_stat(LONG_LONG, numa_pool_local_hits, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
+    gstats_handle_stat(LONG_LONG, numa_pool_misses, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
     gstats_handle_stat(LONG_LONG, timer_duration, 1, {}) \
     gstats_handle_stat(LONG_LONG, timer_latency, 1, {}) \
     gstats_handle_stat(LONG_LONG, reclamation_event_size, 1000000, { \
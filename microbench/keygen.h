@@ -9,7 +9,10 @@
 #define KEYGEN_H
 
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include "plaf.h"
+#include "errors.h"
 
 template <typename K>
 class KeyGeneratorUniform {
@@ -27,34 +30,90 @@ public:
     }
 };
 
+/**
+ * Zipf distribution over [1, maxKey] with exponent theta >= 0 (theta = 0 is
+ * uniform), sampled by rejection-inversion (Hormann and Derflinger, "Rejection-
+ * inversion to generate variates from monotone discrete distributions", 1996).
+ *
+ * All state is O(1) (a few doubles shared by every thread), and a sample costs
+ * O(1) expected time (on average, fewer than 1.1 uniform variates per sample).
+ * There is no per-key table to build or search.
+ *
+ * Rank r (1 is the hottest key) is normally returned as key r, so the hot keys
+ * are adjacent. With permute, ranks are instead scattered over the key range by
+ * the bijection r -> ((r-1)*multiplier + offset) % maxKey + 1.
+ */
 class KeyGeneratorZipfData {
 public:
     PAD;
     int maxKey;
     double theta;
-    double c = 0; // Normalization constant
-    double * sum_probs; // Pre-calculated sum of probabilities
+    double hIntegralX1;     // hIntegral(1.5) - 1
+    double hIntegralMaxKey; // hIntegral(maxKey + 0.5)
+    double s;               // acceptance threshold for the squeeze
+    bool permute;
+    uint64_t multiplier;    // coprime with maxKey
+    uint64_t offset;
     PAD;
 
-    KeyGeneratorZipfData(int _maxKey, double _alpha) {
-//        std::cout<<"start KeyGeneratorZipfData"<<std::endl;
+    KeyGeneratorZipfData(int _maxKey, double _theta, bool _permute = false) {
+        if (_maxKey < 1) setbench_error("zipf key range must be non-empty");
+        if (_theta < 0) setbench_error("zipf theta must be non-negative");
         maxKey = _maxKey;
+        theta = _theta;
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralMaxKey = hIntegral(maxKey + 0.5);
+        s = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
 
-        // Compute normalization constant c for implied key range: [1, maxKey]
-        int i;
-        for (i = 1; i <= _maxKey; i++)
-            c = c + (1.0 / pow((double) i, theta));
-        c = 1.0 / c;
-
-        sum_probs = new double[_maxKey+1];
-        sum_probs[0] = 0;
-        for (i = 1; i <= _maxKey; i++) {
-            sum_probs[i] = sum_probs[i - 1] + c / pow((double) i, theta);
+        permute = _permute;
+        multiplier = 1;
+        offset = 0;
+        if (permute && maxKey > 2) {
+            // a multiplier near maxKey / golden ratio spreads consecutive ranks far apart
+            multiplier = (uint64_t) (maxKey * 0.6180339887498949);
+            while (gcd(multiplier, maxKey) != 1) ++multiplier;
+            offset = maxKey / 3;
         }
-//        std::cout<<"end KeyGeneratorZipfData"<<std::endl;
     }
-    ~KeyGeneratorZipfData() {
-        delete[] sum_probs;
+
+    // exp(-theta * log(x))
+    inline double h(const double x) const {
+        return exp(-theta * log(x));
+    }
+
+    // integral of h, shifted so that it is well defined at theta = 1
+    inline double hIntegral(const double x) const {
+        const double logX = log(x);
+        return helper2((1.0 - theta) * logX) * logX;
+    }
+
+    inline double hIntegralInverse(const double x) const {
+        double t = x * (1.0 - theta);
+        if (t < -1.0) t = -1.0; // limit round-off error
+        return exp(helper1(t) * x);
+    }
+
+    inline uint64_t rankToKey(const uint64_t rank) const {
+        if (!permute) return rank;
+        return ((rank - 1) * multiplier + offset) % maxKey + 1;
+    }
+
+private:
+    // log1p(x)/x, accurate near 0
+    static inline double helper1(const double x) {
+        if (fabs(x) > 1e-8) return log1p(x) / x;
+        return 1.0 - x * (0.5 - x * (1.0/3.0 - 0.25 * x));
+    }
+
+    // expm1(x)/x, accurate near 0
+    static inline double helper2(const double x) {
+        if (fabs(x) > 1e-8) return expm1(x) / x;
+        return 1.0 + x * 0.5 * (1.0 + x * (1.0/3.0) * (1.0 + 0.25 * x));
+    }
+
+    static uint64_t gcd(uint64_t a, uint64_t b) {
+        while (b) { uint64_t t = a % b; a = b; b = t; }
+        return a;
     }
 };
 
@@ -69,34 +128,23 @@ public:
     KeyGeneratorZipf(KeyGeneratorZipfData * _data, RandomFNV1A * _rng)
           : data(_data), rng(_rng) {}
     K next() {
-        double z; // Uniform random number (0 < z < 1)
-        int zipf_value; // Computed exponential value to be returned
-        int low, high, mid; // Binary-search bounds
-
-        // Pull a uniform random number (0 < z < 1)
-        do {
-            z = (rng->next() / (double) std::numeric_limits<uint64_t>::max());
-//            printf("    z=%lf\n", z);
-        } while ((z == 0) || (z == 1));
-
-        // Map z to the value
-        low = 1, high = data->maxKey, mid;
-        do {
-            mid = floor((low + high) / 2);
-            if (data->sum_probs[mid] >= z && data->sum_probs[mid - 1] < z) {
-                zipf_value = mid;
-                break;
-            } else if (data->sum_probs[mid] >= z) {
-                high = mid - 1;
-            } else {
-                low = mid + 1;
-            }
-        } while (low <= high);
-
-        // Assert that zipf_value is between 1 and N
-        assert((zipf_value >= 1) && (zipf_value <= data->maxKey));
+        const KeyGeneratorZipfData * const d = data;
+        while (true) {
+            // uniform double in [0, 1) from the top 53 bits
+            const double z = (rng->next() >> 11) * (1.0 / 9007199254740992.0);
+            const double u = d->hIntegralMaxKey + z * (d->hIntegralX1 - d->hIntegralMaxKey);
+            const double x = d->hIntegralInverse(u);
+            uint64_t rank = (uint64_t) (x + 0.5);
+            if (rank < 1) rank = 1;
+            else if (rank > (uint64_t) d->maxKey) rank = d->maxKey;
 
-        return (zipf_value);
+            // accept with a cheap squeeze test, or the exact test
+            if (rank - x <= d->s || u >= d->hIntegral(rank + 0.5) - d->h(rank)) {
+                auto result = d->rankToKey(rank);
+                assert((result >= 1) && (result <= (uint64_t) d->maxKey));
+                return result;
+            }
+        }
     }
 };
 
@@ -0,0 +1,166 @@
+/*
+ * File:   latency_histogram.h
+ *
+ * Per-thread operation latency histograms for the microbenchmark (-latency).
+ *
+ * Each histogram is HDR-style log-linear: values below 2^LATENCY_SUB_BUCKET_BITS
+ * get exact buckets, and every power of two above that is split into
+ * 2^LATENCY_SUB_BUCKET_BITS equal buckets, so any recorded value is known to
+ * within 1/2^LATENCY_SUB_BUCKET_BITS of its magnitude using fixed memory,
+ * without appending to the GSTATS buffers.
+ *
+ * A LatencyRecorder keeps one histogram per operation type and reclamation
+ * phase. An operation is attributed to the RECLAIM phase if its thread ran a
+ * reclamation event during it (e.g., it freed a batch of records, or pinged
+ * the other threads), otherwise to the SIGNALLED phase if its thread was
+ * pinged or neutralized during it, and otherwise to the NORMAL phase (see
+ * common/recordmgr/reclamation_events.h). Events on other threads do not
+ * count, since at high thread counts almost every operation overlaps one.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "plaf.h"
+#include "server_clock.h"
+#include "reclamation_events.h"
+
+#ifndef LATENCY_SUB_BUCKET_BITS
+#define LATENCY_SUB_BUCKET_BITS 6
+#endif
+#define LATENCY_SUB_BUCKETS (1ULL<<LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_NUM_BUCKETS ((65-LATENCY_SUB_BUCKET_BITS)*LATENCY_SUB_BUCKETS)
+
+enum LatencyOp {
+    LATENCY_OP_INSERT, LATENCY_OP_DELETE, LATENCY_OP_FIND, LATENCY_OP_RQ, LATENCY_NUM_OPS
+};
+enum LatencyPhase {
+    LATENCY_PHASE_NORMAL, LATENCY_PHASE_RECLAIM, LATENCY_PHASE_SIGNALLED, LATENCY_NUM_PHASES
+};
+static const char * const LATENCY_OP_NAMES[] = {"insert", "delete", "find", "rq"};
+static const char * const LATENCY_PHASE_NAMES[] = {"normal", "reclaim", "signalled"};
+
+class LatencyHistogram {
+private:
+    uint64_t counts[LATENCY_NUM_BUCKETS];
+    uint64_t total;
+    uint64_t maxValue;
+
+    static inline int bucketOf(const uint64_t v) {
+        if (v < LATENCY_SUB_BUCKETS) return (int) v;
+        const int shift = 63 - __builtin_clzll(v) - LATENCY_SUB_BUCKET_BITS;
+        return (shift+1)*LATENCY_SUB_BUCKETS + (int) ((v >> shift) - LATENCY_SUB_BUCKETS);
+    }
+
+    // largest value that maps to bucket b
+    static inline uint64_t highestValueIn(const int b) {
+        if (b < (int) LATENCY_SUB_BUCKETS) return b;
+        const int shift = b / LATENCY_SUB_BUCKETS - 1;
+        const uint64_t top = b % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+        return ((top+1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() { clear(); }
+
+    void clear() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        maxValue = 0;
+    }
+
+    inline void record(const uint64_t v) {
+        ++counts[bucketOf(v)];
+        ++total;
+        if (v > maxValue) maxValue = v;
+    }
+
+    void add(const LatencyHistogram& other) {
+        for (int b=0;b<(int) LATENCY_NUM_BUCKETS;++b) counts[b] += other.counts[b];
+        total += other.total;
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    uint64_t getCount() const { return total; }
+    uint64_t getMax() const { return maxValue; }
+
+    // smallest recorded value v (up to bucket precision) such that a fraction p of all values are <= v
+    uint64_t percentile(const double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t) (p * total + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > total) rank = total;
+        uint64_t seen = 0;
+        for (int b=0;b<(int) LATENCY_NUM_BUCKETS;++b) {
+            seen += counts[b];
+            if (seen >= rank) return std::min(highestValueIn(b), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+class LatencyRecorder {
+private:
+    PAD;
+    uint64_t startTime;
+    uint64_t startRan;
+    uint64_t startSignalled;
+    LatencyHistogram hist[LATENCY_NUM_OPS][LATENCY_NUM_PHASES];
+    PAD;
+
+public:
+    inline void start() {
+        startRan = reclamationEvents().ran;
+        startSignalled = reclamationEvents().signalled;
+        SOFTWARE_BARRIER;
+        startTime = get_server_clock();
+    }
+
+    inline void end(const LatencyOp op) {
+        const uint64_t endTime = get_server_clock();
+        SOFTWARE_BARRIER;
+        const LatencyPhase phase = (reclamationEvents().ran != startRan) ? LATENCY_PHASE_RECLAIM
+                                 : (reclamationEvents().signalled != startSignalled) ? LATENCY_PHASE_SIGNALLED
+                                 : LATENCY_PHASE_NORMAL;
+        hist[op][phase].record(endTime - startTime);
+    }
+
+    const LatencyHistogram& get(const int op, const int phase) const {
+        return hist[op][phase];
+    }
+
+    // histogram of operation type op in the given phase over all threads (phase LATENCY_NUM_PHASES means all phases)
+    static LatencyHistogram merge(const LatencyRecorder * const recorders, const int numThreads, const int op, const int phase) {
+        LatencyHistogram merged;
+        for (int p=0;p<LATENCY_NUM_PHASES;++p) {
+            if (phase != LATENCY_NUM_PHASES && p != phase) continue;
+            for (int tid=0;tid<numThreads;++tid) merged.add(recorders[tid].get(op, p));
+        }
+        return merged;
+    }
+
+    // prints count/p50/p99/p99.9/max (nanoseconds) per operation type, for each phase and overall
+    static void printAll(const LatencyRecorder * const recorders, const int numThreads) {
+        for (int op=0;op<LATENCY_NUM_OPS;++op) {
+            for (int phase=0;phase<=LATENCY_NUM_PHASES;++phase) {
+                print(merge(recorders, numThreads, op, phase), LATENCY_OP_NAMES[op], (phase < LATENCY_NUM_PHASES) ? LATENCY_PHASE_NAMES[phase] : "all");
+            }
+        }
+    }
+
+private:
+    static void print(const LatencyHistogram& h, const char * const op, const char * const phase) {
+        if (h.getCount() == 0) return;
+        std::cout<<"latency_"<<op<<"_"<<phase<<"_count="<<h.getCount()<<std::endl;
+        std::cout<<"latency_"<<op<<"_"<<phase<<"_p50_ns="<<h.percentile(0.50)<<std::endl;
+        std::cout<<"latency_"<<op<<"_"<<phase<<"_p99_ns="<<h.percentile(0.99)<<std::endl;
+        std::cout<<"latency_"<<op<<"_"<<phase<<"_p999_ns="<<h.percentile(0.999)<<std::endl;
+        std::cout<<"latency_"<<op<<"_"<<phase<<"_max_ns="<<h.getMax()<<std::endl;
+    }
+};
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -46,6 +46,14 @@ double DEL;
 double RQ;
 int RQSIZE;
 int MAXKEY = 0;
+double ZIPF_THETA;
+bool MEASURE_LATENCY;
+bool ZIPF_PERMUTE;
+int GARBAGE_BUDGET_MB;
+int RECLAIM_HELPERS;
+int SAMPLE_MILLIS;
+int OVERSUB;            // worker threads per logical processor (0 = use -nwork)
+int CHURN_MILLIS;       // lifetime of a worker thread before it is replaced (0 = no churn)
 int MILLIS_TO_RUN;
 int DESIRED_PREFILL_SIZE;
 bool PREFILL;
@@ -62,32 +70,37 @@ PAD;
 #include "papi_util_impl.h"
 #include "rq_provider.h"
 #include "keygen.h"
+#include "latency_histogram.h"
+#include "results_output.h"
+#include "prefill_snapshot.h"
 
 #ifndef PRINTS
     #define STR(x) XSTR(x)
     #define XSTR(x) #x
-    #define PRINTI(name) { std::cout<<#name<<"="<<name<<std::endl; }
-    #define PRINTS(name) { std::cout<<#name<<"="<<STR(name)<<std::endl; }
+    #define PRINTI(name) { std::cout<<#name<<"="<<name<<std::endl; resultsOutput().getConfig().add(#name, name); }
+    #define PRINTS(name) { std::cout<<#name<<"="<<STR(name)<<std::endl; resultsOutput().getConfig().add(#name, STR(name)); }
 #endif
 
-#include "adapter.h" /* data structure adapter header (selected according to the "ds/..." subdirectory in the -I include paths */
-#include "tree_stats.h"
-#define DS_ADAPTER_T ds_adapter<test_type, VALUE_TYPE, RECLAIM<>, ALLOC<>, POOL<> >
-
-#ifndef INSERT_FUNC
-    #define INSERT_FUNC insertIfAbsent
-#endif
+#define KEY_TO_VALUE(key) &key /* note: hack to turn a key into a pointer */
+#define VALUE_TYPE void *
 
+// extra record types that data structures using the snap collector RQProvider must give their record manager
+// (defined before adapter.h is included, since adapters use it in their RECORD_MANAGER_T)
 #ifdef RQ_SNAPCOLLECTOR
-    #define RQ_SNAPCOLLECTOR_OBJECT_TYPES , SnapCollector<node_t<test_type, test_type>, test_type>, SnapCollector<node_t<test_type, test_type>, test_type>::NodeWrapper, ReportItem, CompactReportItem
-    #define RQ_SNAPCOLLECTOR_OBJ_SIZES <<" SnapCollector="<<(sizeof(SnapCollector<node_t<test_type, test_type>, test_type>))<<" NodeWrapper="<<(sizeof(SnapCollector<node_t<test_type, test_type>, test_type>::NodeWrapper))<<" ReportItem="<<(sizeof(ReportItem))<<" CompactReportItem="<<(sizeof(CompactReportItem))
+    #define RQ_SNAPCOLLECTOR_OBJECT_TYPES , SnapCollector<node_t<test_type, VALUE_TYPE>, test_type>, SnapCollector<node_t<test_type, VALUE_TYPE>, test_type>::NodeWrapper, ReportItem
+    #define RQ_SNAPCOLLECTOR_OBJ_SIZES <<" SnapCollector="<<(sizeof(SnapCollector<node_t<test_type, VALUE_TYPE>, test_type>))<<" NodeWrapper="<<(sizeof(SnapCollector<node_t<test_type, VALUE_TYPE>, test_type>::NodeWrapper))<<" ReportItem="<<(sizeof(ReportItem))
 #else
     #define RQ_SNAPCOLLECTOR_OBJECT_TYPES
     #define RQ_SNAPCOLLECTOR_OBJ_SIZES
 #endif
 
-#define KEY_TO_VALUE(key) &key /* note: hack to turn a key into a pointer */
-#define VALUE_TYPE void *
+#include "adapter.h" /* data structure adapter header (selected according to the "ds/..." subdirectory in the -I include paths */
+#include "tree_stats.h"
+#define DS_ADAPTER_T ds_adapter<test_type, VALUE_TYPE, RECLAIM<>, ALLOC<>, POOL<> >
+
+#ifndef INSERT_FUNC
+    #define INSERT_FUNC insertIfAbsent
+#endif
 
 #ifdef USE_RCU
     #include "eer_prcu_impl.h"
@@ -142,6 +155,66 @@ enum KeyGeneratorDistribution {
     UNIFORM, ZIPF
 };
 
+// one trial of a -sweep (a run without -sweep is a sweep of one trial)
+struct sweep_trial_t {
+    int workThreads;
+    int rqThreads;
+    double ins;
+    double del;
+    double rq;
+    int rqsize;
+    int millisToRun;
+};
+std::vector<sweep_trial_t> SWEEP;
+
+std::string PREFILL_FROM; // prefill snapshot file (empty = prefill as usual)
+
+// parses e.g. "nwork=1;nwork=8;nwork=8,i=5,d=5,t=3000": trials are separated by ';',
+// and each trial sets some of nwork, nrq, i, d, rq, rqsize and t (as with the options
+// of the same names), inheriting the others from the previous trial (the first trial
+// inherits them from the command line)
+void parseSweep(const std::string& spec) {
+    sweep_trial_t t = {WORK_THREADS, RQ_THREADS, INS, DEL, RQ, RQSIZE, MILLIS_TO_RUN};
+    std::stringstream trials(spec);
+    std::string trial;
+    while (std::getline(trials, trial, ';')) {
+        if (trial.empty()) continue;
+        std::stringstream fields(trial);
+        std::string field;
+        while (std::getline(fields, field, ',')) {
+            const size_t eq = field.find('=');
+            if (eq == std::string::npos) {
+                setbench_error("bad -sweep field "<<field<<" (expected key=value)");
+            }
+            const std::string key = field.substr(0, eq);
+            const char * value = field.c_str() + eq + 1;
+            if (key == "nwork") t.workThreads = atoi(value);
+            else if (key == "nrq") t.rqThreads = atoi(value);
+            else if (key == "i") t.ins = atof(value);
+            else if (key == "d") t.del = atof(value);
+            else if (key == "rq") t.rq = atof(value);
+            else if (key == "rqsize") t.rqsize = atoi(value);
+            else if (key == "t") t.millisToRun = atoi(value);
+            else setbench_error("bad -sweep key "<<key);
+        }
+        SWEEP.push_back(t);
+    }
+    if (SWEEP.empty()) {
+        setbench_error("-sweep must specify at least one trial");
+    }
+}
+
+void applySweepTrial(const sweep_trial_t& t) {
+    WORK_THREADS = t.workThreads;
+    RQ_THREADS = t.rqThreads;
+    TOTAL_THREADS = WORK_THREADS + RQ_THREADS;
+    INS = t.ins;
+    DEL = t.del;
+    RQ = t.rq;
+    RQSIZE = t.rqsize;
+    MILLIS_TO_RUN = t.millisToRun;
+}
+
 template <class KeyGenT>
 struct globals_t {
     PAD;
@@ -172,6 +245,10 @@ struct globals_t {
     KeyGeneratorZipfData * keygenZipfData;
     KeyGenT * keygens[MAX_THREADS_POW2];
     PAD;
+    LatencyRecorder * latency; // per-thread latency histograms (NULL unless MEASURE_LATENCY)
+    std::vector<long long> throughputSamples; // throughput over each -sample-ms interval
+    std::vector<long long> garbageSamples; // unreclaimed bytes at the end of each -sample-ms interval
+    PAD;
     RandomFNV1A rngs[MAX_THREADS_POW2]; // create per-thread random number generators (padded to avoid false sharing)
 //    PAD; // not needed because of padding at the end of rngs
     volatile bool start;
@@ -180,6 +257,8 @@ struct globals_t {
     PAD;
     volatile int running; // number of threads that are running
     PAD;
+    volatile long long threadReplacements; // number of worker threads replaced with -churn-ms
+    PAD;
 
     globals_t(size_t maxkeyToGenerate, KeyGeneratorDistribution distribution)
     : NO_VALUE(NULL)
@@ -188,14 +267,14 @@ struct globals_t {
     , PREFILL_INTERVAL_MILLIS(200)
     {
         keygenZipfData = NULL;
+        latency = (MEASURE_LATENCY ? new LatencyRecorder[MAX_THREADS_POW2] : NULL);
         srand(time(0));
         for (int i=0;i<MAX_THREADS_POW2;++i) {
             rngs[i].setSeed(rand());
         }
         switch (distribution) {
             case ZIPF: {
-                double zipfTheta = 0.5;
-                keygenZipfData = new KeyGeneratorZipfData(maxkeyToGenerate, zipfTheta);
+                keygenZipfData = new KeyGeneratorZipfData(maxkeyToGenerate, ZIPF_THETA, ZIPF_PERMUTE);
                 for (int i=0;i<MAX_THREADS_POW2;++i) {
                     keygens[i] = (KeyGenT *) new KeyGeneratorZipf<test_type>(keygenZipfData, &rngs[i]);
                 }
@@ -213,6 +292,7 @@ struct globals_t {
         start = false;
         done = false;
         running = 0;
+        threadReplacements = 0;
         dsAdapter = NULL;
         garbage = 0;
         prefillIntervalElapsedMillis = 0;
@@ -224,6 +304,7 @@ struct globals_t {
             if (keygens[i]) delete keygens[i];
         }
         if (keygenZipfData) delete keygenZipfData;
+        if (latency) delete[] latency;
     }
 };
 
@@ -512,20 +593,74 @@ size_t * prefillWithArrayConstruction(auto g, int64_t expectedSize) {
     return present;
 }
 
-void createAndPrefillDataStructure(auto g, int64_t expectedSize) {
-    if (PREFILL_THREADS == 0) {
-        g->dsAdapter = new DS_ADAPTER_T(std::max(PREFILL_THREADS, TOTAL_THREADS), g->KEY_MIN, g->KEY_MAX, g->NO_VALUE, g->rngs);
-        return;
+// write the keys in the data structure to a prefill snapshot, by searching for every key in [1, MAXKEY]
+void savePrefillSnapshot(auto g, const std::string& path) {
+    #ifdef _OPENMP
+        omp_set_num_threads(PREFILL_THREADS);
+        const int ompThreads = omp_get_max_threads();
+    #else
+        const int ompThreads = 1;
+    #endif
+    std::vector<std::vector<test_type> > slices(ompThreads);
+
+    TIMING_START("collecting keys for prefill snapshot "<<path<<" with "<<ompThreads<<" threads");
+    #pragma omp parallel
+    {
+        #ifdef _OPENMP
+            const int tid = omp_get_thread_num();
+            binding_bindThread(tid);
+        #else
+            const int tid = 0;
+        #endif
+        g->dsAdapter->initThread(tid);
+        // each thread searches one contiguous part of the key range, so the slices are in order
+        const test_type begin = 1 + (test_type) MAXKEY * tid / ompThreads;
+        const test_type end = 1 + (test_type) MAXKEY * (tid+1) / ompThreads;
+        for (test_type key=begin;key<end;++key) {
+            if (g->dsAdapter->contains(tid, key)) slices[tid].push_back(key);
+        }
+        #pragma omp barrier
+        g->dsAdapter->deinitThread(tid);
     }
+    TIMING_STOP;
 
-    if (expectedSize == -1) {
-        const double expectedFullness = (INS+DEL ? INS / (double)(INS+DEL) : 0.5); // percent full in expectation
-        expectedSize = (int64_t) (MAXKEY * expectedFullness);
+    size_t numKeys = 0;
+    long long keySum = 0;
+    for (int i=0;i<ompThreads;++i) {
+        numKeys += slices[i].size();
+        for (size_t j=0;j<slices[i].size();++j) keySum += slices[i][j];
     }
+    if ((long long) numKeys != g->prefillSize || keySum != g->prefillKeySum) {
+        setbench_error("prefill snapshot: data structure has "<<numKeys<<" keys with sum "<<keySum<<", but prefilling inserted "<<g->prefillSize<<" keys with sum "<<g->prefillKeySum);
+    }
+    PrefillSnapshot<test_type>::write(path, slices, MAXKEY);
+    std::cout<<"wrote prefill snapshot "<<path<<" with "<<numKeys<<" keys"<<std::endl;
+}
 
-    // prefill data structure to mimic its structure in the steady state
-    g->prefillStartTime = std::chrono::high_resolution_clock::now();
+// bulk construct the data structure from a prefill snapshot
+void loadPrefillSnapshot(auto g, const std::string& path, const int64_t expectedSize) {
+    PrefillSnapshot<test_type> snapshot(path);
+    if (snapshot.getMaxKey() != (uint64_t) MAXKEY) {
+        setbench_error("prefill snapshot "<<path<<" was made with -k "<<snapshot.getMaxKey()<<", not -k "<<MAXKEY);
+    }
+    if ((int64_t) snapshot.size() != expectedSize) {
+        std::cout<<"note: prefill snapshot "<<path<<" has "<<snapshot.size()<<" keys, and the expected prefill size is "<<expectedSize<<std::endl;
+    }
 
+    #ifdef _OPENMP
+        omp_set_num_threads(PREFILL_THREADS);
+    #endif
+    TIMING_START("constructing data structure from prefill snapshot "<<path<<" with "<<snapshot.size()<<" keys");
+    g->dsAdapter = new DS_ADAPTER_T(
+            std::max(PREFILL_THREADS, TOTAL_THREADS), g->KEY_MIN, g->KEY_MAX, g->NO_VALUE, g->rngs,
+            snapshot.getKeys(), (VALUE_TYPE const *) snapshot.getKeys(), snapshot.size(), rand());
+    TIMING_STOP;
+    g->prefillKeySum = snapshot.getKeySum();
+    g->prefillSize = snapshot.size();
+    std::cout<<"pref_size="<<g->prefillSize<<std::endl;
+}
+
+void prefillDataStructure(auto g, int64_t expectedSize) {
     // PREBUILD VIA PARALLEL ARRAY CONSTRUCTION
     #ifdef PREFILL_BUILD_FROM_ARRAY
         auto present = prefillWithArrayConstruction(g, expectedSize);
@@ -535,6 +670,11 @@ void createAndPrefillDataStructure(auto g, int64_t expectedSize) {
                 (test_type const *) present, (VALUE_TYPE const *) present, expectedSize, rand());
         TIMING_STOP;
         delete[] present;
+        #ifdef USE_GSTATS
+            g->prefillKeySum = GSTATS_OBJECT_NAME.get_sum<long long>(key_checksum);
+            g->prefillSize = GSTATS_OBJECT_NAME.get_sum<long long>(size_checksum);
+        #endif
+        GSTATS_CLEAR_ALL;
 
     // PREBUILD VIA REPEATED CONCURRENT INSERT-ONLY TRIALS
     #elif defined PREFILL_INSERTION_ONLY
@@ -546,14 +686,155 @@ void createAndPrefillDataStructure(auto g, int64_t expectedSize) {
         g->dsAdapter = new DS_ADAPTER_T(std::max(PREFILL_THREADS, TOTAL_THREADS), g->KEY_MIN, g->KEY_MAX, g->NO_VALUE, g->rngs);
         prefillWithUpdates(g, expectedSize);
     #endif
+}
+
+void createAndPrefillDataStructure(auto g, int64_t expectedSize) {
+    if (PREFILL_THREADS == 0) {
+        g->dsAdapter = new DS_ADAPTER_T(std::max(PREFILL_THREADS, TOTAL_THREADS), g->KEY_MIN, g->KEY_MAX, g->NO_VALUE, g->rngs);
+        return;
+    }
+
+    if (expectedSize == -1) {
+        const double expectedFullness = (INS+DEL ? INS / (double)(INS+DEL) : 0.5); // percent full in expectation
+        expectedSize = (int64_t) (MAXKEY * expectedFullness);
+    }
+
+    // prefill data structure to mimic its structure in the steady state
+    g->prefillStartTime = std::chrono::high_resolution_clock::now();
+
+    if (PREFILL_FROM.empty()) {
+        prefillDataStructure(g, expectedSize);
+    } else {
+        // the first run with a given snapshot file prefills as usual and writes the snapshot,
+        // but still builds from it, so that every run with the file starts from the same structure
+        if (!PrefillSnapshot<test_type>::exists(PREFILL_FROM)) {
+            prefillDataStructure(g, expectedSize);
+            savePrefillSnapshot(g, PREFILL_FROM);
+            delete g->dsAdapter;
+        }
+        loadPrefillSnapshot(g, PREFILL_FROM, expectedSize);
+    }
 
     // print total prefilling time
     std::cout<<"prefill_elapsed_ms="<<std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - g->prefillStartTime).count()<<std::endl;
     g->dsAdapter->printSummary(); ///////// debug
 }
 
+#ifndef SWEEP_REBALANCE_TOLERANCE
+#define SWEEP_REBALANCE_TOLERANCE 0.02
+#endif
+
+// between the trials of a -sweep: insert (or delete) uniformly random keys with the
+// prefilling threads until the data structure size is the steady state size of the
+// next trial's mix, unless it is already within SWEEP_REBALANCE_TOLERANCE of it.
+// g->prefillKeySum and g->prefillSize must hold the current contents.
+void rebalanceDataStructure(auto g, int64_t expectedSize) {
+#ifdef USE_GSTATS
+    if (PREFILL_THREADS == 0) return;
+
+    if (expectedSize == -1) {
+        const double expectedFullness = (INS+DEL ? INS / (double)(INS+DEL) : 0.5); // percent full in expectation
+        expectedSize = (int64_t) (MAXKEY * expectedFullness);
+    }
+    const int64_t delta = expectedSize - g->prefillSize;
+    if (std::abs(delta) <= SWEEP_REBALANCE_TOLERANCE * expectedSize) {
+        std::cout<<"rebalance: size "<<g->prefillSize<<" is close enough to "<<expectedSize<<std::endl;
+        return;
+    }
+    const bool grow = (delta > 0);
+    const int64_t numUpdates = std::abs(delta);
+
+    #ifdef _OPENMP
+        omp_set_num_threads(PREFILL_THREADS);
+        const int ompThreads = omp_get_max_threads();
+    #else
+        const int ompThreads = 1;
+    #endif
+
+    TIMING_START("rebalancing from size "<<g->prefillSize<<" to "<<expectedSize<<" with "<<ompThreads<<" threads");
+    #pragma omp parallel
+    {
+        #ifdef _OPENMP
+            const int tid = omp_get_thread_num();
+            g->dsAdapter->initThread(tid);
+            binding_bindThread(tid);
+        #else
+            const int tid = 0;
+            g->dsAdapter->initThread(tid);
+        #endif
+
+        #pragma omp barrier
+
+        #pragma omp for schedule(dynamic, 10000)
+        for (int64_t i=0;i<numUpdates;++i) {
+            test_type key = g->rngs[tid].next(MAXKEY) + 1;
+            if (grow) {
+                if (g->dsAdapter->INSERT_FUNC(tid, key, KEY_TO_VALUE(key)) == g->dsAdapter->getNoValue()) {
+                    GSTATS_ADD(tid, key_checksum, key);
+                    GSTATS_ADD(tid, size_checksum, 1);
+                } else {
+                    --i;
+                    continue; // retry
+                }
+            } else {
+                if (g->dsAdapter->erase(tid, key) != g->dsAdapter->getNoValue()) {
+                    GSTATS_ADD(tid, key_checksum, -key);
+                    GSTATS_ADD(tid, size_checksum, -1);
+                } else {
+                    --i;
+                    continue; // retry
+                }
+            }
+        }
+
+        #pragma omp barrier
+        g->dsAdapter->deinitThread(tid);
+    }
+    TIMING_STOP;
+
+    g->prefillKeySum += GSTATS_OBJECT_NAME.get_sum<long long>(key_checksum);
+    g->prefillSize += GSTATS_OBJECT_NAME.get_sum<long long>(size_checksum);
+    std::cout<<"rebalance: size="<<g->prefillSize<<" keysum="<<g->prefillKeySum<<std::endl;
+    GSTATS_CLEAR_ALL;
+#endif
+}
+
+// prepare for trial i of a -sweep, on the data structure left behind by the previous trial
+void startSweepTrial(auto g, const size_t i) {
+    applySweepTrial(SWEEP[i]);
+    std::cout<<std::endl;
+    std::cout<<"sweep_trial="<<i<<" WORK_THREADS="<<WORK_THREADS<<" RQ_THREADS="<<RQ_THREADS<<" INS="<<INS<<" DEL="<<DEL<<" RQ="<<RQ<<" RQSIZE="<<RQSIZE<<" MILLIS_TO_RUN="<<MILLIS_TO_RUN<<std::endl;
+
+    g->start = false;
+    g->done = false;
+    g->running = 0;
+    g->threadReplacements = 0;
+    g->elapsedMillis = 0;
+    g->elapsedMillisNapping = 0;
+    g->throughputSamples.clear();
+    g->garbageSamples.clear();
+    if (g->latency) {
+        delete[] g->latency;
+        g->latency = new LatencyRecorder[MAX_THREADS_POW2];
+    }
+    GSTATS_CLEAR_ALL;
+
+    rebalanceDataStructure(g, DESIRED_PREFILL_SIZE);
+
+    GSTATS_CLEAR_VAL(timersplit_epoch, get_server_clock());
+    GSTATS_CLEAR_VAL(timersplit_token_received, get_server_clock());
+    GSTATS_CLEAR_VAL(timer_bag_rotation_start, get_server_clock());
+}
+
+/**
+ * Runs one worker thread. With -churn-ms, the thread with a given tid is
+ * replaced every CHURN_MILLIS: generation counts the threads that had this
+ * tid before (only generation 0 counts towards g->running, so g->running
+ * stays the number of tids that are still working), and *replaced is set if
+ * this thread left early to be replaced (see thread_churn).
+ */
 template <class GlobalsT>
-void thread_timed(GlobalsT * g, int __tid) {
+void thread_timed(GlobalsT * g, int __tid, const int generation, bool * const replaced) {
     tid = __tid;
 
     binding_bindThread(tid);
@@ -561,17 +842,23 @@ void thread_timed(GlobalsT * g, int __tid) {
 
     test_type * rqResultKeys = new test_type[RQSIZE+MAX_KEYS_PER_NODE];
     VALUE_TYPE * rqResultValues = new VALUE_TYPE[RQSIZE+MAX_KEYS_PER_NODE];
+    LatencyRecorder * const latency = (g->latency ? &g->latency[tid] : NULL);
     
     AJDBG COUTATOMICTID("thread_timed:: tid="<<tid<<std::endl);
 //    DEINIT_THREAD(tid); //@J
 //    __sync_synchronize(); //@J
     INIT_THREAD(tid);
     papi_create_eventset(tid);
-    __sync_fetch_and_add(&g->running, 1);
-    __sync_synchronize();
+    if (generation == 0) {
+        __sync_fetch_and_add(&g->running, 1);
+        __sync_synchronize();
+    }
     //std::cout<<"thread "<<__tid<<" wait for g->start running="<<g->running<<std::endl;
     while (!g->start) { sched_yield(); __sync_synchronize(); TRACE COUTATOMICTID("waiting to start"<<std::endl); } // wait to start
-    GSTATS_SET(tid, time_thread_start, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - g->startTime).count());
+    const auto birthTime = std::chrono::high_resolution_clock::now();
+    if (generation == 0) {
+        GSTATS_SET(tid, time_thread_start, std::chrono::duration_cast<std::chrono::microseconds>(birthTime - g->startTime).count());
+    }
     papi_start_counters(tid);
     int cnt = 0;
     int rq_cnt = 0;
@@ -616,6 +903,10 @@ void thread_timed(GlobalsT * g, int __tid) {
                 __sync_synchronize();
                 break;
             }
+            if (CHURN_MILLIS > 0 && std::chrono::duration_cast<std::chrono::milliseconds>(__endTime-birthTime).count() >= CHURN_MILLIS) {
+                *replaced = true;
+                break;
+            }
         }
 
         VERBOSE if (cnt&&((cnt % 1000000) == 0)) COUTATOMICTID("op# "<<cnt<<std::endl);
@@ -629,20 +920,20 @@ void thread_timed(GlobalsT * g, int __tid) {
         if (tid < (TOTAL_THREADS/2)) { //insert or delete at beginning of the list
             key = (key % 100) + 1;
             if (op < INS) {
-                // GSTATS_TIMER_RESET(tid, timer_latency);
+                if (latency) latency->start();
                 if (g->dsAdapter->INSERT_FUNC(tid, key, KEY_TO_VALUE(key)) == g->dsAdapter->getNoValue()) {
                     GSTATS_ADD(tid, key_checksum, key);
                     GSTATS_ADD(tid, size_checksum, 1);
                 }
-                // GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_updates);
+                if (latency) latency->end(LATENCY_OP_INSERT);
                 GSTATS_ADD(tid, num_inserts, 1);
             } else if (op < INS+DEL) {
-                // GSTATS_TIMER_RESET(tid, timer_latency);
+                if (latency) latency->start();
                 if (g->dsAdapter->erase(tid, key) != g->dsAdapter->getNoValue()) {
                     GSTATS_ADD(tid, key_checksum, -key);
                     GSTATS_ADD(tid, size_checksum, -1);
                 }
-                // GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_updates);
+                if (latency) latency->end(LATENCY_OP_DELETE);
                 GSTATS_ADD(tid, num_deletes, 1);
             } 
             else
@@ -653,27 +944,29 @@ void thread_timed(GlobalsT * g, int __tid) {
         }
         else //just do lookups for second half of threads
         {
+            if (latency) latency->start();
             if (g->dsAdapter->contains(tid, key)) {
             }
+            if (latency) latency->end(LATENCY_OP_FIND);
             GSTATS_ADD(tid, num_searches, 1);
         }
 
 #else
         if (op < INS) {
-            // GSTATS_TIMER_RESET(tid, timer_latency);
+            if (latency) latency->start();
             if (g->dsAdapter->INSERT_FUNC(tid, key, KEY_TO_VALUE(key)) == g->dsAdapter->getNoValue()) {
                 GSTATS_ADD(tid, key_checksum, key);
                 GSTATS_ADD(tid, size_checksum, 1);
             }
-            // GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_updates);
+            if (latency) latency->end(LATENCY_OP_INSERT);
             GSTATS_ADD(tid, num_inserts, 1);
         } else if (op < INS+DEL) {
-            // GSTATS_TIMER_RESET(tid, timer_latency);
+            if (latency) latency->start();
             if (g->dsAdapter->erase(tid, key) != g->dsAdapter->getNoValue()) {
                 GSTATS_ADD(tid, key_checksum, -key);
                 GSTATS_ADD(tid, size_checksum, -1);
             }
-            // GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_updates);
+            if (latency) latency->end(LATENCY_OP_DELETE);
             GSTATS_ADD(tid, num_deletes, 1);
         } else if (op < INS+DEL+RQ) {
             // TODO: make this respect KeyGenerators for non-uniform distributions
@@ -686,17 +979,17 @@ void thread_timed(GlobalsT * g, int __tid) {
 
             ++rq_cnt;
             size_t rqcnt;
-            // GSTATS_TIMER_RESET(tid, timer_latency);
+            if (latency) latency->start();
             if (rqcnt = g->dsAdapter->rangeQuery(tid, key, key+RQSIZE-1, rqResultKeys, (VALUE_TYPE *) rqResultValues)) {
                 garbage += rqResultKeys[0] + rqResultKeys[rqcnt-1]; // prevent rqResultValues and count from being optimized out
             }
-            // GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_rqs);
+            if (latency) latency->end(LATENCY_OP_RQ);
             GSTATS_ADD(tid, num_rq, 1);
         } else {
-        //    GSTATS_TIMER_RESET(tid, timer_latency);
+            if (latency) latency->start();
             if (g->dsAdapter->contains(tid, key)) {
             }
-        //    GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_searches);
+            if (latency) latency->end(LATENCY_OP_FIND);
             GSTATS_ADD(tid, num_searches, 1);
         }
 #endif
@@ -704,6 +997,17 @@ void thread_timed(GlobalsT * g, int __tid) {
         GSTATS_ADD(tid, num_operations, 1);
     }
 
+    if (replaced && *replaced) {
+        // leave while the other threads keep working; thread_churn starts a new thread with this tid
+        DURATION_END(tid, duration_all_ops);
+        papi_stop_counters(tid);
+        DEINIT_THREAD(tid);
+        delete[] rqResultKeys;
+        delete[] rqResultValues;
+        g->garbage += garbage;
+        return;
+    }
+
     __sync_fetch_and_add(&g->running, -1);
 //    GSTATS_SET(tid, num_prop_thread_exit_time, get_server_clock() - g->startClockTicks);
 #if defined (PERIODIC_PT_THROUGHPUT_PRINT_EFFICIENT) && defined(USE_GSTATS)
@@ -737,6 +1041,7 @@ void thread_rq(GlobalsT * g, int __tid) {
 
     test_type * rqResultKeys = new test_type[RQSIZE+MAX_KEYS_PER_NODE];
     VALUE_TYPE * rqResultValues = new VALUE_TYPE[RQSIZE+MAX_KEYS_PER_NODE];
+    LatencyRecorder * const latency = (g->latency ? &g->latency[tid] : NULL);
 
     INIT_THREAD(tid);
     papi_create_eventset(tid);
@@ -768,7 +1073,7 @@ void thread_rq(GlobalsT * g, int __tid) {
 
         test_type key = (test_type) _key;
         size_t rqcnt;
-        // GSTATS_TIMER_RESET(tid, timer_latency);
+        if (latency) latency->start();
 
         TIMELINE_START(tid);
 
@@ -778,7 +1083,7 @@ void thread_rq(GlobalsT * g, int __tid) {
 
         TIMELINE_END(tid, "RQThreadOperation");
 
-        // GSTATS_TIMER_APPEND_ELAPSED(tid, timer_latency, latency_rqs);
+        if (latency) latency->end(LATENCY_OP_RQ);
         GSTATS_ADD(tid, num_rq, 1);
         GSTATS_ADD(tid, num_operations, 1);
     }
@@ -801,13 +1106,66 @@ void thread_rq(GlobalsT * g, int __tid) {
     g->garbage += garbage;
 }
 
+// with -churn-ms: runs worker threads with tid one after another, each replacing the last when it leaves,
+// until the trial ends. A replaced thread's DEINIT_THREAD waits for any thread that is signalling it
+// (see thread_signals.h), and the next thread starts only after it has exited, so no ping or
+// neutralization signal can reach an exited thread.
+template <class GlobalsT>
+void thread_churn(GlobalsT * g, int __tid) {
+    for (int generation = 0; ; ++generation) {
+        bool replaced = false;
+        std::thread worker(thread_timed<GlobalsT>, g, __tid, generation, &replaced);
+        worker.join();
+        if (!replaced) break;
+        __sync_fetch_and_add(&g->threadReplacements, 1);
+    }
+}
+
+// sleep until the trial should end, recording the throughput of every SAMPLE_MILLIS interval,
+// and the unreclaimed (retired but not yet freed) bytes at the end of every interval
+template <class GlobalsT>
+void sampleTrial(GlobalsT * g) {
+    long long lastOps = 0;
+    long lastMillis = 0;
+    while (true) {
+        long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - g->startTime).count();
+        if (elapsed >= MILLIS_TO_RUN) break;
+        const long nap = std::min((long) SAMPLE_MILLIS, MILLIS_TO_RUN - elapsed);
+        timespec tsNap;
+        tsNap.tv_sec = nap / 1000;
+        tsNap.tv_nsec = (nap % 1000) * ((__syscall_slong_t) 1000000);
+        nanosleep(&tsNap, NULL);
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - g->startTime).count();
+
+        long long ops = 0;
+#ifdef USE_GSTATS
+        for (int tid=0;tid<TOTAL_THREADS;++tid) ops += GSTATS_GET(tid, num_operations); // racy reads are fine for a sample
+#endif
+        const long long throughput = (elapsed > lastMillis) ? (ops - lastOps) * 1000 / (elapsed - lastMillis) : 0;
+        g->throughputSamples.push_back(throughput);
+        const long long garbageBytes = memoryAccounting().sample();
+        g->garbageSamples.push_back(garbageBytes);
+
+        ResultsRecord sample;
+        sample.add("elapsed_millis", elapsed);
+        sample.add("ops", ops);
+        sample.add("interval_throughput", throughput);
+        sample.add("garbage_bytes", garbageBytes);
+        resultsOutput().writeSample(sample);
+        lastOps = ops;
+        lastMillis = elapsed;
+    }
+}
+
+// helper i is bound like worker thread TOTAL_THREADS+i, i.e., to the next processors in the -pin list
+void bindReclaimHelper(const int helper) {
+    binding_bindThread(TOTAL_THREADS + helper);
+}
+
 template <class GlobalsT>
 void trial(GlobalsT * g) {
     papi_init_program(TOTAL_THREADS);
 
-    // create the actual data structure and prefill it to match the expected steady state
-    createAndPrefillDataStructure(g, DESIRED_PREFILL_SIZE);
-
     // setup measured part of the experiment
     INIT_ALL;
 
@@ -838,11 +1196,16 @@ void trial(GlobalsT * g) {
     tsNap.tv_sec = 0;
     tsNap.tv_nsec = 10000000; // 10ms
 
+    // start reclamation helpers (they only get work with POOL_TYPE=offload)
+    reclaimHelpers().start(RECLAIM_HELPERS, bindReclaimHelper);
+
     // start all threads
     std::thread * threads[MAX_THREADS_POW2];
     for (int i=0;i<TOTAL_THREADS;++i) {
-        if (i < WORK_THREADS) {
-            threads[i] = new std::thread(thread_timed<GlobalsT>, g, i);
+        if (i < WORK_THREADS && CHURN_MILLIS > 0) {
+            threads[i] = new std::thread(thread_churn<GlobalsT>, g, i);
+        } else if (i < WORK_THREADS) {
+            threads[i] = new std::thread(thread_timed<GlobalsT>, g, i, 0, (bool *) NULL);
         } else {
             threads[i] = new std::thread(thread_rq<GlobalsT>, g, i);
         }
@@ -871,6 +1234,7 @@ void trial(GlobalsT * g) {
 #ifdef MEASURE_TIMELINE_GSTATS
     ___timeline_gstats_use = 1;
 #endif
+    memoryAccounting().resetPeaks();
     g->start = true;
     SOFTWARE_BARRIER;
 
@@ -889,7 +1253,11 @@ void trial(GlobalsT * g) {
             passed_seconds++;
         }
 #else
-        nanosleep(&tsExpected, NULL);
+        if (SAMPLE_MILLIS > 0) {
+            sampleTrial(g);
+        } else {
+            nanosleep(&tsExpected, NULL);
+        }
         SOFTWARE_BARRIER;
         g->done = true;
 #endif
@@ -945,6 +1313,7 @@ void trial(GlobalsT * g) {
         threads[i]->join();
         delete threads[i];
     }
+    reclaimHelpers().stop();
 
     COUTATOMIC(std::endl);
     COUTATOMIC("###############################################################################"<<std::endl);
@@ -964,8 +1333,22 @@ void printExecutionTime(auto g) {
     std::cout<<"total_execution_walltime="<<(programExecutionElapsed/1000.)<<"s"<<std::endl;
 }
 
-void printOutput(auto g) {
+void printOutput(auto g, const size_t sweepTrial, const bool lastTrial) {
     std::cout<<"PRODUCING OUTPUT"<<std::endl;
+    ResultsRecord results; // for -json / -csv
+    const char * validateResult = "none";
+
+    if (SWEEP.size() > 1) {
+        results.add("sweep_trial", sweepTrial);
+        results.add("sweep_WORK_THREADS", WORK_THREADS);
+        results.add("sweep_RQ_THREADS", RQ_THREADS);
+        results.add("sweep_INS", INS);
+        results.add("sweep_DEL", DEL);
+        results.add("sweep_RQ", RQ);
+        results.add("sweep_RQSIZE", RQSIZE);
+        results.add("sweep_MILLIS_TO_RUN", MILLIS_TO_RUN);
+        results.add("sweep_initial_size", g->prefillSize);
+    }
 
 #ifdef USE_TREE_STATS
     TreeStats<DS_ADAPTER_T::NodeHandler> *treeStats;
@@ -981,12 +1364,26 @@ void printOutput(auto g) {
         std::cout<<std::endl;
         //std::cout<<"size_nodes="<<
         std::cout<<treeStats->toString()<<std::endl;
+        results.add("tree_stats_height", treeStats->getHeight());
+        results.add("tree_stats_nodes", treeStats->getNodes());
+        results.add("tree_stats_keys", treeStats->getKeys());
+        results.add("tree_stats_avg_key_depth", treeStats->getAverageKeyDepth());
     }
 #endif
 
 #ifdef  USE_GSTATS
     GSTATS_PRINT;
     std::cout<<std::endl;
+    if (resultsOutput().isEnabled()) {
+        GSTATS_FOR_EACH_TOTAL([&results](const std::string& name, const gstats_t::stat_metrics<double>& m) {
+            results.add(name + "_sum", m.sum);
+            results.add(name + "_count", m.cnt);
+            results.add(name + "_min", m.cnt ? m.min : 0);
+            results.add(name + "_max", m.cnt ? m.max : 0);
+            results.add(name + "_avg", m.avg);
+            results.add(name + "_stdev", m.stdev);
+        });
+    }
 #endif
 
     long long threadsKeySum = 0;
@@ -998,6 +1395,9 @@ void printOutput(auto g) {
         threadsSize = GSTATS_GET_STAT_METRICS(size_checksum, TOTAL)[0].sum + g->prefillSize;
         std::cout<<"threads_final_keysum="<<threadsKeySum<<std::endl;
         std::cout<<"threads_final_size="<<threadsSize<<std::endl;
+        // the next trial of a -sweep starts from what this trial left behind
+        g->prefillKeySum = threadsKeySum;
+        g->prefillSize = threadsSize;
 #ifdef USE_TREE_STATS
     if(g->dsAdapter->isTree())
     {
@@ -1008,9 +1408,11 @@ void printOutput(auto g) {
         std::cout<<"final_size="<<dsSize<<std::endl;
         if (threadsKeySum == dsKeySum && threadsSize == dsSize) {
             std::cout<<"validate_result=success"<<std::endl;
+            validateResult = "success";
             std::cout<<"Validation OK."<<std::endl;
         } else {
             std::cout<<"validate_result=fail"<<std::endl;
+            validateResult = "fail";
             std::cout<<"Validation FAILURE: threadsKeySum="<<threadsKeySum<<" dsKeySum="<<dsKeySum<<" threadsSize="<<threadsSize<<" dsSize="<<dsSize<<std::endl;
             std::cout<<"Validation comment: data structure is "<<(dsSize > threadsSize ? "LARGER" : "SMALLER")<<" than it should be according to the operation return values"<<std::endl;
             printExecutionTime(g);
@@ -1027,12 +1429,14 @@ void printOutput(auto g) {
 
         if (threadsKeySum == dsKeySum && threadsSize == dsSize) {
             std::cout<<"validate_result=success"<<std::endl;
+            validateResult = "success";
             std::cout<<"Validation OK."<<std::endl;
             // assert(0 && "validate");
 
         } else {
 
             std::cout<<"validate_result=fail"<<std::endl<<std::flush;
+            validateResult = "fail";
             std::cout<<"Validation FAILURE: threadsKeySum="<<threadsKeySum<<" dsKeySum="<<dsKeySum<<" threadsSize="<<threadsSize<<" dsSize="<<dsSize<<std::endl<<std::flush;
             std::cout<<"Validation comment: data structure is "<<(dsSize > threadsSize ? "LARGER" : "SMALLER")<<" than it should be according to the operation return values"<<std::endl<<std::flush;
 
@@ -1083,6 +1487,23 @@ void printOutput(auto g) {
         COUTATOMIC("memory_usage(mib)="<<getMemoryUsageBytes()/(1024*1024)<<std::endl);
         COUTATOMIC(std::endl);
 
+        results.add("threads_final_keysum", threadsKeySum);
+        results.add("threads_final_size", threadsSize);
+        results.add("validate_result", validateResult);
+        results.add("total_find", totalSearches);
+        results.add("total_rq", totalRQs);
+        results.add("total_inserts", totalInserts);
+        results.add("total_deletes", totalDeletes);
+        results.add("total_updates", totalUpdates);
+        results.add("total_queries", totalQueries);
+        results.add("total_ops", totalAll);
+        results.add("find_throughput", throughputSearches);
+        results.add("rq_throughput", throughputRQs);
+        results.add("update_throughput", throughputUpdates);
+        results.add("query_throughput", throughputQueries);
+        results.add("total_throughput", throughputAll);
+        results.add("memory_usage_mib", getMemoryUsageBytes()/(1024*1024));
+
         COUTATOMIC(std::endl);
         COUTATOMIC("total find                    : "<<totalSearches<<std::endl);
         COUTATOMIC("total rq                      : "<<totalRQs<<std::endl);
@@ -1100,6 +1521,78 @@ void printOutput(auto g) {
     }
 #endif
 
+    if (CHURN_MILLIS > 0) {
+        COUTATOMIC("thread_replacements="<<g->threadReplacements<<std::endl);
+        COUTATOMIC(std::endl);
+        results.add("thread_replacements", g->threadReplacements);
+    }
+
+    if (reclaimHelpers().getNumHelpers() > 0) {
+        uint64_t helperFreed = 0;
+        uint64_t helperCpuNs = 0;
+        uint64_t helperWallNs = 0;
+        for (int i=0;i<reclaimHelpers().getNumHelpers();++i) {
+            helperFreed += reclaimHelpers().getFreed(i);
+            helperCpuNs += reclaimHelpers().getCpuNs(i);
+            helperWallNs += reclaimHelpers().getWallNs(i);
+        }
+        COUTATOMIC("worker_throughput="<<(long long) (totalAll / (MILLIS_TO_RUN/1000.))<<std::endl);
+        COUTATOMIC("reclaim_helper_freed="<<helperFreed<<std::endl);
+        COUTATOMIC("reclaim_helper_cpu_ms="<<helperCpuNs/1000000<<std::endl);
+        COUTATOMIC("reclaim_helper_utilization="<<(helperWallNs ? (double) helperCpuNs / helperWallNs : 0.)<<std::endl); // average fraction of a core per helper
+        COUTATOMIC(std::endl);
+        results.add("reclaim_helper_freed", helperFreed);
+        results.add("reclaim_helper_cpu_ms", helperCpuNs/1000000);
+        results.add("reclaim_helper_utilization", (helperWallNs ? (double) helperCpuNs / helperWallNs : 0.));
+    }
+
+    MEMORY_STATS {
+        // the garbage of every record type at the end of the trial (before the data structure is deleted)
+        const long long garbageBytes = memoryAccounting().sample();
+        const std::vector<memory_accounting_type_t> types = memoryAccounting().getTypes();
+        for (size_t i=0;i<types.size();++i) {
+            debugInfo * const info = types[i].info;
+            const std::string prefix = "record_" + types[i].name;
+            const long long freed = info->getTotalToPool() - info->getTotalDiscarded();
+            COUTATOMIC(prefix<<"_allocated="<<info->getTotalAllocated()<<std::endl);
+            COUTATOMIC(prefix<<"_retired="<<info->getTotalRetired()<<std::endl);
+            COUTATOMIC(prefix<<"_freed="<<freed<<std::endl);
+            COUTATOMIC(prefix<<"_garbage_bytes="<<types[i].getGarbageBytes()<<std::endl);
+            COUTATOMIC(prefix<<"_peak_garbage_bytes="<<types[i].getPeakGarbageBytes()<<std::endl);
+            results.add(prefix + "_allocated", info->getTotalAllocated());
+            results.add(prefix + "_allocated_bytes", info->getTotalAllocated() * (long long) types[i].recordSize);
+            results.add(prefix + "_retired", info->getTotalRetired());
+            results.add(prefix + "_freed", freed);
+            results.add(prefix + "_garbage_bytes", types[i].getGarbageBytes());
+            results.add(prefix + "_peak_garbage_bytes", types[i].getPeakGarbageBytes());
+        }
+        COUTATOMIC("garbage_bytes="<<garbageBytes<<std::endl);
+        COUTATOMIC("peak_garbage_bytes="<<memoryAccounting().getPeakGarbageBytes()<<std::endl);
+        COUTATOMIC("garbage_bytes_samples=");
+        for (size_t i=0;i<g->garbageSamples.size();++i) COUTATOMIC((i?" ":"")<<g->garbageSamples[i]);
+        COUTATOMIC(std::endl<<std::endl);
+        results.add("garbage_bytes", garbageBytes);
+        results.add("peak_garbage_bytes", memoryAccounting().getPeakGarbageBytes());
+        results.addArray("garbage_bytes_samples", g->garbageSamples);
+    }
+
+    if (g->latency) {
+        for (int op=0;op<LATENCY_NUM_OPS;++op) {
+            for (int phase=0;phase<=LATENCY_NUM_PHASES;++phase) {
+                const LatencyHistogram h = LatencyRecorder::merge(g->latency, TOTAL_THREADS, op, phase);
+                if (h.getCount() == 0) continue;
+                const std::string prefix = std::string("latency_") + LATENCY_OP_NAMES[op] + "_" + ((phase < LATENCY_NUM_PHASES) ? LATENCY_PHASE_NAMES[phase] : "all");
+                results.add(prefix + "_count", h.getCount());
+                results.add(prefix + "_p50_ns", h.percentile(0.50));
+                results.add(prefix + "_p99_ns", h.percentile(0.99));
+                results.add(prefix + "_p999_ns", h.percentile(0.999));
+                results.add(prefix + "_max_ns", h.getMax());
+            }
+        }
+        LatencyRecorder::printAll(g->latency, TOTAL_THREADS);
+        COUTATOMIC(std::endl);
+    }
+
     COUTATOMIC("elapsed milliseconds          : "<<g->elapsedMillis<<std::endl);
     COUTATOMIC("napping milliseconds overtime : "<<g->elapsedMillisNapping<<std::endl);
     COUTATOMIC(std::endl);
@@ -1107,17 +1600,33 @@ void printOutput(auto g) {
 
     // free ds
 #if !defined NO_CLEANUP_AFTER_WORKLOAD
-    std::cout<<"begin delete ds..."<<std::endl;
-    if (MAXKEY > 10000000) {
-        std::cout<<"    SKIPPING deletion of data structure to save time! (because key range is so large)"<<std::endl;
-        g->dsAdapter->printSummary();
+    if (!lastTrial) {
+        std::cout<<"keeping data structure for the next sweep trial"<<std::endl;
     } else {
-        delete g->dsAdapter;
+        std::cout<<"begin delete ds..."<<std::endl;
+        if (MAXKEY > 10000000) {
+            std::cout<<"    SKIPPING deletion of data structure to save time! (because key range is so large)"<<std::endl;
+            g->dsAdapter->printSummary();
+        } else {
+            delete g->dsAdapter;
+        }
+        std::cout<<"end delete ds."<<std::endl;
     }
-    std::cout<<"end delete ds."<<std::endl;
 #endif
 
     papi_print_counters(totalAll);
+
+    if (resultsOutput().isEnabled()) {
+        results.add("elapsed_millis", g->elapsedMillis);
+        results.add("napping_millis", g->elapsedMillisNapping);
+        std::vector<std::pair<std::string, double> > counters;
+        papi_get_counters(totalAll, counters);
+        for (size_t i=0;i<counters.size();++i) {
+            results.add(counters[i].first, counters[i].second);
+        }
+        results.addArray("throughput_samples", g->throughputSamples);
+        resultsOutput().writeTrial(results);
+    }
 #ifdef USE_TREE_STATS
     if(g->dsAdapter->isTree())
     {
@@ -1148,7 +1657,14 @@ void main_continued_with_globals(auto g) {
         std::cout<<(i?",":"")<<binding_getActualBinding(i);
     }
     std::cout<<std::endl;
-    if (!binding_isInjectiveMapping(TOTAL_THREADS)) {
+    if (RECLAIM_HELPERS > 0) {
+        std::cout<<"ACTUAL_RECLAIM_HELPER_BINDINGS=";
+        for (int i=0;i<RECLAIM_HELPERS;++i) {
+            std::cout<<(i?",":"")<<binding_getActualBinding(TOTAL_THREADS + i);
+        }
+        std::cout<<std::endl;
+    }
+    if (OVERSUB == 0 && !binding_isInjectiveMapping(TOTAL_THREADS)) {
         std::cout<<"ERROR: thread binding maps more than one thread to a single logical processor"<<std::endl;
         exit(-1);
     }
@@ -1163,8 +1679,15 @@ void main_continued_with_globals(auto g) {
     GSTATS_CLEAR_VAL(timersplit_token_received, get_server_clock());
     GSTATS_CLEAR_VAL(timer_bag_rotation_start, get_server_clock());
 
-    trial(g);
-    printOutput(g);
+    // create the actual data structure and prefill it to match the expected steady state
+    // (once, for all trials of a -sweep)
+    createAndPrefillDataStructure(g, DESIRED_PREFILL_SIZE);
+
+    for (size_t i=0;i<SWEEP.size();++i) {
+        if (SWEEP.size() > 1) startSweepTrial(g, i);
+        trial(g);
+        printOutput(g, i, i+1 == SWEEP.size());
+    }
 
     binding_deinit();
     std::cout<<"garbage="<<g->garbage<<std::endl; // to prevent certain steps from being optimized out
@@ -1197,6 +1720,14 @@ int main(int argc, char** argv) {
     INS = 10;
     DEL = 10;
     MAXKEY = 100000;
+    ZIPF_THETA = 0.5;
+    ZIPF_PERMUTE = false;
+    MEASURE_LATENCY = false;
+    GARBAGE_BUDGET_MB = 0; // no budget
+    RECLAIM_HELPERS = 0;
+    SAMPLE_MILLIS = 0;
+    OVERSUB = 0;
+    CHURN_MILLIS = 0;
     DESIRED_PREFILL_SIZE = -1;  // note: -1 means "use whatever would be expected in the steady state"
                                 // to get NO prefilling, set -nprefill 0
     // MAX_RINGBAG_CAPACITY_POW2 = 32768; //16384;
@@ -1204,6 +1735,7 @@ int main(int argc, char** argv) {
 
 
     KeyGeneratorDistribution distribution = KeyGeneratorDistribution::UNIFORM;
+    std::string SWEEP_SPEC; // empty means a single trial
     // read command line args
     // example args: -i 25 -d 25 -k 10000 -rq 0 -rqsize 1000 -nprefill 8 -t 1000 -nrq 0 -nwork 8
     for (int i=1;i<argc;++i) {
@@ -1227,8 +1759,35 @@ int main(int argc, char** argv) {
             DESIRED_PREFILL_SIZE = atol(argv[++i]);
         } else if (strcmp(argv[i], "-dist-zipf") == 0) {
             distribution = KeyGeneratorDistribution::ZIPF;
+        } else if (strcmp(argv[i], "-zipf-theta") == 0) { // implies -dist-zipf
+            ZIPF_THETA = atof(argv[++i]);
+            distribution = KeyGeneratorDistribution::ZIPF;
+        } else if (strcmp(argv[i], "-zipf-permute") == 0) { // scatter hot keys over the key range (implies -dist-zipf)
+            ZIPF_PERMUTE = true;
+            distribution = KeyGeneratorDistribution::ZIPF;
         } else if (strcmp(argv[i], "-dist-uniform") == 0) {
             distribution = KeyGeneratorDistribution::UNIFORM; // default behaviour
+        } else if (strcmp(argv[i], "-latency") == 0) { // per-operation latency histograms
+            MEASURE_LATENCY = true;
+            reclamationEventsEnabled() = true; // to attribute operations to reclamation phases
+        } else if (strcmp(argv[i], "-garbage-budget-mb") == 0) { // bound on retired but unfreed records (signalling reclaimers)
+            GARBAGE_BUDGET_MB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-reclaim-helpers") == 0) { // threads that free records for the workers (requires POOL_TYPE=offload)
+            RECLAIM_HELPERS = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-json") == 0) { // append one JSON object per trial (and per sample) to a file
+            resultsOutput().setJsonPath(argv[++i]);
+        } else if (strcmp(argv[i], "-csv") == 0) { // append one CSV row per trial to a file
+            resultsOutput().setCsvPath(argv[++i]);
+        } else if (strcmp(argv[i], "-sample-ms") == 0) { // throughput and garbage sampling interval (0 = no samples)
+            SAMPLE_MILLIS = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-prefill-from") == 0) { // build from (or, if absent, write) a prefill snapshot
+            PREFILL_FROM = argv[++i];
+        } else if (strcmp(argv[i], "-sweep") == 0) { // run several trials on one prefilled data structure (see parseSweep)
+            SWEEP_SPEC = argv[++i];
+        } else if (strcmp(argv[i], "-oversub") == 0) { // N worker threads per logical processor (per -pin entry, or per online cpu if unpinned)
+            OVERSUB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-churn-ms") == 0) { // replace every worker thread after it has run this long
+            CHURN_MILLIS = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-t") == 0) {
             MILLIS_TO_RUN = atoi(argv[++i]);
         }
@@ -1246,7 +1805,29 @@ int main(int argc, char** argv) {
             exit(1);
         }
     }
-    TOTAL_THREADS = WORK_THREADS + RQ_THREADS;
+    if (OVERSUB > 0) {
+        if (!SWEEP_SPEC.empty()) {
+            setbench_error("-oversub cannot be combined with -sweep (give nwork in each trial instead)");
+        }
+        // threads pinned with -pin wrap around the list, so N threads share each listed processor;
+        // without -pin, threads are not pinned and the scheduler shares the online processors among them
+        const int processors = (numCustomBindings > 0 ? numCustomBindings : (int) sysconf(_SC_NPROCESSORS_ONLN));
+        WORK_THREADS = OVERSUB * processors;
+        if (WORK_THREADS + RQ_THREADS > MAX_THREADS_POW2) {
+            setbench_error("-oversub "<<OVERSUB<<" needs "<<(WORK_THREADS + RQ_THREADS)<<" threads, but MAX_THREADS_POW2="<<MAX_THREADS_POW2);
+        }
+    }
+    if (SWEEP_SPEC.empty()) {
+        SWEEP.push_back({WORK_THREADS, RQ_THREADS, INS, DEL, RQ, RQSIZE, MILLIS_TO_RUN});
+    } else {
+        parseSweep(SWEEP_SPEC);
+    }
+    // the data structure, thread bindings and stats must accommodate the largest trial
+    TOTAL_THREADS = 0;
+    for (size_t i=0;i<SWEEP.size();++i) {
+        TOTAL_THREADS = std::max(TOTAL_THREADS, SWEEP[i].workThreads + SWEEP[i].rqThreads);
+    }
+    if (SWEEP.size() == 1) applySweepTrial(SWEEP[0]);
 
     // print used args
     PRINTS(DS_TYPENAME);
@@ -1271,6 +1852,25 @@ int main(int argc, char** argv) {
     PRINTI(WORK_THREADS);
     PRINTI(RQ_THREADS);
     PRINTI(distribution);
+    PRINTI(MEASURE_LATENCY);
+    PRINTI(GARBAGE_BUDGET_MB);
+    setReclaimGarbageBudgetBytes((uint64_t) GARBAGE_BUDGET_MB << 20);
+    PRINTI(RECLAIM_HELPERS);
+    PRINTI(OVERSUB);
+    PRINTI(CHURN_MILLIS);
+    if (resultsOutput().isEnabled()) {
+        PRINTI(SAMPLE_MILLIS);
+    }
+    if (!SWEEP_SPEC.empty()) {
+        PRINTI(SWEEP_SPEC);
+    }
+    if (!PREFILL_FROM.empty()) {
+        PRINTI(PREFILL_FROM);
+    }
+    if (distribution == KeyGeneratorDistribution::ZIPF) {
+        PRINTI(ZIPF_THETA);
+        PRINTI(ZIPF_PERMUTE);
+    }
 
     switch (distribution) {
         case UNIFORM: {
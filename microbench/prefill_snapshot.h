@@ -0,0 +1,148 @@
+/*
+ * File:   prefill_snapshot.h
+ *
+ * Prefill snapshots for the microbenchmark (-prefill-from FILE).
+ *
+ * A snapshot is the set of keys in a prefilled data structure, stored as a
+ * header followed by the keys in increasing order, in the machine's byte
+ * order. It is read through a read-only memory mapping and handed directly to
+ * the adapter's bulk constructor, so large key ranges need no prefilling, and
+ * every run that uses the same file starts from the same keys (and, for data
+ * structures with a deterministic bulk-build, the same shape).
+ *
+ * Snapshots are written to a temporary file that is then renamed over the
+ * destination, so concurrent runs never read a partial snapshot.
+ */
+
+#ifndef PREFILL_SNAPSHOT_H
+#define PREFILL_SNAPSHOT_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "errors.h"
+
+#define PREFILL_SNAPSHOT_MAGIC "SBPREFIL"
+#define PREFILL_SNAPSHOT_VERSION 1
+
+struct prefill_snapshot_header_t {
+    char magic[8];
+    uint64_t version;
+    uint64_t keySize;   // sizeof(K)
+    uint64_t maxKey;    // MAXKEY of the run that wrote the snapshot
+    uint64_t numKeys;
+    int64_t keySum;
+};
+
+template <typename K>
+class PrefillSnapshot {
+private:
+    void * map;
+    size_t mapSize;
+    const prefill_snapshot_header_t * header;
+    const K * keys;
+
+    static void writeAll(const int fd, const void * data, size_t size, const std::string& path) {
+        const char * p = (const char *) data;
+        while (size > 0) {
+            const ssize_t n = ::write(fd, p, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                setbench_error("could not write prefill snapshot "<<path<<": "<<strerror(errno));
+            }
+            p += n;
+            size -= n;
+        }
+    }
+
+public:
+    static bool exists(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    // slices must hold increasing keys when concatenated
+    static void write(const std::string& path, const std::vector<std::vector<K> >& slices, const uint64_t maxKey) {
+        prefill_snapshot_header_t h;
+        memcpy(h.magic, PREFILL_SNAPSHOT_MAGIC, sizeof(h.magic));
+        h.version = PREFILL_SNAPSHOT_VERSION;
+        h.keySize = sizeof(K);
+        h.maxKey = maxKey;
+        h.numKeys = 0;
+        h.keySum = 0;
+        for (size_t i=0;i<slices.size();++i) {
+            h.numKeys += slices[i].size();
+            for (size_t j=0;j<slices[i].size();++j) h.keySum += slices[i][j];
+        }
+
+        std::stringstream ss;
+        ss<<path<<".tmp."<<getpid();
+        const std::string tmpPath = ss.str();
+        const int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            setbench_error("could not create prefill snapshot "<<tmpPath<<": "<<strerror(errno));
+        }
+        writeAll(fd, &h, sizeof(h), tmpPath);
+        for (size_t i=0;i<slices.size();++i) {
+            writeAll(fd, slices[i].data(), slices[i].size() * sizeof(K), tmpPath);
+        }
+        if (fsync(fd) || close(fd)) {
+            setbench_error("could not write prefill snapshot "<<tmpPath<<": "<<strerror(errno));
+        }
+        if (rename(tmpPath.c_str(), path.c_str())) {
+            setbench_error("could not rename "<<tmpPath<<" to "<<path<<": "<<strerror(errno));
+        }
+    }
+
+    PrefillSnapshot(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            setbench_error("could not open prefill snapshot "<<path<<": "<<strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st)) {
+            setbench_error("could not stat prefill snapshot "<<path<<": "<<strerror(errno));
+        }
+        mapSize = st.st_size;
+        if (mapSize < sizeof(prefill_snapshot_header_t)) {
+            setbench_error("prefill snapshot "<<path<<" is truncated");
+        }
+        map = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            setbench_error("could not map prefill snapshot "<<path<<": "<<strerror(errno));
+        }
+        madvise(map, mapSize, MADV_SEQUENTIAL);
+        header = (const prefill_snapshot_header_t *) map;
+        keys = (const K *) ((const char *) map + sizeof(prefill_snapshot_header_t));
+
+        if (memcmp(header->magic, PREFILL_SNAPSHOT_MAGIC, sizeof(header->magic)) || header->version != PREFILL_SNAPSHOT_VERSION) {
+            setbench_error(path<<" is not a prefill snapshot (or was written by another version)");
+        }
+        if (header->keySize != sizeof(K)) {
+            setbench_error("prefill snapshot "<<path<<" has "<<header->keySize<<" byte keys, but this binary uses "<<sizeof(K)<<" byte keys");
+        }
+        if (mapSize != sizeof(prefill_snapshot_header_t) + header->numKeys * sizeof(K)) {
+            setbench_error("prefill snapshot "<<path<<" is truncated");
+        }
+    }
+
+    ~PrefillSnapshot() {
+        munmap(map, mapSize);
+    }
+
+    const K * getKeys() const { return keys; }
+    size_t size() const { return header->numKeys; }
+    uint64_t getMaxKey() const { return header->maxKey; }
+    long long getKeySum() const { return header->keySum; }
+};
+
+#endif /* PREFILL_SNAPSHOT_H */
@@ -0,0 +1,224 @@
+/*
+ * File:   results_output.h
+ *
+ * Machine-readable results for the microbenchmark (-json FILE, -csv FILE).
+ *
+ * A ResultsRecord is an ordered list of (key, value) fields. Values that read
+ * as finite numbers are written as numbers, and everything else is written as
+ * a string. ResultsOutput holds the configuration fields (every PRINTI/PRINTS
+ * in main.cpp adds one), and appends
+ *  - one "trial" record per trial, with the configuration followed by the
+ *    results (GSTATS aggregates, tree stats, PAPI counters, latency
+ *    percentiles, throughput samples, ...), to the JSON file and the CSV file;
+ *  - one "sample" record per -sample-ms interval while the trial runs, to the
+ *    JSON file only, so that long runs can be monitored as they go.
+ *
+ * The JSON file has one JSON object per line. Trials can have different
+ * columns (e.g., sweep parameters, latency percentiles and per-record-type
+ * stats appear only in some trials), so a trial is preceded by a header row
+ * whenever its columns differ from the last header row in the CSV file (or the
+ * file is empty). A reader starts a new table at each row whose first cell is
+ * "record". Every record is formatted in memory and written with a single
+ * write() on a file opened with O_APPEND, under an exclusive flock(), so
+ * concurrent runs appending to the same file never interleave records, and a
+ * reader never sees a partial record unless a run is killed mid-write.
+ */
+
+#ifndef RESULTS_OUTPUT_H
+#define RESULTS_OUTPUT_H
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "errors.h"
+
+class ResultsRecord {
+private:
+    std::vector<std::pair<std::string, std::string> > fields; // (key, formatted value)
+
+    static bool isNumber(const std::string& s) {
+        if (s.empty() || !(isdigit(s[0]) || s[0] == '-')) return false;
+        if (s.find_first_not_of("0123456789+-.eE") != std::string::npos) return false;
+        char * end;
+        const double d = strtod(s.c_str(), &end);
+        return *end == '\0' && std::isfinite(d);
+    }
+
+    static std::string quote(const std::string& s, const char q, const bool json) {
+        std::string result(1, q);
+        for (size_t i=0;i<s.size();++i) {
+            const char c = s[i];
+            if (c == q) {
+                result += (json ? "\\" : "\"");
+                result += c;
+            } else if (json && c == '\\') {
+                result += "\\\\";
+            } else if (json && c == '\n') {
+                result += "\\n";
+            } else if (json && (unsigned char) c < 0x20) {
+                result += ' ';
+            } else {
+                result += c;
+            }
+        }
+        return result + q;
+    }
+
+public:
+    void clear() {
+        fields.clear();
+    }
+
+    template <typename T>
+    void add(const std::string& key, const T& value) {
+        std::stringstream ss;
+        ss<<std::setprecision(15)<<value;
+        fields.push_back(std::make_pair(key, ss.str()));
+    }
+
+    // values are separated by spaces, like the arrays in the key=value output
+    template <typename T>
+    void addArray(const std::string& key, const std::vector<T>& values) {
+        std::stringstream ss;
+        ss<<std::setprecision(15);
+        for (size_t i=0;i<values.size();++i) ss<<(i?" ":"")<<values[i];
+        fields.push_back(std::make_pair(key, ss.str()));
+    }
+
+    void addAll(const ResultsRecord& other) {
+        fields.insert(fields.end(), other.fields.begin(), other.fields.end());
+    }
+
+    std::string toJson() const {
+        std::string result = "{";
+        for (size_t i=0;i<fields.size();++i) {
+            if (i) result += ",";
+            result += quote(fields[i].first, '"', true) + ":";
+            result += isNumber(fields[i].second) ? fields[i].second : quote(fields[i].second, '"', true);
+        }
+        return result + "}\n";
+    }
+
+    std::string toCsvHeader() const {
+        std::string result;
+        for (size_t i=0;i<fields.size();++i) {
+            result += (i ? "," : "") + quote(fields[i].first, '"', false);
+        }
+        return result + "\n";
+    }
+
+    std::string toCsvRow() const {
+        std::string result;
+        for (size_t i=0;i<fields.size();++i) {
+            if (i) result += ",";
+            result += isNumber(fields[i].second) ? fields[i].second : quote(fields[i].second, '"', false);
+        }
+        return result + "\n";
+    }
+};
+
+class ResultsOutput {
+private:
+    std::string jsonPath;
+    std::string csvPath;
+    ResultsRecord config;
+
+    // the last line in the file open as fd that begins with prefix (without its newline), or "" if there is none
+    static std::string lastLineStartingWith(const int fd, const std::string& prefix) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) return "";
+        const size_t CHUNK = 1<<16;
+        std::string tail;   // the end of the file, from pos
+        off_t pos = st.st_size;
+        while (pos > 0) {
+            const size_t len = (pos < (off_t) CHUNK) ? (size_t) pos : CHUNK;
+            pos -= len;
+            std::string chunk(len, '\0');
+            if (pread(fd, &chunk[0], len, pos) != (ssize_t) len) return "";
+            tail = chunk + tail;
+            size_t start = tail.rfind("\n" + prefix);
+            if (start != std::string::npos) {
+                ++start;
+            } else if (pos == 0 && tail.compare(0, prefix.size(), prefix) == 0) {
+                start = 0;
+            } else {
+                continue;
+            }
+            const size_t end = tail.find('\n', start);
+            return tail.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+        }
+        return "";
+    }
+
+    // appends text to path in a single write(), preceded by header (a line) unless it is
+    // already the last line in the file that begins like header
+    static void append(const std::string& path, const std::string& text, const std::string& header = "") {
+        const int fd = open(path.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+        if (fd < 0) {
+            setbench_error("could not open results file "<<path<<": "<<strerror(errno));
+        }
+        flock(fd, LOCK_EX);
+        std::string out = text;
+        if (!header.empty()) {
+            const std::string prefix = header.substr(0, header.find(',') + 1);
+            if (lastLineStartingWith(fd, prefix) + "\n" != header) out = header + text;
+        }
+        size_t written = 0;
+        while (written < out.size()) {
+            const ssize_t n = write(fd, out.data() + written, out.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                setbench_error("could not write results file "<<path<<": "<<strerror(errno));
+            }
+            written += n;
+        }
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+public:
+    void setJsonPath(const std::string& path) { jsonPath = path; }
+    void setCsvPath(const std::string& path) { csvPath = path; }
+    bool isEnabled() const { return !jsonPath.empty() || !csvPath.empty(); }
+    bool isStreaming() const { return !jsonPath.empty(); }
+
+    ResultsRecord& getConfig() {
+        return config;
+    }
+
+    void writeTrial(const ResultsRecord& results) {
+        ResultsRecord r;
+        r.add("record", "trial");
+        r.addAll(config);
+        r.addAll(results);
+        if (!jsonPath.empty()) append(jsonPath, r.toJson());
+        if (!csvPath.empty()) append(csvPath, r.toCsvRow(), r.toCsvHeader());
+    }
+
+    void writeSample(const ResultsRecord& sample) {
+        if (jsonPath.empty()) return;
+        ResultsRecord r;
+        r.add("record", "sample");
+        r.addAll(config);
+        r.addAll(sample);
+        append(jsonPath, r.toJson());
+    }
+};
+
+inline ResultsOutput & resultsOutput() {
+    static ResultsOutput output;
+    return output;
+}
+
+#endif /* RESULTS_OUTPUT_H */